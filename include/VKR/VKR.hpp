@@ -1,6 +1,8 @@
 #pragma once
 #include <glm/mat4x4.hpp>
 
+#include <array>
+#include <cstddef>
 #include <memory>
 #include <span>
 
@@ -19,6 +21,25 @@ enum class MeshStorageFormat: Detail::storageid {
     Last = Dynamic,
 };
 
+// Most levels of detail a mesh can have
+inline constexpr size_t c_max_mesh_lods = 8;
+
+struct MeshLOD {
+    std::span<const glm::vec3> vertices;
+    // Triangle list of indices into vertices. Without indices, vertices is
+    // the triangle list.
+    std::span<const uint32_t> indices;
+    // Largest distance of the level's surface from the full detail mesh,
+    // in model space
+    float error = 0.0f;
+};
+
+struct MeshLODGeneration {
+    // Triangle count of every generated level relative to the full detail
+    // mesh, in decreasing order. At most c_max_mesh_lods - 1 are used.
+    std::span<const float> triangle_ratios;
+};
+
 enum MeshID: Detail::meshid;
 enum MaterialID: Detail::materialid;
 enum ModelID: Detail::modelid;
@@ -70,6 +91,7 @@ public:
 
 struct GraphicsDeviceConnectionFeatures {
     bool present: 1;
+    bool gpu_culling: 1;
 };
 
 class GraphicsDevice {
@@ -83,6 +105,7 @@ protected:
 public:
     const char* name() const;
     bool presentSupported() const;
+    bool gpuCullingSupported() const;
 
     GraphicsDeviceConnection& createConnection(
         const GraphicsDeviceConnectionFeatures& conf 
@@ -97,6 +120,49 @@ public:
     }
 };
 
+struct SceneCreationFeatures {
+    // Cull static models and generate their draws on the GPU.
+    // Requires a connection created with gpu_culling.
+    bool gpu_culling: 1;
+    // Draw static models visible last frame first, then test the rest
+    // against the depth of those draws. Requires gpu_culling.
+    bool occlusion_culling: 1;
+    // Rasterize occluder models on the CPU and skip CPU culled models
+    // hidden behind them. Suited to devices where a GPU depth pyramid is
+    // too expensive.
+    bool cpu_occlusion_culling: 1;
+    // Split large static meshes into meshlets of up to 124 triangles,
+    // which are culled on the GPU by frustum and by the cone of their
+    // normals. Meshlets that only show back faces are skipped, so such
+    // meshes must be closed or only be seen from the front. Requires
+    // gpu_culling.
+    bool cluster_culling: 1;
+    // Also cull the triangles of visible meshlets that have no area, face
+    // away, are outside the frustum or cover no pixel center, before their
+    // indices are written. Requires cluster_culling.
+    bool triangle_culling: 1;
+    // Draw the depth of all models first, without fragment shaders, then
+    // shade with an equal depth test, so that every pixel is shaded about
+    // once. Vertex shaders must declare gl_Position invariant, since
+    // materials' depth pipelines are compiled without their fragment
+    // shaders.
+    bool depth_prepass: 1;
+    // Store static mesh positions as 16 bit snorm relative to the mesh's
+    // bounding box, in 8 bytes instead of 12. The dequantization is folded
+    // into the model matrix that vertex shaders receive.
+    bool quantized_positions: 1;
+    // With quantized_positions, meshes whose quantization error is larger
+    // than this distance in model space keep float positions. 0 quantizes
+    // every mesh.
+    float max_position_quantization_error = 0.0f;
+    // Number of threads, including the one calling Scene::draw, that
+    // record draws into secondary command buffers. 0 is treated as 1.
+    uint32_t recording_thread_count = 0;
+    // Size in bytes of the staging ring that all uploads go through.
+    // Larger uploads are split into parts. 0 picks 64 MiB.
+    size_t upload_ring_size = 0;
+};
+
 class GraphicsDeviceConnection {
 protected:
     GraphicsDeviceConnection() = default;
@@ -107,7 +173,8 @@ protected:
 
 public:
     Scene& createScene(
-        const Camera& camera, uint32_t width, uint32_t height
+        const Camera& camera, uint32_t width, uint32_t height,
+        const SceneCreationFeatures& conf = {}
     );
 
     Vulkan::GraphicsDeviceConnection& vulkanAPI() {
@@ -127,6 +194,83 @@ struct Camera {
     glm::vec3 m_up;
 };
 
+struct FrameStats {
+    // Models rejected by CPU frustum culling. With GPU culling, static
+    // models are culled on the GPU and are not counted.
+    uint32_t culled_models = 0;
+    // Models rejected by CPU occlusion culling, out of those that passed
+    // frustum culling
+    uint32_t occluded_models = 0;
+    // CPU recorded model draws at every level of detail
+    std::array<uint32_t, c_max_mesh_lods> lod_draws = {};
+    // Time spent rasterizing occluders and testing models against them
+    float occluder_raster_ms = 0.0f;
+    float occlusion_test_ms = 0.0f;
+    // GPU time of cluster culling, read back without stalling from the
+    // last frame that used the same resources
+    float cluster_culling_ms = 0.0f;
+    // Triangles of visible meshlets tested by triangle culling, and how
+    // many were rejected for every reason. The rest were drawn. Read back
+    // like cluster_culling_ms.
+    uint32_t tested_triangles = 0;
+    uint32_t degenerate_triangles = 0;
+    uint32_t back_facing_triangles = 0;
+    uint32_t outside_triangles = 0;
+    uint32_t small_triangles = 0;
+    // Samples that passed the depth test of the depth pre-pass, which is
+    // what a single pass would have shaded, and samples shaded after it.
+    // Their difference is the overdraw saved by the pre-pass. Read back
+    // like cluster_culling_ms, and only counted on devices with precise
+    // and inherited occlusion queries.
+    uint64_t prepass_samples = 0;
+    uint64_t shaded_samples = 0;
+    // Vertices of the buffers shared by static meshes, float and quantized
+    // together, and how many of them are free in how many ranges. Free
+    // vertices outside of the largest range are fragmentation.
+    uint64_t vertex_pool_capacity = 0;
+    uint64_t vertex_pool_free = 0;
+    uint32_t vertex_pool_free_ranges = 0;
+    uint32_t vertex_pool_largest_free = 0;
+};
+
+// View of elements that are stride bytes apart, so that a field can be read
+// straight out of an array of structures
+template <typename T>
+class StridedSpan {
+    const std::byte* m_data = nullptr;
+    size_t m_size = 0;
+    size_t m_stride = sizeof(T);
+
+public:
+    StridedSpan() = default;
+    StridedSpan(std::span<const T> elements):
+        m_data(reinterpret_cast<const std::byte*>(elements.data())),
+        m_size(elements.size()) {}
+    StridedSpan(const T* first, size_t size, size_t stride):
+        m_data(reinterpret_cast<const std::byte*>(first)),
+        m_size(size), m_stride(stride) {}
+
+    size_t size() const {
+        return m_size;
+    }
+
+    bool empty() const {
+        return m_size == 0;
+    }
+
+    size_t stride() const {
+        return m_stride;
+    }
+
+    const T& operator[](size_t i) const {
+        return *reinterpret_cast<const T*>(m_data + i * m_stride);
+    }
+
+    StridedSpan subspan(size_t offset, size_t count) const {
+        return {&(*this)[offset], count, m_stride};
+    }
+};
+
 class Scene {
 protected:
     Scene() = default;
@@ -139,36 +283,129 @@ public:
     Camera m_camera;
 
 public:
+    // Static meshes are welded into indexed meshes whose triangles are
+    // ordered for the post-transform cache, so non-indexed triangle lists
+    // don't upload or transform duplicate vertices
     MeshID createMesh(
         MeshStorageFormat storage_format,
         std::span<const glm::vec3> vertices
     );    
 
+    MeshID createMesh(
+        MeshStorageFormat storage_format,
+        std::span<const glm::vec3> vertices,
+        std::span<const uint32_t> indices
+    );
+
     MeshID createMesh(
         MeshStorageFormat storage_format,
         uint32_t vertex_count
     );
 
+    // Levels are ordered from the most detailed one, which should have no
+    // error. Every model is drawn with the coarsest level whose error
+    // projects to less than a pixel. Only static meshes can have more than
+    // one level.
+    MeshID createMesh(
+        MeshStorageFormat storage_format,
+        std::span<const MeshLOD> lods
+    );
+
+    // Creates a static mesh from the full detail level and simplifies it
+    // into coarser levels on background threads. Models of the mesh are
+    // drawn with the full detail level until the simplified ones are
+    // uploaded by a later call to draw.
+    MeshID createMesh(
+        MeshStorageFormat storage_format,
+        std::span<const glm::vec3> vertices,
+        const MeshLODGeneration& lod_generation
+    );
+
+    // Creates a static mesh for every vertex list and writes their IDs to
+    // meshes. All vertex data is uploaded in one submission, which is a
+    // lot cheaper than creating the meshes one by one.
+    void createMeshes(
+        MeshStorageFormat storage_format,
+        std::span<const std::span<const glm::vec3>> vertices,
+        std::span<MeshID> meshes
+    );
+
     void setMeshVertexData(
         MeshID mesh,
         std::span<const glm::vec3> vertices
     );
 
+    // The vertex shader receives the position at location 0.
+    // The projection-view matrix is the first member of a uniform block
+    // at set 0, binding 0. Model matrices are a mat4 storage buffer array
+    // at set 0, binding 1, and the model matrix of an instance is at index
+    // transform_base + gl_InstanceIndex, where transform_base is a uint
+    // push constant. For quantized positions, the model matrix includes
+    // the mesh's dequantization.
     MaterialID createMaterial(
         std::span<const std::byte> vert_shader_binary,
         std::span<const std::byte> frag_shader_binary
     );
 
+    // Largest distance in model space between a vertex of a static mesh
+    // and its quantized position, which is what quantizing the mesh costs
+    // or would cost. Covers generated levels of detail once they are
+    // installed. 0 without quantized_positions, and for dynamic meshes.
+    float getMeshQuantizationError(
+        MeshID mesh
+    ) const;
+
+    // Sets the low polygon triangle list that occluder models using the
+    // mesh are rasterized with. It must lie inside the mesh, or visible
+    // models may be culled.
+    void setMeshOccluder(
+        MeshID mesh,
+        std::span<const glm::vec3> triangles
+    );
+
     ModelID createModel(
         MeshID mesh,
         MaterialID material,
         const glm::mat4& trans = glm::mat4(1.0f)
     );
 
+    // Creates a model for every mesh, material and transform, and writes
+    // their IDs to models
+    void createModels(
+        std::span<const MeshID> meshes,
+        std::span<const MaterialID> materials,
+        StridedSpan<glm::mat4> transforms,
+        std::span<ModelID> models
+    );
+
     void destroyModel(
         ModelID model
     );
 
+    void destroyModels(
+        std::span<const ModelID> models
+    );
+
+    // The transform of a model with a parent is relative to the parent,
+    // both when it is attached and when it is set later. World transforms
+    // are recomputed in draw, only for subtrees that changed.
+    void setModelParent(
+        ModelID model,
+        ModelID parent
+    );
+
+    // The model keeps its current world transform
+    void clearModelParent(
+        ModelID model
+    );
+
+    // Occluders hide other models with CPU occlusion culling. Models whose
+    // mesh has no occluder geometry don't occlude anything.
+    void setModelOccluder(
+        ModelID model,
+        bool occluder
+    );
+
     void getModelTransform(
         ModelID model
     ) const;
@@ -178,9 +415,17 @@ public:
         const glm::mat4& trans
     );
 
+    void setModelTransforms(
+        std::span<const ModelID> models,
+        StridedSpan<glm::mat4> transforms
+    );
+
     std::tuple<uint32_t, uint32_t> getViewport() const;
     void setViewport(uint32_t width, uint32_t height);
 
     void draw(Vulkan::ISwapchain* swapchain);
+
+    // Statistics of the last call to draw
+    const FrameStats& getFrameStats() const;
 };
 }
@@ -0,0 +1,418 @@
+#include "BVH.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <numeric>
+#include <span>
+
+namespace VKR {
+namespace {
+constexpr uint32_t c_leaf_size = 4;
+constexpr size_t c_sah_bins = 16;
+
+struct Box {
+    glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 max = glm::vec3(std::numeric_limits<float>::lowest());
+
+    void grow(const glm::vec3& p) {
+        min = glm::min(min, p);
+        max = glm::max(max, p);
+    }
+
+    void grow(const Box& other) {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+
+    float area() const {
+        auto d = glm::max(max - min, glm::vec3(0.0f));
+        return d.x * d.y + d.y * d.z + d.z * d.x;
+    }
+};
+
+glm::vec3 getCenter(const SphereBoundsSoA& bounds, uint32_t i) {
+    return {bounds.x[i], bounds.y[i], bounds.z[i]};
+}
+
+Box getBox(const SphereBoundsSoA& bounds, uint32_t i) {
+    auto c = getCenter(bounds, i);
+    auto r = glm::vec3(bounds.radius[i]);
+    return {c - r, c + r};
+}
+
+struct Range {
+    uint32_t first;
+    uint32_t count;
+};
+
+Box getRangeBox(
+    std::span<const uint32_t> prims, const SphereBoundsSoA& bounds
+) {
+    Box box;
+    for (auto p: prims) {
+        box.grow(getBox(bounds, p));
+    }
+    return box;
+}
+
+void setChildBox(BVHNode& node, size_t c, const Box& box) {
+    auto center = (box.min + box.max) * 0.5f;
+    auto extent = (box.max - box.min) * 0.5f;
+    node.center_x[c] = center.x;
+    node.center_y[c] = center.y;
+    node.center_z[c] = center.z;
+    node.extent_x[c] = extent.x;
+    node.extent_y[c] = extent.y;
+    node.extent_z[c] = extent.z;
+}
+
+Box getNodeBox(const BVHNode& node) {
+    Box box;
+    for (size_t c = 0; c < c_bvh_width; c++) {
+        if (node.count[c]) {
+            glm::vec3 center = {
+                node.center_x[c], node.center_y[c], node.center_z[c],
+            };
+            glm::vec3 extent = {
+                node.extent_x[c], node.extent_y[c], node.extent_z[c],
+            };
+            box.grow(Box{center - extent, center + extent});
+        }
+    }
+    return box;
+}
+
+// Partitions the range in two with the binned surface area heuristic and
+// returns the size of the first part
+uint32_t splitRange(
+    std::span<uint32_t> prims, const SphereBoundsSoA& bounds
+) {
+    Box centroids;
+    for (auto p: prims) {
+        centroids.grow(getCenter(bounds, p));
+    }
+    auto extent = centroids.max - centroids.min;
+    int axis = 0;
+    if (extent.y > extent[axis]) { axis = 1; }
+    if (extent.z > extent[axis]) { axis = 2; }
+
+    auto half = static_cast<uint32_t>(prims.size() / 2);
+    auto splitMedian = [&] {
+        std::ranges::nth_element(prims, prims.begin() + half, {},
+            [&](uint32_t p) { return getCenter(bounds, p)[axis]; }
+        );
+        return half;
+    };
+    if (extent[axis] <= 0.0f) {
+        return splitMedian();
+    }
+
+    auto scale = c_sah_bins / extent[axis];
+    auto getBin = [&](uint32_t p) {
+        auto b = (getCenter(bounds, p)[axis] - centroids.min[axis]) * scale;
+        return std::min(static_cast<size_t>(b), c_sah_bins - 1);
+    };
+
+    Box bin_boxes[c_sah_bins];
+    uint32_t bin_counts[c_sah_bins] = {};
+    for (auto p: prims) {
+        auto b = getBin(p);
+        bin_boxes[b].grow(getBox(bounds, p));
+        bin_counts[b]++;
+    }
+
+    // Cost of splitting after bin i is the area of each side weighted by
+    // its primitive count
+    float right_costs[c_sah_bins] = {};
+    {
+        Box right;
+        uint32_t right_count = 0;
+        for (size_t i = c_sah_bins - 1; i > 0; i--) {
+            right.grow(bin_boxes[i]);
+            right_count += bin_counts[i];
+            right_costs[i - 1] = right.area() * right_count;
+        }
+    }
+    size_t best_bin = 0;
+    float best_cost = std::numeric_limits<float>::max();
+    {
+        Box left;
+        uint32_t left_count = 0;
+        for (size_t i = 0; i + 1 < c_sah_bins; i++) {
+            left.grow(bin_boxes[i]);
+            left_count += bin_counts[i];
+            if (left_count == 0 or left_count == prims.size()) {
+                continue;
+            }
+            auto cost = left.area() * left_count + right_costs[i];
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_bin = i;
+            }
+        }
+    }
+    if (best_cost == std::numeric_limits<float>::max()) {
+        return splitMedian();
+    }
+
+    auto mid = std::partition(prims.begin(), prims.end(), [&](uint32_t p) {
+        return getBin(p) <= best_bin;
+    });
+    return static_cast<uint32_t>(mid - prims.begin());
+}
+
+// Splits the range of a node into up to c_bvh_width children, always
+// splitting the largest one that is not a leaf yet
+size_t splitChildren(
+    std::span<uint32_t> prims, uint32_t first, uint32_t count,
+    const SphereBoundsSoA& bounds,
+    Range (&children)[c_bvh_width]
+) {
+    size_t child_count = 1;
+    children[0] = {first, count};
+    while (child_count < c_bvh_width) {
+        auto largest = std::max_element(
+            children, children + child_count,
+            [](const Range& l, const Range& r) { return l.count < r.count; }
+        );
+        if (largest->count <= c_leaf_size) {
+            break;
+        }
+        auto range = *largest;
+        auto left_count = splitRange(
+            prims.subspan(range.first, range.count), bounds
+        );
+        *largest = {range.first, left_count};
+        children[child_count++] = {
+            range.first + left_count, range.count - left_count,
+        };
+    }
+    return child_count;
+}
+
+void initNode(BVHNode& node) {
+    node = {};
+    std::ranges::fill(node.child, c_bvh_leaf);
+}
+}
+
+void BVH::build(const SphereBoundsSoA& bounds, ThreadPool& thread_pool) {
+    m_nodes.clear();
+    m_prims.resize(bounds.count);
+    std::iota(m_prims.begin(), m_prims.end(), 0);
+    if (m_prims.empty()) {
+        return;
+    }
+
+    auto& root = m_nodes.emplace_back();
+    initNode(root);
+    Range children[c_bvh_width];
+    auto child_count = splitChildren(
+        m_prims, 0, bounds.count, bounds, children
+    );
+
+    // Children of the root own disjoint primitive ranges, so their
+    // subtrees are built independently and appended afterwards
+    std::vector<BVHNode> subtrees[c_bvh_width];
+    thread_pool.run([&](size_t thread_idx) {
+        auto thread_count = thread_pool.threadCount();
+        for (size_t c = thread_idx; c < child_count; c += thread_count) {
+            if (children[c].count > c_leaf_size) {
+                buildNode(subtrees[c], children[c].first, children[c].count, bounds);
+            }
+        }
+    });
+
+    for (size_t c = 0; c < child_count; c++) {
+        auto [first, count] = children[c];
+        std::span<const uint32_t> prims(m_prims.data() + first, count);
+        setChildBox(m_nodes[0], c, getRangeBox(prims, bounds));
+        m_nodes[0].first[c] = first;
+        m_nodes[0].count[c] = count;
+        if (subtrees[c].empty()) {
+            continue;
+        }
+        auto offset = static_cast<uint32_t>(m_nodes.size());
+        m_nodes[0].child[c] = offset;
+        for (auto& node: subtrees[c]) {
+            for (auto& child: node.child) {
+                if (child != c_bvh_leaf) {
+                    child += offset;
+                }
+            }
+        }
+        m_nodes.insert(m_nodes.end(), subtrees[c].begin(), subtrees[c].end());
+    }
+}
+
+uint32_t BVH::buildNode(
+    std::vector<BVHNode>& nodes,
+    uint32_t first, uint32_t count,
+    const SphereBoundsSoA& bounds
+) {
+    // Nodes are allocated before their children, so every subtree is
+    // contiguous and children always follow their parent
+    auto node_idx = static_cast<uint32_t>(nodes.size());
+    initNode(nodes.emplace_back());
+
+    Range children[c_bvh_width];
+    auto child_count = splitChildren(m_prims, first, count, bounds, children);
+    for (size_t c = 0; c < child_count; c++) {
+        auto range = children[c];
+        std::span<const uint32_t> prims(m_prims.data() + range.first, range.count);
+        setChildBox(nodes[node_idx], c, getRangeBox(prims, bounds));
+        nodes[node_idx].first[c] = range.first;
+        nodes[node_idx].count[c] = range.count;
+        if (range.count > c_leaf_size) {
+            auto child = buildNode(nodes, range.first, range.count, bounds);
+            nodes[node_idx].child[c] = child;
+        }
+    }
+    return node_idx;
+}
+
+void BVH::refit(const SphereBoundsSoA& bounds, ThreadPool& thread_pool) {
+    if (m_nodes.empty()) {
+        return;
+    }
+    assert(bounds.count == m_prims.size());
+
+    // Subtrees of the root occupy consecutive node ranges. Refitting them
+    // back to front updates children before their parents.
+    const auto& root = m_nodes[0];
+    uint32_t ends[c_bvh_width];
+    {
+        auto end = static_cast<uint32_t>(m_nodes.size());
+        for (size_t c = c_bvh_width; c-- > 0;) {
+            ends[c] = end;
+            if (root.child[c] != c_bvh_leaf) {
+                end = root.child[c];
+            }
+        }
+    }
+    thread_pool.run([&](size_t thread_idx) {
+        auto thread_count = thread_pool.threadCount();
+        for (size_t c = thread_idx; c < c_bvh_width; c += thread_count) {
+            auto begin = root.child[c];
+            if (begin == c_bvh_leaf) {
+                continue;
+            }
+            for (auto n = ends[c]; n-- > begin;) {
+                refitNode(m_nodes[n], bounds);
+            }
+        }
+    });
+    refitNode(m_nodes[0], bounds);
+}
+
+void BVH::refitNode(BVHNode& node, const SphereBoundsSoA& bounds) const {
+    for (size_t c = 0; c < c_bvh_width; c++) {
+        if (!node.count[c]) {
+            continue;
+        }
+        if (node.child[c] == c_bvh_leaf) {
+            std::span<const uint32_t> prims(
+                m_prims.data() + node.first[c], node.count[c]
+            );
+            setChildBox(node, c, getRangeBox(prims, bounds));
+        } else {
+            setChildBox(node, c, getNodeBox(m_nodes[node.child[c]]));
+        }
+    }
+}
+
+size_t BVH::cull(
+    const Frustum& frustum,
+    const SphereBoundsSoA& bounds,
+    std::vector<uint8_t>& visible
+) const {
+    constexpr auto W = Simd::c_width;
+    visible.assign(Simd::roundUp(bounds.count), 0);
+    if (m_nodes.empty()) {
+        return 0;
+    }
+
+    Simd::Float planes[6][4];
+    Simd::Float abs_normals[6][3];
+    for (size_t p = 0; p < 6; p++) {
+        for (size_t c = 0; c < 4; c++) {
+            planes[p][c] = Simd::set1(frustum.planes[p][c]);
+        }
+        for (size_t c = 0; c < 3; c++) {
+            abs_normals[p][c] = Simd::set1(std::abs(frustum.planes[p][c]));
+        }
+    }
+
+    auto acceptRange = [&](uint32_t first, uint32_t count) {
+        for (auto i = first; i < first + count; i++) {
+            visible[m_prims[i]] = 1;
+        }
+    };
+    auto testSphere = [&](uint32_t p) {
+        for (const auto& plane: frustum.planes) {
+            auto d = glm::dot(glm::vec3(plane), getCenter(bounds, p)) + plane.w;
+            if (d < -bounds.radius[p]) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    auto zero = Simd::set1(0.0f);
+    std::vector<uint32_t> stack = {0};
+    while (!stack.empty()) {
+        const auto& node = m_nodes[stack.back()];
+        stack.pop_back();
+
+        for (size_t j = 0; j < c_bvh_width; j += W) {
+            auto cx = Simd::load(node.center_x + j);
+            auto cy = Simd::load(node.center_y + j);
+            auto cz = Simd::load(node.center_z + j);
+            auto ex = Simd::load(node.extent_x + j);
+            auto ey = Simd::load(node.extent_y + j);
+            auto ez = Simd::load(node.extent_z + j);
+
+            // A box is outside a plane if its center is further behind it
+            // than the projected extent, and inside if it is in front of
+            // it by more than that
+            auto intersects = Simd::maskTrue();
+            auto contained = Simd::maskTrue();
+            for (size_t p = 0; p < 6; p++) {
+                auto d = Simd::fmadd(planes[p][0], cx,
+                    Simd::fmadd(planes[p][1], cy,
+                    Simd::fmadd(planes[p][2], cz, planes[p][3])));
+                auto r = Simd::fmadd(abs_normals[p][0], ex,
+                    Simd::fmadd(abs_normals[p][1], ey,
+                    Simd::mul(abs_normals[p][2], ez)));
+                intersects = Simd::maskAnd(intersects, Simd::cmpge(Simd::add(d, r), zero));
+                contained = Simd::maskAnd(contained, Simd::cmpge(Simd::sub(d, r), zero));
+            }
+            auto intersects_bits = Simd::movemask(intersects);
+            auto contained_bits = Simd::movemask(contained);
+
+            for (size_t l = 0; l < W; l++) {
+                auto c = j + l;
+                if (!node.count[c] or !((intersects_bits >> l) & 1)) {
+                    continue;
+                }
+                if ((contained_bits >> l) & 1) {
+                    acceptRange(node.first[c], node.count[c]);
+                } else if (node.child[c] != c_bvh_leaf) {
+                    stack.push_back(node.child[c]);
+                } else {
+                    for (auto i = node.first[c]; i < node.first[c] + node.count[c]; i++) {
+                        visible[m_prims[i]] = testSphere(m_prims[i]);
+                    }
+                }
+            }
+        }
+    }
+
+    size_t culled = 0;
+    for (size_t i = 0; i < bounds.count; i++) {
+        culled += !visible[i];
+    }
+    return culled;
+}
+}
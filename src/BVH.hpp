@@ -0,0 +1,66 @@
+#pragma once
+#include "Culling.hpp"
+#include "Frustum.hpp"
+#include "Simd.hpp"
+#include "ThreadPool.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace VKR {
+// Nodes are as wide as a SIMD register, but at least 4 wide
+inline constexpr size_t c_bvh_width = Simd::c_width > 4 ? Simd::c_width : 4;
+inline constexpr uint32_t c_bvh_leaf = UINT32_MAX;
+
+// Child bounds are stored as SoA boxes, so that every child of a node is
+// tested against a plane at once
+struct alignas(64) BVHNode {
+    float center_x[c_bvh_width];
+    float center_y[c_bvh_width];
+    float center_z[c_bvh_width];
+    float extent_x[c_bvh_width];
+    float extent_y[c_bvh_width];
+    float extent_z[c_bvh_width];
+    // Child node, or c_bvh_leaf
+    uint32_t child[c_bvh_width];
+    // Primitives of the whole subtree of a child are contiguous, so a
+    // subtree that is fully inside the frustum is accepted without being
+    // traversed. Unused children have no primitives.
+    uint32_t first[c_bvh_width];
+    uint32_t count[c_bvh_width];
+};
+
+// Bounding volume hierarchy over bounding spheres
+class BVH {
+    std::vector<BVHNode> m_nodes;
+    // Primitive indices in tree order
+    std::vector<uint32_t> m_prims;
+
+public:
+    bool empty() const {
+        return m_nodes.empty();
+    }
+
+    // Top down build with binned SAH. Subtrees of the root are built in
+    // parallel.
+    void build(const SphereBoundsSoA& bounds, ThreadPool& thread_pool);
+    // Recomputes node bounds for moved primitives, keeping the topology
+    void refit(const SphereBoundsSoA& bounds, ThreadPool& thread_pool);
+
+    // Writes 1 for spheres that intersect the frustum and 0 otherwise.
+    // Returns the number of culled spheres.
+    size_t cull(
+        const Frustum& frustum,
+        const SphereBoundsSoA& bounds,
+        std::vector<uint8_t>& visible
+    ) const;
+
+private:
+    uint32_t buildNode(
+        std::vector<BVHNode>& nodes,
+        uint32_t first, uint32_t count,
+        const SphereBoundsSoA& bounds
+    );
+    void refitNode(BVHNode& node, const SphereBoundsSoA& bounds) const;
+};
+}
@@ -0,0 +1,101 @@
+#include "Bounds.hpp"
+#include "Simd.hpp"
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <tuple>
+
+namespace VKR {
+namespace {
+std::tuple<glm::vec3, glm::vec3> computeAABB(std::span<const glm::vec3> vertices) {
+    static_assert(sizeof(glm::vec3) == 3 * sizeof(float));
+    auto data = reinterpret_cast<const float*>(vertices.data());
+    auto float_count = 3 * vertices.size();
+
+    constexpr auto inf = std::numeric_limits<float>::infinity();
+    std::array<float, 3> lo = {inf, inf, inf};
+    std::array<float, 3> hi = {-inf, -inf, -inf};
+
+    // Treat the vertices as a flat stream of floats. A block of 3 registers
+    // always starts with an x component, so lane k of the block holds
+    // component k % 3.
+    constexpr auto W = Simd::c_width;
+    size_t i = 0;
+    if (float_count >= 3 * W) {
+        Simd::Float vlo[3], vhi[3];
+        for (size_t j = 0; j < 3; j++) {
+            vlo[j] = vhi[j] = Simd::load(data + j * W);
+        }
+        for (i = 3 * W; i + 3 * W <= float_count; i += 3 * W) {
+            for (size_t j = 0; j < 3; j++) {
+                auto v = Simd::load(data + i + j * W);
+                vlo[j] = Simd::min(vlo[j], v);
+                vhi[j] = Simd::max(vhi[j], v);
+            }
+        }
+
+        std::array<float, 3 * W> lanes_lo, lanes_hi;
+        for (size_t j = 0; j < 3; j++) {
+            Simd::store(lanes_lo.data() + j * W, vlo[j]);
+            Simd::store(lanes_hi.data() + j * W, vhi[j]);
+        }
+        for (size_t k = 0; k < 3 * W; k++) {
+            lo[k % 3] = std::min(lo[k % 3], lanes_lo[k]);
+            hi[k % 3] = std::max(hi[k % 3], lanes_hi[k]);
+        }
+    }
+
+    for (; i < float_count; i++) {
+        lo[i % 3] = std::min(lo[i % 3], data[i]);
+        hi[i % 3] = std::max(hi[i % 3], data[i]);
+    }
+
+    return {
+        {lo[0], lo[1], lo[2]},
+        {hi[0], hi[1], hi[2]},
+    };
+}
+}
+
+MeshBounds computeMeshBounds(std::span<const glm::vec3> vertices) {
+    return computeMeshBounds(std::span(&vertices, 1));
+}
+
+MeshBounds computeMeshBounds(
+    std::span<const std::span<const glm::vec3>> parts
+) {
+    constexpr auto inf = std::numeric_limits<float>::infinity();
+    glm::vec3 lo(inf);
+    glm::vec3 hi(-inf);
+    for (auto vertices: parts) {
+        if (!vertices.empty()) {
+            auto [part_lo, part_hi] = computeAABB(vertices);
+            lo = glm::min(lo, part_lo);
+            hi = glm::max(hi, part_hi);
+        }
+    }
+    if (lo.x > hi.x) {
+        return {};
+    }
+
+    auto center = (lo + hi) * 0.5f;
+    float radius2 = 0.0f;
+    for (auto vertices: parts) {
+        for (const auto& v: vertices) {
+            auto d = v - center;
+            radius2 = std::max(radius2, glm::dot(d, d));
+        }
+    }
+
+    return {
+        .aabb_min = lo,
+        .aabb_max = hi,
+        .sphere = {center, std::sqrt(radius2)},
+    };
+}
+}
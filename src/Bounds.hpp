@@ -0,0 +1,20 @@
+#pragma once
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include <span>
+
+namespace VKR {
+struct MeshBounds {
+    glm::vec3 aabb_min = {};
+    glm::vec3 aabb_max = {};
+    // Center in xyz, radius in w
+    glm::vec4 sphere = {};
+};
+
+MeshBounds computeMeshBounds(std::span<const glm::vec3> vertices);
+// Bounds of all parts together
+MeshBounds computeMeshBounds(
+    std::span<const std::span<const glm::vec3>> parts
+);
+}
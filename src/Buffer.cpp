@@ -29,6 +29,18 @@ void Buffer::create(
     );
 }
 
+bool TransformBuffer::reserve(VmaAllocator allocator, size_t transform_count) {
+    if (transform_count <= capacity) {
+        return false;
+    }
+    auto new_capacity = std::max(transform_count, capacity * 2);
+    destroy(allocator);
+    buffer = createTransformBuffer(allocator, new_capacity * sizeof(glm::mat4));
+    transforms = static_cast<glm::mat4*>(getMappedData(allocator, buffer));
+    capacity = new_capacity;
+    return true;
+}
+
 void copyToDynamicBuffer(
     VmaAllocator allocator,
     std::span<const glm::vec3> vertices,
@@ -45,49 +57,4 @@ void copyToDynamicBuffer(
     std::ranges::copy(vertices, mapped_data);
     vmaFlushAllocation(allocator, allocation, offset_bytes, vertices.size_bytes());
 }
-
-void copyBuffer(
-    VkDevice device,
-    VkQueue queue,
-    VkBuffer from, VkBuffer to,
-    VkDeviceSize size, VkDeviceSize src_offset, VkDeviceSize dst_offset,
-    VkCommandPool cmd_pool
-) {
-    VkCommandBufferAllocateInfo send_cmd_buffer_alloc_info = {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-        .commandPool = cmd_pool,
-        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-        .commandBufferCount = 1,
-    };
-
-    VkCommandBuffer send_cmd_buffer;
-    vkAllocateCommandBuffers(device, &send_cmd_buffer_alloc_info, &send_cmd_buffer);
-
-    VkCommandBufferBeginInfo begin_info = {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
-    };
-    vkBeginCommandBuffer(send_cmd_buffer, &begin_info);
-
-    VkBufferCopy copy_info = {
-        .srcOffset = src_offset,
-        .dstOffset = dst_offset,
-        .size = size,
-    };
-    vkCmdCopyBuffer(send_cmd_buffer, from, to, 1, &copy_info);
-
-    vkEndCommandBuffer(send_cmd_buffer);
-
-    VkSubmitInfo submit_info = {
-        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .commandBufferCount = 1,
-        .pCommandBuffers = &send_cmd_buffer,
-    };
-    vkQueueSubmit(queue, 1, &submit_info, VK_NULL_HANDLE);
-
-    // TODO: uploads should be asynchronous
-    vkQueueWaitIdle(queue);
-
-    vkFreeCommandBuffers(device, cmd_pool, 1, &send_cmd_buffer);
-}
 }
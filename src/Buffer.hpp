@@ -1,4 +1,5 @@
 #pragma once
+#include <glm/mat4x4.hpp>
 #include <glm/vec3.hpp>
 
 #include <vk_mem_alloc.h>
@@ -23,6 +24,12 @@ struct Buffer {
     }
 };
 
+inline void* getMappedData(VmaAllocator allocator, const Buffer& buffer) {
+    VmaAllocationInfo alloc_info;
+    vmaGetAllocationInfo(allocator, buffer.allocation, &alloc_info);
+    return alloc_info.pMappedData;
+}
+
 inline auto createBuffer(
     VmaAllocator allocator,
     size_t size,
@@ -75,27 +82,62 @@ inline auto createDynamicBuffer(
     );
 }
 
-void copyToDynamicBuffer(
+inline auto createTransformBuffer(
     VmaAllocator allocator,
-    std::span<const glm::vec3> vertices,
-    VmaAllocation allocation,
-    size_t current_frame, size_t frame_count 
-);
+    size_t size
+) {
+    return createBuffer(
+        allocator,
+        size,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VMA_ALLOCATION_CREATE_MAPPED_BIT,
+        VMA_MEMORY_USAGE_CPU_TO_GPU
+    );
+}
 
-inline void copyToStagingBuffer(
+inline auto createUniformBuffer(
     VmaAllocator allocator,
-    std::span<const glm::vec3> vertices,
-    VmaAllocation allocation
+    size_t size
 ) {
-    // TODO: this a bit inefficient 
-    copyToDynamicBuffer(allocator, vertices, allocation, 0, 1);
+    return createBuffer(
+        allocator,
+        size,
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+        VMA_ALLOCATION_CREATE_MAPPED_BIT,
+        VMA_MEMORY_USAGE_CPU_TO_GPU
+    );
 }
 
-void copyBuffer(
-    VkDevice device,
-    VkQueue queue,
-    VkBuffer from, VkBuffer to,
-    VkDeviceSize size, VkDeviceSize src_offset, VkDeviceSize dst_offset,
-    VkCommandPool cmd_pool
+// Persistently mapped storage buffer holding the model matrices of all
+// draws of one frame in flight
+struct TransformBuffer {
+    Buffer buffer;
+    glm::mat4* transforms = nullptr;
+    size_t capacity = 0;
+
+    // Returns true if the buffer was reallocated
+    bool reserve(VmaAllocator allocator, size_t transform_count);
+
+    void destroy(VmaAllocator allocator) {
+        if (capacity) {
+            buffer.destroy(allocator);
+        }
+        transforms = nullptr;
+        capacity = 0;
+    }
+
+    void flush(VmaAllocator allocator, size_t first, size_t count) {
+        vmaFlushAllocation(
+            allocator, buffer.allocation,
+            first * sizeof(glm::mat4), count * sizeof(glm::mat4)
+        );
+    }
+};
+
+void copyToDynamicBuffer(
+    VmaAllocator allocator,
+    std::span<const glm::vec3> vertices,
+    VmaAllocation allocation,
+    size_t current_frame, size_t frame_count 
 );
 }
@@ -0,0 +1,75 @@
+#include "BufferPool.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+namespace VKR {
+void BufferPool::create(
+    VmaAllocator allocator,
+    uint32_t element_size, uint32_t block_size,
+    VkBufferUsageFlags usage
+) {
+    assert(element_size > 0 and block_size > 0);
+    m_allocator = allocator;
+    m_element_size = element_size;
+    m_block_size = block_size;
+    m_usage = usage;
+}
+
+void BufferPool::destroy() {
+    for (auto& block: m_blocks) {
+        block.buffer.destroy(m_allocator);
+    }
+    m_blocks.clear();
+}
+
+BufferPool::Range BufferPool::allocate(uint32_t count) {
+    assert(count > 0);
+    for (uint32_t b = 0; b < m_blocks.size(); b++) {
+        auto allocation = m_blocks[b].allocator.allocate(count);
+        if (allocation.offset != OffsetAllocator::c_no_space) {
+            return {
+                .block = b,
+                .first = allocation.offset,
+                .count = count,
+                .allocation = allocation,
+            };
+        }
+    }
+
+    auto& block = m_blocks.emplace_back();
+    auto size = std::max(count, m_block_size);
+    block.buffer = createBuffer(
+        m_allocator, size_t(size) * m_element_size,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | m_usage,
+        0, VMA_MEMORY_USAGE_GPU_ONLY
+    );
+    block.allocator.create(size);
+    auto allocation = block.allocator.allocate(count);
+    assert(allocation.offset != OffsetAllocator::c_no_space);
+    return {
+        .block = static_cast<uint32_t>(m_blocks.size() - 1),
+        .first = allocation.offset,
+        .count = count,
+        .allocation = allocation,
+    };
+}
+
+void BufferPool::free(const Range& range) {
+    m_blocks[range.block].allocator.free(range.allocation);
+}
+
+BufferPool::Stats BufferPool::stats() const {
+    Stats stats;
+    for (const auto& block: m_blocks) {
+        auto s = block.allocator.stats();
+        stats.capacity += block.allocator.size();
+        stats.free_elements += s.free_size;
+        stats.free_range_count += s.free_range_count;
+        stats.largest_free_range = std::max(
+            stats.largest_free_range, s.largest_free_range
+        );
+    }
+    return stats;
+}
+}
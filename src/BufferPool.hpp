@@ -0,0 +1,60 @@
+#pragma once
+#include "Buffer.hpp"
+#include "OffsetAllocator.hpp"
+
+#include <vector>
+
+namespace VKR {
+// Device-local buffers of elements shared by static meshes. Meshes get a
+// range of one of a few large blocks, so that draws only rebind buffers
+// when the block changes. Ranges larger than a block get a block of their
+// own.
+class BufferPool {
+    struct Block {
+        Buffer buffer;
+        OffsetAllocator allocator;
+    };
+
+    VmaAllocator m_allocator = VK_NULL_HANDLE;
+    uint32_t m_element_size = 0;
+    uint32_t m_block_size = 0;
+    VkBufferUsageFlags m_usage = 0;
+    std::vector<Block> m_blocks;
+
+public:
+    // Ranges are in elements
+    struct Range {
+        uint32_t block = 0;
+        uint32_t first = 0;
+        uint32_t count = 0;
+        OffsetAllocator::Allocation allocation;
+    };
+
+    struct Stats {
+        uint64_t capacity = 0;
+        uint64_t free_elements = 0;
+        uint32_t free_range_count = 0;
+        uint32_t largest_free_range = 0;
+    };
+
+    void create(
+        VmaAllocator allocator,
+        uint32_t element_size, uint32_t block_size,
+        VkBufferUsageFlags usage
+    );
+    void destroy();
+
+    Range allocate(uint32_t count);
+    void free(const Range& range);
+
+    VkBuffer buffer(uint32_t block) const {
+        return m_blocks[block].buffer.buffer;
+    }
+
+    uint32_t elementSize() const {
+        return m_element_size;
+    }
+
+    Stats stats() const;
+};
+}
@@ -0,0 +1,627 @@
+#include "ClusterCulling.hpp"
+#include "IDPacking.hpp"
+#include "Shader.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstring>
+#include <tuple>
+
+namespace VKR {
+namespace {
+constexpr uint32_t c_cull_clusters_spv[] = {
+#include "CullClusters.comp.inc"
+};
+
+// Every cluster is culled and written out by one workgroup, so the
+// dispatch is spread over two dimensions to stay within the guaranteed
+// workgroup count limit
+constexpr uint32_t c_max_group_count_x = 65535;
+
+// Frustum planes are extracted from proj_view in the shader, which keeps
+// the push constants within 128 bytes
+struct ClusterCullPushConstants {
+    glm::mat4 proj_view;
+    glm::vec4 camera_position;
+    glm::vec2 viewport_size;
+    uint32_t instance_count;
+};
+static_assert(sizeof(ClusterCullPushConstants) <= 128);
+
+enum ClusterBinding: uint32_t {
+    Transforms,
+    Instances,
+    Meshlets,
+    MeshletVertices,
+    MeshletTriangles,
+    Commands,
+    Indices,
+    MeshletPositions,
+    Counters,
+    Count,
+};
+
+VkDescriptorSetLayout createClusterSetLayout(VkDevice device) {
+    std::array<VkDescriptorSetLayoutBinding, ClusterBinding::Count> bindings;
+    for (uint32_t i = 0; i < bindings.size(); i++) {
+        bindings[i] = {
+            .binding = i,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        };
+    }
+
+    VkDescriptorSetLayoutCreateInfo create_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = bindings.size(),
+        .pBindings = bindings.data(),
+    };
+
+    VkDescriptorSetLayout layout;
+    vkCreateDescriptorSetLayout(device, &create_info, nullptr, &layout);
+    return layout;
+}
+
+VkPipelineLayout createClusterPipelineLayout(
+    VkDevice device, VkDescriptorSetLayout set_layout
+) {
+    VkPushConstantRange push_range = {
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .size = sizeof(ClusterCullPushConstants),
+    };
+    VkPipelineLayoutCreateInfo create_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &set_layout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &push_range,
+    };
+    VkPipelineLayout layout;
+    vkCreatePipelineLayout(device, &create_info, nullptr, &layout);
+    return layout;
+}
+
+VkPipeline createClusterPipeline(
+    VkDevice device, VkPipelineLayout layout, bool cull_triangles
+) {
+    auto shader_module = createShaderModule(device, c_cull_clusters_spv);
+
+    VkBool32 cull_triangles_constant = cull_triangles;
+    VkSpecializationMapEntry entry = {
+        .constantID = 0,
+        .offset = 0,
+        .size = sizeof(cull_triangles_constant),
+    };
+    VkSpecializationInfo specialization_info = {
+        .mapEntryCount = 1,
+        .pMapEntries = &entry,
+        .dataSize = sizeof(cull_triangles_constant),
+        .pData = &cull_triangles_constant,
+    };
+
+    VkComputePipelineCreateInfo create_info = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .stage = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            .module = shader_module,
+            .pName = "main",
+            .pSpecializationInfo = &specialization_info,
+        },
+        .layout = layout,
+    };
+
+    VkPipeline pipeline;
+    vkCreateComputePipelines(device, nullptr, 1, &create_info, nullptr, &pipeline);
+
+    vkDestroyShaderModule(device, shader_module, nullptr);
+
+    return pipeline;
+}
+
+VkDescriptorPool createClusterDescriptorPool(VkDevice device, size_t set_count) {
+    VkDescriptorPoolSize pool_size = {
+        .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .descriptorCount = static_cast<uint32_t>(set_count * ClusterBinding::Count),
+    };
+    VkDescriptorPoolCreateInfo create_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .maxSets = static_cast<uint32_t>(set_count),
+        .poolSizeCount = 1,
+        .pPoolSizes = &pool_size,
+    };
+    VkDescriptorPool pool;
+    vkCreateDescriptorPool(device, &create_info, nullptr, &pool);
+    return pool;
+}
+
+auto createGPUOnlyBuffer(
+    VmaAllocator allocator,
+    size_t size,
+    VkBufferUsageFlags usage
+) {
+    return createBuffer(allocator, size, usage, 0, VMA_MEMORY_USAGE_GPU_ONLY);
+}
+}
+
+void ClusterCulling::create(
+    VkDevice device, VmaAllocator allocator, size_t frame_count,
+    bool cull_triangles, float timestamp_period
+) {
+    m_device = device;
+    m_allocator = allocator;
+    m_cull_triangles = cull_triangles;
+    m_set_layout = createClusterSetLayout(m_device);
+    m_layout = createClusterPipelineLayout(m_device, m_set_layout);
+    m_pipeline = createClusterPipeline(m_device, m_layout, m_cull_triangles);
+    m_descriptor_pool = createClusterDescriptorPool(m_device, frame_count);
+
+    m_frames.resize(frame_count);
+    std::vector<VkDescriptorSetLayout> set_layouts(frame_count, m_set_layout);
+    std::vector<VkDescriptorSet> sets(frame_count);
+    VkDescriptorSetAllocateInfo alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = m_descriptor_pool,
+        .descriptorSetCount = static_cast<uint32_t>(frame_count),
+        .pSetLayouts = set_layouts.data(),
+    };
+    vkAllocateDescriptorSets(m_device, &alloc_info, sets.data());
+    for (size_t i = 0; i < frame_count; i++) {
+        auto& f = m_frames[i];
+        f.set = sets[i];
+        f.counters = createBuffer(
+            m_allocator, sizeof(TriangleCounters),
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VMA_ALLOCATION_CREATE_MAPPED_BIT,
+            VMA_MEMORY_USAGE_GPU_TO_CPU
+        );
+    }
+
+    m_timestamp_period = timestamp_period;
+    if (m_timestamp_period > 0.0f) {
+        VkQueryPoolCreateInfo create_info = {
+            .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+            .queryType = VK_QUERY_TYPE_TIMESTAMP,
+            .queryCount = static_cast<uint32_t>(2 * frame_count),
+        };
+        vkCreateQueryPool(m_device, &create_info, nullptr, &m_query_pool);
+    }
+}
+
+void ClusterCulling::destroy() {
+    if (!m_device) {
+        return;
+    }
+
+    for (auto& f: m_frames) {
+        f.commands.destroy(m_allocator);
+        f.indices.destroy(m_allocator);
+        f.counters.destroy(m_allocator);
+    }
+    m_frames.clear();
+    m_meshlets.destroy(m_allocator);
+    m_meshlet_vertices.destroy(m_allocator);
+    m_meshlet_positions.destroy(m_allocator);
+    m_meshlet_triangles.destroy(m_allocator);
+    m_instances.destroy(m_allocator);
+    m_command_templates.destroy(m_allocator);
+
+    vkDestroyQueryPool(m_device, m_query_pool, nullptr);
+    vkDestroyDescriptorPool(m_device, m_descriptor_pool, nullptr);
+    vkDestroyPipeline(m_device, m_pipeline, nullptr);
+    vkDestroyPipelineLayout(m_device, m_layout, nullptr);
+    vkDestroyDescriptorSetLayout(m_device, m_set_layout, nullptr);
+    m_device = VK_NULL_HANDLE;
+}
+
+bool ClusterCulling::update(
+    Uploader& uploader, VkCommandBuffer cmd_buffer,
+    const ModelStorage& models,
+    std::span<const StaticMesh> meshes,
+    VkBuffer transforms
+) {
+    bool changed = false;
+    m_upload_value = 0;
+    if (m_meshes_dirty or m_models_dirty) {
+        // Resident buffers are shared by all frames in flight, and they
+        // only change when meshes or models are created
+        if (m_instance_count) {
+            vkDeviceWaitIdle(m_device);
+        }
+        if (m_meshes_dirty) {
+            updateMeshlets(uploader, cmd_buffer, meshes);
+        }
+        updateModels(uploader, cmd_buffer, models, meshes);
+        m_meshes_dirty = m_models_dirty = false;
+        changed = true;
+    }
+    if (m_transforms != transforms) {
+        m_transforms = transforms;
+        changed = true;
+    }
+    if (changed and m_instance_count) {
+        updateDescriptorSets();
+    }
+    return changed;
+}
+
+// Replaces buffer with a storage buffer holding data. The buffer is also
+// the source of copies, which only happen after the acquire.
+template <typename T>
+void ClusterCulling::uploadStorageBuffer(
+    Uploader& uploader, VkCommandBuffer cmd_buffer,
+    Buffer& buffer, std::span<const T> data
+) {
+    buffer.destroy(m_allocator);
+    buffer = {};
+    if (data.empty()) {
+        return;
+    }
+    buffer = createGPUOnlyBuffer(
+        m_allocator, data.size_bytes(),
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+    );
+    m_upload_value = uploader.upload(buffer.buffer, std::as_bytes(data));
+    Uploader::Range range = {
+        .buffer = buffer.buffer,
+        .offset = 0,
+        .size = data.size_bytes(),
+    };
+    uploader.recordAcquire(
+        cmd_buffer, std::span(&range, 1),
+        VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_SHADER_READ_BIT
+    );
+}
+
+void ClusterCulling::updateMeshlets(
+    Uploader& uploader, VkCommandBuffer cmd_buffer,
+    std::span<const StaticMesh> meshes
+) {
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> vertices;
+    std::vector<float> positions;
+    std::vector<uint32_t> triangles;
+    m_mesh_first_meshlets.resize(meshes.size());
+    for (size_t i = 0; i < meshes.size(); i++) {
+        // Meshlets are built in mesh space, and culled with draw transforms.
+        // Quantization scales uniformly, so cones are unchanged.
+        const auto& data = meshes[i].meshlets;
+        const auto& quantization = meshes[i].quantization;
+        m_mesh_first_meshlets[i] = meshlets.size();
+        for (auto m: data.meshlets) {
+            m.sphere = quantization.quantizeSphere(m.sphere);
+            m.vertex_offset += vertices.size();
+            m.triangle_offset += triangles.size();
+            meshlets.push_back(m);
+        }
+        vertices.insert(vertices.end(), data.vertices.begin(), data.vertices.end());
+        if (m_cull_triangles) {
+            // Tightly packed, vec3 arrays have a stride of 16 in std430
+            for (const auto& mesh_p: data.positions) {
+                auto p = quantization.quantize(mesh_p);
+                positions.insert(positions.end(), {p.x, p.y, p.z});
+            }
+        }
+        triangles.insert(triangles.end(), data.triangles.begin(), data.triangles.end());
+    }
+
+    uploadStorageBuffer(
+        uploader, cmd_buffer,
+        m_meshlets, std::span<const Meshlet>(meshlets)
+    );
+    uploadStorageBuffer(
+        uploader, cmd_buffer,
+        m_meshlet_vertices, std::span<const uint32_t>(vertices)
+    );
+    uploadStorageBuffer(
+        uploader, cmd_buffer,
+        m_meshlet_triangles, std::span<const uint32_t>(triangles)
+    );
+    if (m_cull_triangles) {
+        uploadStorageBuffer(
+            uploader, cmd_buffer,
+            m_meshlet_positions, std::span<const float>(positions)
+        );
+    }
+}
+
+void ClusterCulling::updateModels(
+    Uploader& uploader, VkCommandBuffer cmd_buffer,
+    const ModelStorage& models,
+    std::span<const StaticMesh> meshes
+) {
+    auto getMeshlets = [&](size_t model) -> const MeshletData& {
+        return meshes[getMeshIndex(models.mesh(model))].meshlets;
+    };
+
+    std::vector<uint32_t> order;
+    for (uint32_t i = 0; i < models.size(); i++) {
+        if (!getMeshlets(i).empty()) {
+            order.push_back(i);
+        }
+    }
+    // Cluster draws read indices from the culling pass, so only the
+    // vertices of their meshes split buckets
+    auto getBucketKey = [&](uint32_t i) {
+        const auto& mesh = meshes[getMeshIndex(models.mesh(i))];
+        return std::tuple(
+            models.material(i), mesh.vertex_format, mesh.vertices.block
+        );
+    };
+    std::ranges::sort(order, {}, getBucketKey);
+
+    m_buckets.clear();
+    std::vector<VkDrawIndexedIndirectCommand> commands;
+    std::vector<GPUClusterInstance> instances;
+    uint32_t index_count = 0;
+    for (auto i: order) {
+        auto mesh = models.mesh(i);
+        auto [material, vertex_format, vertex_block] = getBucketKey(i);
+        if (
+            m_buckets.empty() or
+            m_buckets.back().material != material or
+            m_buckets.back().vertex_format != vertex_format or
+            m_buckets.back().vertex_block != vertex_block
+        ) {
+            m_buckets.push_back({
+                .material = material,
+                .vertex_format = vertex_format,
+                .vertex_block = vertex_block,
+                .first_command = static_cast<uint32_t>(commands.size()),
+                .command_count = 0,
+            });
+        }
+        m_buckets.back().command_count++;
+
+        const auto& data = getMeshlets(i);
+        auto first_meshlet = m_mesh_first_meshlets[getMeshIndex(mesh)];
+        for (uint32_t m = 0; m < data.meshlets.size(); m++) {
+            instances.push_back({
+                .model = i,
+                .meshlet = first_meshlet + m,
+                .command = static_cast<uint32_t>(commands.size()),
+            });
+        }
+        commands.push_back({
+            .indexCount = 0,
+            .instanceCount = 1,
+            .firstIndex = index_count,
+            // Meshlet vertices are relative to the full detail level
+            .vertexOffset = static_cast<int32_t>(
+                meshes[getMeshIndex(mesh)].vertices.first
+            ),
+            .firstInstance = i,
+        });
+        index_count += 3 * data.triangles.size();
+    }
+    m_instance_count = instances.size();
+    m_command_count = commands.size();
+
+    uploadStorageBuffer(
+        uploader, cmd_buffer,
+        m_instances, std::span<const GPUClusterInstance>(instances)
+    );
+    uploadStorageBuffer(
+        uploader, cmd_buffer,
+        m_command_templates,
+        std::span<const VkDrawIndexedIndirectCommand>(commands)
+    );
+
+    if (m_command_count > m_command_capacity) {
+        m_command_capacity = std::max<size_t>(m_command_count, 2 * m_command_capacity);
+        for (auto& f: m_frames) {
+            f.commands.destroy(m_allocator);
+            f.commands = createGPUOnlyBuffer(
+                m_allocator,
+                m_command_capacity * sizeof(VkDrawIndexedIndirectCommand),
+                VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT
+            );
+        }
+    }
+    // Index ranges are sized for whole meshes, so they are not grown ahead
+    if (index_count > m_index_capacity) {
+        m_index_capacity = index_count;
+        for (auto& f: m_frames) {
+            f.indices.destroy(m_allocator);
+            f.indices = createGPUOnlyBuffer(
+                m_allocator, m_index_capacity * sizeof(uint32_t),
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                VK_BUFFER_USAGE_INDEX_BUFFER_BIT
+            );
+        }
+    }
+}
+
+void ClusterCulling::updateDescriptorSets() {
+    for (auto& f: m_frames) {
+        std::array<VkDescriptorBufferInfo, ClusterBinding::Count> buffer_infos;
+        buffer_infos[ClusterBinding::Transforms] = {
+            .buffer = m_transforms, .range = VK_WHOLE_SIZE,
+        };
+        buffer_infos[ClusterBinding::Instances] = {
+            .buffer = m_instances.buffer, .range = VK_WHOLE_SIZE,
+        };
+        buffer_infos[ClusterBinding::Meshlets] = {
+            .buffer = m_meshlets.buffer, .range = VK_WHOLE_SIZE,
+        };
+        buffer_infos[ClusterBinding::MeshletVertices] = {
+            .buffer = m_meshlet_vertices.buffer, .range = VK_WHOLE_SIZE,
+        };
+        buffer_infos[ClusterBinding::MeshletTriangles] = {
+            .buffer = m_meshlet_triangles.buffer, .range = VK_WHOLE_SIZE,
+        };
+        buffer_infos[ClusterBinding::Commands] = {
+            .buffer = f.commands.buffer, .range = VK_WHOLE_SIZE,
+        };
+        buffer_infos[ClusterBinding::Indices] = {
+            .buffer = f.indices.buffer, .range = VK_WHOLE_SIZE,
+        };
+        // Without triangle culling the shader never reads positions
+        buffer_infos[ClusterBinding::MeshletPositions] = {
+            .buffer = m_cull_triangles ?
+                m_meshlet_positions.buffer : m_meshlet_vertices.buffer,
+            .range = VK_WHOLE_SIZE,
+        };
+        buffer_infos[ClusterBinding::Counters] = {
+            .buffer = f.counters.buffer, .range = VK_WHOLE_SIZE,
+        };
+
+        std::array<VkWriteDescriptorSet, ClusterBinding::Count> writes;
+        for (uint32_t i = 0; i < writes.size(); i++) {
+            writes[i] = {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = f.set,
+                .dstBinding = i,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .pBufferInfo = &buffer_infos[i],
+            };
+        }
+        vkUpdateDescriptorSets(m_device, writes.size(), writes.data(), 0, nullptr);
+    }
+}
+
+void ClusterCulling::recordCulling(
+    VkCommandBuffer cmd_buffer, size_t frame,
+    const glm::mat4& proj_view, const glm::vec3& camera_position,
+    const glm::vec2& viewport_size
+) {
+    auto& f = m_frames[frame];
+    if (!m_instance_count) {
+        f.timed = f.counted = false;
+        return;
+    }
+
+    if (m_query_pool) {
+        vkCmdResetQueryPool(cmd_buffer, m_query_pool, 2 * frame, 2);
+        vkCmdWriteTimestamp(
+            cmd_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+            m_query_pool, 2 * frame
+        );
+    }
+
+    {
+        VkBufferCopy region = {
+            .size = m_command_count * sizeof(VkDrawIndexedIndirectCommand),
+        };
+        vkCmdCopyBuffer(
+            cmd_buffer, m_command_templates.buffer, f.commands.buffer,
+            1, &region
+        );
+        if (m_cull_triangles) {
+            vkCmdFillBuffer(cmd_buffer, f.counters.buffer, 0, VK_WHOLE_SIZE, 0);
+        }
+        VkMemoryBarrier barrier = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask =
+                VK_ACCESS_SHADER_READ_BIT |
+                VK_ACCESS_SHADER_WRITE_BIT,
+        };
+        vkCmdPipelineBarrier(
+            cmd_buffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 1, &barrier, 0, nullptr, 0, nullptr
+        );
+    }
+
+    ClusterCullPushConstants push_constants = {
+        .proj_view = proj_view,
+        .camera_position = glm::vec4(camera_position, 1.0f),
+        .viewport_size = viewport_size,
+        .instance_count = m_instance_count,
+    };
+    vkCmdBindPipeline(cmd_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+    vkCmdBindDescriptorSets(
+        cmd_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_layout,
+        0, 1, &f.set, 0, nullptr
+    );
+    vkCmdPushConstants(
+        cmd_buffer, m_layout, VK_SHADER_STAGE_COMPUTE_BIT,
+        0, sizeof(push_constants), &push_constants
+    );
+    auto group_count_x = std::min(m_instance_count, c_max_group_count_x);
+    auto group_count_y = (m_instance_count + group_count_x - 1) / group_count_x;
+    vkCmdDispatch(cmd_buffer, group_count_x, group_count_y, 1);
+
+    {
+        VkMemoryBarrier barrier = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+            .dstAccessMask =
+                VK_ACCESS_INDIRECT_COMMAND_READ_BIT |
+                VK_ACCESS_INDEX_READ_BIT,
+        };
+        vkCmdPipelineBarrier(
+            cmd_buffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+            0, 1, &barrier, 0, nullptr, 0, nullptr
+        );
+    }
+    if (m_cull_triangles) {
+        VkMemoryBarrier barrier = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+        };
+        vkCmdPipelineBarrier(
+            cmd_buffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_HOST_BIT,
+            0, 1, &barrier, 0, nullptr, 0, nullptr
+        );
+        f.counted = true;
+    }
+
+    if (m_query_pool) {
+        vkCmdWriteTimestamp(
+            cmd_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            m_query_pool, 2 * frame + 1
+        );
+        f.timed = true;
+    }
+}
+
+float ClusterCulling::elapsedMs(size_t frame) const {
+    if (!m_frames[frame].timed) {
+        return 0.0f;
+    }
+    std::array<uint64_t, 2> timestamps;
+    auto result = vkGetQueryPoolResults(
+        m_device, m_query_pool, 2 * frame, 2,
+        sizeof(timestamps), timestamps.data(), sizeof(uint64_t),
+        VK_QUERY_RESULT_64_BIT
+    );
+    if (result != VK_SUCCESS) {
+        return 0.0f;
+    }
+    return (timestamps[1] - timestamps[0]) * m_timestamp_period * 1.0e-6f;
+}
+
+TriangleCounters ClusterCulling::triangleCounters(size_t frame) const {
+    const auto& f = m_frames[frame];
+    if (!f.counted) {
+        return {};
+    }
+    vmaInvalidateAllocation(
+        m_allocator, f.counters.allocation, 0, sizeof(TriangleCounters)
+    );
+    TriangleCounters counters;
+    std::memcpy(
+        &counters, getMappedData(m_allocator, f.counters),
+        sizeof(counters)
+    );
+    return counters;
+}
+}
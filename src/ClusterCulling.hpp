@@ -0,0 +1,180 @@
+#pragma once
+#include "Buffer.hpp"
+#include "Mesh.hpp"
+#include "Model.hpp"
+#include "Uploader.hpp"
+
+#include <glm/vec2.hpp>
+
+#include <vector>
+
+namespace VKR {
+struct GPUClusterInstance {
+    uint32_t model;
+    uint32_t meshlet;
+    uint32_t command;
+    uint32_t pad;
+};
+static_assert(sizeof(GPUClusterInstance) == 16);
+
+static_assert(sizeof(Meshlet) == 48);
+
+// Triangles of visible meshlets, and how many of them triangle culling
+// rejected for every reason
+struct TriangleCounters {
+    uint32_t tested = 0;
+    uint32_t degenerate = 0;
+    uint32_t back_facing = 0;
+    uint32_t outside = 0;
+    uint32_t small = 0;
+};
+
+// All models sharing a material and the vertex block of their meshes are
+// drawn with a single vkCmdDrawIndexedIndirect, with one command per model
+struct ClusterCullingBucket {
+    MaterialID material;
+    VertexFormat vertex_format;
+    uint32_t vertex_block;
+    uint32_t first_command;
+    uint32_t command_count;
+};
+
+// Culls the meshlets of static models by frustum and normal cone, and
+// compacts the indices of the visible ones into an index buffer. Every
+// model gets its own index range, sized for all of its mesh's triangles,
+// and its own indexed draw command. Optionally, the triangles of visible
+// meshlets are culled one by one before their indices are written.
+class ClusterCulling {
+    VkDevice m_device = VK_NULL_HANDLE;
+    VmaAllocator m_allocator = VK_NULL_HANDLE;
+
+    VkDescriptorSetLayout m_set_layout = VK_NULL_HANDLE;
+    VkPipelineLayout m_layout = VK_NULL_HANDLE;
+    VkPipeline m_pipeline = VK_NULL_HANDLE;
+    VkDescriptorPool m_descriptor_pool = VK_NULL_HANDLE;
+
+    bool m_cull_triangles = false;
+
+    // Two timestamps per frame around the culling pass
+    VkQueryPool m_query_pool = VK_NULL_HANDLE;
+    float m_timestamp_period = 0.0f;
+
+    struct Frame {
+        VkDescriptorSet set = VK_NULL_HANDLE;
+        Buffer commands;
+        Buffer indices;
+        // TriangleCounters, read back by the CPU
+        Buffer counters;
+        bool timed = false;
+        bool counted = false;
+    };
+    std::vector<Frame> m_frames;
+
+    VkBuffer m_transforms = VK_NULL_HANDLE;
+    uint64_t m_upload_value = 0;
+    Buffer m_meshlets;
+    Buffer m_meshlet_vertices;
+    Buffer m_meshlet_positions;
+    Buffer m_meshlet_triangles;
+    Buffer m_instances;
+    // Copied into every frame's commands before culling, which resets
+    // their index counts
+    Buffer m_command_templates;
+    size_t m_command_capacity = 0;
+    size_t m_index_capacity = 0;
+
+    // First meshlet of every mesh in m_meshlets
+    std::vector<uint32_t> m_mesh_first_meshlets;
+    std::vector<ClusterCullingBucket> m_buckets;
+    uint32_t m_instance_count = 0;
+    uint32_t m_command_count = 0;
+
+    bool m_models_dirty = true;
+    bool m_meshes_dirty = true;
+
+public:
+    // A timestamp period of 0 disables timing
+    void create(
+        VkDevice device, VmaAllocator allocator, size_t frame_count,
+        bool cull_triangles, float timestamp_period
+    );
+    void destroy();
+
+    void invalidateModels() {
+        m_models_dirty = true;
+    }
+
+    void invalidateMeshes() {
+        m_meshes_dirty = true;
+    }
+
+    // Uploads changed meshlets and models, and acquires the uploaded
+    // buffers in cmd_buffer. Returns true if the buckets or any buffer
+    // changed, which invalidates draws recorded with them.
+    bool update(
+        Uploader& uploader, VkCommandBuffer cmd_buffer,
+        const ModelStorage& models,
+        std::span<const StaticMesh> meshes,
+        VkBuffer transforms
+    );
+
+    // Uploader semaphore value that the submission of the last update's
+    // command buffer must wait for, 0 if it uploaded nothing
+    uint64_t uploadValue() const {
+        return m_upload_value;
+    }
+
+    // Transforms must have been uploaded. The viewport size is in pixels.
+    void recordCulling(
+        VkCommandBuffer cmd_buffer, size_t frame,
+        const glm::mat4& proj_view, const glm::vec3& camera_position,
+        const glm::vec2& viewport_size
+    );
+
+    // GPU time of the frame's last executed culling pass, 0 if unknown.
+    // Doesn't wait for results, so it must be called after the frame's
+    // fence.
+    float elapsedMs(size_t frame) const;
+
+    // Counters of the frame's last executed culling pass, with triangle
+    // culling. Must be called after the frame's fence.
+    TriangleCounters triangleCounters(size_t frame) const;
+
+    std::span<const ClusterCullingBucket> buckets() const {
+        return m_buckets;
+    }
+
+    void bindIndexBuffer(VkCommandBuffer cmd_buffer, size_t frame) {
+        vkCmdBindIndexBuffer(
+            cmd_buffer, m_frames[frame].indices.buffer, 0,
+            VK_INDEX_TYPE_UINT32
+        );
+    }
+
+    void drawBucket(VkCommandBuffer cmd_buffer, size_t frame, size_t bucket) {
+        const auto& b = m_buckets[bucket];
+        vkCmdDrawIndexedIndirect(
+            cmd_buffer, m_frames[frame].commands.buffer,
+            b.first_command * sizeof(VkDrawIndexedIndirectCommand),
+            b.command_count, sizeof(VkDrawIndexedIndirectCommand)
+        );
+    }
+
+private:
+    template <typename T>
+    void uploadStorageBuffer(
+        Uploader& uploader, VkCommandBuffer cmd_buffer,
+        Buffer& buffer, std::span<const T> data
+    );
+    void updateMeshlets(
+        Uploader& uploader, VkCommandBuffer cmd_buffer,
+        std::span<const StaticMesh> meshes
+    );
+    void updateModels(
+        Uploader& uploader, VkCommandBuffer cmd_buffer,
+        const ModelStorage& models,
+        std::span<const StaticMesh> meshes
+    );
+    void updateDescriptorSets();
+};
+}
@@ -0,0 +1,68 @@
+#include "Culling.hpp"
+
+#include <cassert>
+
+namespace VKR {
+void transformBounds(
+    std::span<const glm::mat4> transforms,
+    std::span<const glm::vec4> local_spheres,
+    const glm::vec4& w_row,
+    SphereBoundsSoA& bounds,
+    std::vector<float>& view_depths
+) {
+    assert(transforms.size() == local_spheres.size());
+    constexpr auto W = Simd::c_width;
+    auto count = transforms.size();
+    bounds.resize(count);
+    view_depths.resize(Simd::roundUp(count));
+
+    Simd::Float w[4] = {
+        Simd::set1(w_row.x), Simd::set1(w_row.y),
+        Simd::set1(w_row.z), Simd::set1(w_row.w),
+    };
+
+    // Transpose W matrices at a time with strided gathers, so that every
+    // register holds the same matrix element of W models
+    size_t i = 0;
+    for (; i + W <= count; i += W) {
+        auto m = [&](int c, int r) {
+            return Simd::gather(&transforms[i][c][r], 16);
+        };
+        auto s = [&](int c) {
+            return Simd::gather(&local_spheres[i][c], 4);
+        };
+        auto x = s(0), y = s(1), z = s(2), r = s(3);
+
+        auto wx = Simd::fmadd(m(0, 0), x, Simd::fmadd(m(1, 0), y, Simd::fmadd(m(2, 0), z, m(3, 0))));
+        auto wy = Simd::fmadd(m(0, 1), x, Simd::fmadd(m(1, 1), y, Simd::fmadd(m(2, 1), z, m(3, 1))));
+        auto wz = Simd::fmadd(m(0, 2), x, Simd::fmadd(m(1, 2), y, Simd::fmadd(m(2, 2), z, m(3, 2))));
+
+        auto length2 = [&](int c) {
+            return Simd::fmadd(m(c, 0), m(c, 0),
+                Simd::fmadd(m(c, 1), m(c, 1), Simd::mul(m(c, 2), m(c, 2))));
+        };
+        auto scale = Simd::sqrt(Simd::max(
+            Simd::max(length2(0), length2(1)), length2(2)
+        ));
+
+        auto depth =
+            Simd::fmadd(w[0], m(3, 0),
+            Simd::fmadd(w[1], m(3, 1),
+            Simd::fmadd(w[2], m(3, 2), Simd::mul(w[3], m(3, 3)))));
+
+        Simd::store(bounds.x.data() + i, wx);
+        Simd::store(bounds.y.data() + i, wy);
+        Simd::store(bounds.z.data() + i, wz);
+        Simd::store(bounds.radius.data() + i, Simd::mul(r, scale));
+        Simd::store(view_depths.data() + i, depth);
+    }
+
+    for (; i < count; i++) {
+        const auto& t = transforms[i];
+        const auto& sphere = local_spheres[i];
+        auto center = glm::vec3(t * glm::vec4(glm::vec3(sphere), 1.0f));
+        bounds.set(i, center, sphere.w * getMaxScale(t));
+        view_depths[i] = glm::dot(w_row, t[3]);
+    }
+}
+}
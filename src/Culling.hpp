@@ -0,0 +1,42 @@
+#pragma once
+#include "Frustum.hpp"
+#include "Simd.hpp"
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace VKR {
+// World space bounding spheres, padded to a multiple of the SIMD width
+struct SphereBoundsSoA {
+    std::vector<float> x, y, z, radius;
+    size_t count = 0;
+
+    void resize(size_t new_count) {
+        count = new_count;
+        auto padded = Simd::roundUp(count);
+        x.resize(padded);
+        y.resize(padded);
+        z.resize(padded);
+        radius.resize(padded);
+    }
+
+    void set(size_t i, const glm::vec3& center, float r) {
+        x[i] = center.x;
+        y[i] = center.y;
+        z[i] = center.z;
+        radius[i] = r;
+    }
+};
+
+// Transforms the local bounding sphere of every model to world space and
+// computes its clip space w, which is the view depth for a perspective
+// projection
+void transformBounds(
+    std::span<const glm::mat4> transforms,
+    std::span<const glm::vec4> local_spheres,
+    const glm::vec4& w_row,
+    SphereBoundsSoA& bounds,
+    std::vector<float>& view_depths
+);
+}
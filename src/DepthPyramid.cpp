@@ -0,0 +1,273 @@
+#include "DepthPyramid.hpp"
+#include "Shader.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+
+namespace VKR {
+namespace {
+constexpr uint32_t c_depth_pyramid_spv[] = {
+#include "DepthPyramid.comp.inc"
+};
+
+constexpr uint32_t c_pyramid_group_size = 8;
+
+VkDescriptorSetLayout createPyramidSetLayout(VkDevice device) {
+    std::array bindings = {
+        VkDescriptorSetLayoutBinding {
+            .binding = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        },
+        VkDescriptorSetLayoutBinding {
+            .binding = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        },
+    };
+
+    VkDescriptorSetLayoutCreateInfo create_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = bindings.size(),
+        .pBindings = bindings.data(),
+    };
+
+    VkDescriptorSetLayout layout;
+    vkCreateDescriptorSetLayout(device, &create_info, nullptr, &layout);
+    return layout;
+}
+
+VkPipelineLayout createPyramidPipelineLayout(
+    VkDevice device, VkDescriptorSetLayout set_layout
+) {
+    VkPipelineLayoutCreateInfo create_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &set_layout,
+    };
+    VkPipelineLayout layout;
+    vkCreatePipelineLayout(device, &create_info, nullptr, &layout);
+    return layout;
+}
+
+VkPipeline createPyramidPipeline(VkDevice device, VkPipelineLayout layout) {
+    auto shader_module = createShaderModule(device, c_depth_pyramid_spv);
+
+    VkComputePipelineCreateInfo create_info = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .stage = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            .module = shader_module,
+            .pName = "main",
+        },
+        .layout = layout,
+    };
+
+    VkPipeline pipeline;
+    vkCreateComputePipelines(device, nullptr, 1, &create_info, nullptr, &pipeline);
+
+    vkDestroyShaderModule(device, shader_module, nullptr);
+
+    return pipeline;
+}
+
+VkDescriptorPool createPyramidDescriptorPool(VkDevice device, uint32_t set_count) {
+    std::array pool_sizes = {
+        VkDescriptorPoolSize {
+            .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = set_count,
+        },
+        VkDescriptorPoolSize {
+            .type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .descriptorCount = set_count,
+        },
+    };
+    VkDescriptorPoolCreateInfo create_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .maxSets = set_count,
+        .poolSizeCount = pool_sizes.size(),
+        .pPoolSizes = pool_sizes.data(),
+    };
+    VkDescriptorPool pool;
+    vkCreateDescriptorPool(device, &create_info, nullptr, &pool);
+    return pool;
+}
+
+// Texels are read with texelFetch, so the sampler never filters
+VkSampler createPyramidSampler(VkDevice device) {
+    VkSamplerCreateInfo create_info = {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .magFilter = VK_FILTER_NEAREST,
+        .minFilter = VK_FILTER_NEAREST,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .maxLod = VK_LOD_CLAMP_NONE,
+    };
+    VkSampler sampler;
+    vkCreateSampler(device, &create_info, nullptr, &sampler);
+    return sampler;
+}
+}
+
+void DepthPyramid::create(
+    VkDevice device, VmaAllocator allocator,
+    VkImageView depth_view, uint32_t width, uint32_t height
+) {
+    m_device = device;
+    m_width = std::bit_floor(std::max(width, 1u));
+    m_height = std::bit_floor(std::max(height, 1u));
+    m_mip_count = std::bit_width(std::max(m_width, m_height));
+
+    constexpr auto format = VK_FORMAT_R32_SFLOAT;
+    m_image = createImage(
+        allocator, format, 0, m_width, m_height,
+        VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT,
+        m_mip_count
+    );
+    m_view = createImageView(
+        m_device, m_image.image, format, VK_IMAGE_ASPECT_COLOR_BIT,
+        0, m_mip_count
+    );
+    m_mip_views.resize(m_mip_count);
+    for (uint32_t i = 0; i < m_mip_count; i++) {
+        m_mip_views[i] = createImageView(
+            m_device, m_image.image, format, VK_IMAGE_ASPECT_COLOR_BIT, i, 1
+        );
+    }
+    m_sampler = createPyramidSampler(m_device);
+
+    m_set_layout = createPyramidSetLayout(m_device);
+    m_layout = createPyramidPipelineLayout(m_device, m_set_layout);
+    m_pipeline = createPyramidPipeline(m_device, m_layout);
+    m_descriptor_pool = createPyramidDescriptorPool(m_device, m_mip_count);
+
+    m_sets.resize(m_mip_count);
+    std::vector<VkDescriptorSetLayout> set_layouts(m_mip_count, m_set_layout);
+    VkDescriptorSetAllocateInfo alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = m_descriptor_pool,
+        .descriptorSetCount = m_mip_count,
+        .pSetLayouts = set_layouts.data(),
+    };
+    vkAllocateDescriptorSets(m_device, &alloc_info, m_sets.data());
+
+    for (uint32_t i = 0; i < m_mip_count; i++) {
+        VkDescriptorImageInfo src_info = {
+            .sampler = m_sampler,
+            .imageView = i ? m_mip_views[i - 1] : depth_view,
+            .imageLayout = i ?
+                VK_IMAGE_LAYOUT_GENERAL :
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        };
+        VkDescriptorImageInfo dst_info = {
+            .imageView = m_mip_views[i],
+            .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+        };
+        std::array writes = {
+            VkWriteDescriptorSet {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = m_sets[i],
+                .dstBinding = 0,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .pImageInfo = &src_info,
+            },
+            VkWriteDescriptorSet {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = m_sets[i],
+                .dstBinding = 1,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                .pImageInfo = &dst_info,
+            },
+        };
+        vkUpdateDescriptorSets(m_device, writes.size(), writes.data(), 0, nullptr);
+    }
+}
+
+void DepthPyramid::destroy(VmaAllocator allocator) {
+    if (!m_device) {
+        return;
+    }
+
+    vkDestroyDescriptorPool(m_device, m_descriptor_pool, nullptr);
+    vkDestroyPipeline(m_device, m_pipeline, nullptr);
+    vkDestroyPipelineLayout(m_device, m_layout, nullptr);
+    vkDestroyDescriptorSetLayout(m_device, m_set_layout, nullptr);
+    vkDestroySampler(m_device, m_sampler, nullptr);
+    for (auto view: m_mip_views) {
+        vkDestroyImageView(m_device, view, nullptr);
+    }
+    m_mip_views.clear();
+    vkDestroyImageView(m_device, m_view, nullptr);
+    m_image.destroy(allocator);
+    m_sets.clear();
+    m_device = VK_NULL_HANDLE;
+}
+
+void DepthPyramid::record(VkCommandBuffer cmd_buffer) {
+    // The previous contents are fully overwritten, but the last frame's
+    // occlusion tests must be done reading them
+    {
+        VkImageMemoryBarrier barrier = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = 0,
+            .dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .newLayout = VK_IMAGE_LAYOUT_GENERAL,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = m_image.image,
+            .subresourceRange = {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .baseMipLevel = 0,
+                .levelCount = m_mip_count,
+                .baseArrayLayer = 0,
+                .layerCount = 1,
+            },
+        };
+        vkCmdPipelineBarrier(
+            cmd_buffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 0, nullptr, 0, nullptr, 1, &barrier
+        );
+    }
+
+    vkCmdBindPipeline(cmd_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+    for (uint32_t i = 0; i < m_mip_count; i++) {
+        vkCmdBindDescriptorSets(
+            cmd_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_layout,
+            0, 1, &m_sets[i], 0, nullptr
+        );
+        auto width = std::max(m_width >> i, 1u);
+        auto height = std::max(m_height >> i, 1u);
+        vkCmdDispatch(
+            cmd_buffer,
+            (width + c_pyramid_group_size - 1) / c_pyramid_group_size,
+            (height + c_pyramid_group_size - 1) / c_pyramid_group_size,
+            1
+        );
+
+        // Each level reads the previous one, and the last one is read by
+        // occlusion culling
+        VkMemoryBarrier barrier = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+        };
+        vkCmdPipelineBarrier(
+            cmd_buffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 1, &barrier, 0, nullptr, 0, nullptr
+        );
+    }
+}
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include "Image.hpp"
+
+#include <vector>
+
+namespace VKR {
+// Mip chain of the farthest depth under every texel, built in compute from
+// the depth attachment for hierarchical occlusion tests. Level 0 is the
+// size of the depth attachment rounded down to powers of two, so that the
+// texels of every level evenly split the screen.
+class DepthPyramid {
+    VkDevice m_device = VK_NULL_HANDLE;
+
+    Image m_image;
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    uint32_t m_mip_count = 0;
+    VkImageView m_view = VK_NULL_HANDLE;
+    std::vector<VkImageView> m_mip_views;
+    VkSampler m_sampler = VK_NULL_HANDLE;
+
+    VkDescriptorSetLayout m_set_layout = VK_NULL_HANDLE;
+    VkPipelineLayout m_layout = VK_NULL_HANDLE;
+    VkPipeline m_pipeline = VK_NULL_HANDLE;
+    VkDescriptorPool m_descriptor_pool = VK_NULL_HANDLE;
+    // One per level, reading the previous level or the depth attachment
+    std::vector<VkDescriptorSet> m_sets;
+
+public:
+    void create(
+        VkDevice device, VmaAllocator allocator,
+        VkImageView depth_view, uint32_t width, uint32_t height
+    );
+    void destroy(VmaAllocator allocator);
+
+    // The depth attachment must be in shader read only layout. Leaves the
+    // pyramid in general layout, readable by compute shaders.
+    void record(VkCommandBuffer cmd_buffer);
+
+    VkImageView view() const {
+        return m_view;
+    }
+
+    VkSampler sampler() const {
+        return m_sampler;
+    }
+};
+}
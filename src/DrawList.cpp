@@ -0,0 +1,109 @@
+#include "DrawList.hpp"
+#include "IDPacking.hpp"
+
+#include <array>
+#include <iterator>
+
+namespace VKR {
+uint64_t makeDrawKey(MaterialID material, MeshID mesh) {
+    auto mat_idx = static_cast<uint64_t>(material);
+    assert(mat_idx < (uint64_t(1) << c_draw_key_material_bits));
+    auto mesh_idx = static_cast<uint64_t>(getMeshIndex(mesh));
+    auto mesh_fmt = static_cast<uint64_t>(getMeshStorageFormat(mesh));
+    constexpr auto mesh_idx_bits = c_draw_key_mesh_bits - getStorageWidth();
+    assert(mesh_idx < (uint64_t(1) << mesh_idx_bits));
+    auto mesh_key = (mesh_fmt << mesh_idx_bits) | mesh_idx;
+    return
+        (mat_idx << c_draw_key_material_shift) |
+        (mesh_key << c_draw_key_mesh_shift);
+}
+
+void DrawList::sort() {
+    // Between frames only the depth bits change, so the previous order is
+    // almost sorted and insertion sort finishes in close to linear time
+    constexpr size_t max_moves_per_packet = 4;
+    if (!m_sorted or !insertionSort(m_packets.size() * max_moves_per_packet)) {
+        radixSort();
+    }
+    m_sorted = true;
+}
+
+void DrawList::compact() {
+    m_visible.clear();
+    std::ranges::copy_if(
+        m_packets, std::back_inserter(m_visible),
+        [](const DrawPacket& p) { return p.visible; }
+    );
+
+    m_batches.clear();
+    for (size_t first = 0; first < m_visible.size();) {
+        const auto& p = m_visible[first];
+        auto last = first + 1;
+        while (
+            last < m_visible.size() and
+            m_visible[last].material == p.material and
+            m_visible[last].mesh == p.mesh and
+            m_visible[last].lod == p.lod
+        ) {
+            last++;
+        }
+        m_batches.push_back({
+            .first = static_cast<uint32_t>(first),
+            .count = static_cast<uint32_t>(last - first),
+        });
+        first = last;
+    }
+}
+
+void DrawList::radixSort() {
+    constexpr unsigned digit_bits = 8;
+    constexpr unsigned digit_count = 64 / digit_bits;
+    constexpr size_t radix = size_t(1) << digit_bits;
+
+    std::array<std::array<uint32_t, radix>, digit_count> histograms = {};
+    for (const auto& p: m_packets) {
+        for (unsigned d = 0; d < digit_count; d++) {
+            histograms[d][(p.key >> (d * digit_bits)) & (radix - 1)]++;
+        }
+    }
+
+    m_scratch.resize(m_packets.size());
+    for (unsigned d = 0; d < digit_count; d++) {
+        auto& hist = histograms[d];
+        // Skip passes where every key has the same digit
+        if (std::ranges::find(hist, m_packets.size()) != hist.end()) {
+            continue;
+        }
+
+        uint32_t offset = 0;
+        for (auto& h: hist) {
+            auto count = h;
+            h = offset;
+            offset += count;
+        }
+
+        auto shift = d * digit_bits;
+        for (const auto& p: m_packets) {
+            m_scratch[hist[(p.key >> shift) & (radix - 1)]++] = p;
+        }
+        std::swap(m_packets, m_scratch);
+    }
+}
+
+bool DrawList::insertionSort(size_t max_moves) {
+    size_t moves = 0;
+    for (size_t i = 1; i < m_packets.size(); i++) {
+        auto p = m_packets[i];
+        auto j = i;
+        for (; j > 0 and m_packets[j - 1].key > p.key; j--) {
+            m_packets[j] = m_packets[j - 1];
+        }
+        m_packets[j] = p;
+        moves += i - j;
+        if (moves > max_moves) {
+            return false;
+        }
+    }
+    return true;
+}
+}
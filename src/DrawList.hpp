@@ -0,0 +1,117 @@
+#pragma once
+#include "VKR.hpp"
+
+#include <algorithm>
+#include <vector>
+
+namespace VKR {
+// Draw keys are sorted in ascending order, so the most expensive state
+// change occupies the most significant bits
+inline constexpr unsigned c_draw_key_depth_bits = 21;
+inline constexpr unsigned c_draw_key_lod_bits = 3;
+inline constexpr unsigned c_draw_key_mesh_bits = 24;
+inline constexpr unsigned c_draw_key_material_bits = 16;
+static_assert(
+    c_draw_key_depth_bits +
+    c_draw_key_lod_bits +
+    c_draw_key_mesh_bits +
+    c_draw_key_material_bits == 64
+);
+static_assert((size_t(1) << c_draw_key_lod_bits) >= c_max_mesh_lods);
+
+inline constexpr unsigned c_draw_key_lod_shift = c_draw_key_depth_bits;
+inline constexpr unsigned c_draw_key_mesh_shift =
+    c_draw_key_lod_shift + c_draw_key_lod_bits;
+inline constexpr unsigned c_draw_key_material_shift =
+    c_draw_key_mesh_shift + c_draw_key_mesh_bits;
+
+struct DrawPacket {
+    uint64_t key;
+    // Dense index into the model storage the list was built from
+    uint32_t model;
+    MeshID mesh;
+    MaterialID material;
+    uint8_t lod = 0;
+    bool visible = true;
+};
+
+// Run of visible packets sharing a material, a mesh and a level of detail,
+// drawn as one instanced draw
+struct DrawBatch {
+    uint32_t first;
+    uint32_t count;
+};
+
+uint64_t makeDrawKey(MaterialID material, MeshID mesh);
+
+inline uint64_t setDrawKeyDepth(uint64_t key, float depth) {
+    constexpr uint64_t max_depth = (uint64_t(1) << c_draw_key_depth_bits) - 1;
+    depth = std::clamp(depth, 0.0f, 1.0f);
+    auto qdepth = static_cast<uint64_t>(depth * max_depth);
+    return (key & ~max_depth) | qdepth;
+}
+
+inline uint64_t setDrawKeyLOD(uint64_t key, uint32_t lod) {
+    constexpr uint64_t mask =
+        ((uint64_t(1) << c_draw_key_lod_bits) - 1) << c_draw_key_lod_shift;
+    return (key & ~mask) | (uint64_t(lod) << c_draw_key_lod_shift);
+}
+
+class DrawList {
+    std::vector<DrawPacket> m_packets;
+    std::vector<DrawPacket> m_scratch;
+    std::vector<DrawPacket> m_visible;
+    std::vector<DrawBatch> m_batches;
+    bool m_valid = false;
+    bool m_sorted = false;
+
+public:
+    bool valid() const {
+        return m_valid;
+    }
+
+    void invalidate() {
+        m_valid = false;
+    }
+
+    void reset() {
+        m_packets.clear();
+        m_valid = true;
+        m_sorted = false;
+    }
+
+    void add(uint32_t model, MeshID mesh, MaterialID material) {
+        m_packets.push_back({
+            .key = makeDrawKey(material, mesh),
+            .model = model,
+            .mesh = mesh,
+            .material = material,
+        });
+    }
+
+    std::span<DrawPacket> packets() {
+        return m_packets;
+    }
+
+    std::span<const DrawPacket> packets() const {
+        return m_packets;
+    }
+
+    std::span<const DrawPacket> visiblePackets() const {
+        return m_visible;
+    }
+
+    std::span<const DrawBatch> batches() const {
+        return m_batches;
+    }
+
+    void sort();
+    // Gather packets that survived culling, in sorted order, and split
+    // them into batches
+    void compact();
+
+private:
+    void radixSort();
+    bool insertionSort(size_t max_moves);
+};
+}
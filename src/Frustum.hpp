@@ -0,0 +1,46 @@
+#pragma once
+#include <glm/geometric.hpp>
+#include <glm/mat4x4.hpp>
+
+#include <array>
+
+namespace VKR {
+struct Frustum {
+    // Plane normals point inside the frustum
+    std::array<glm::vec4, 6> planes;
+};
+
+inline Frustum makeFrustum(const glm::mat4& proj_view) {
+    auto row = [&](int r) {
+        return glm::vec4(
+            proj_view[0][r], proj_view[1][r], proj_view[2][r], proj_view[3][r]
+        );
+    };
+
+    // Vulkan clip space has 0 <= z <= w
+    Frustum f = {
+        .planes = {
+            row(3) + row(0),
+            row(3) - row(0),
+            row(3) + row(1),
+            row(3) - row(1),
+            row(2),
+            row(3) - row(2),
+        },
+    };
+    for (auto& p: f.planes) {
+        p /= glm::length(glm::vec3(p));
+    }
+    return f;
+}
+
+inline float getMaxScale(const glm::mat4& t) {
+    return glm::sqrt(glm::max(
+        glm::max(
+            glm::dot(glm::vec3(t[0]), glm::vec3(t[0])),
+            glm::dot(glm::vec3(t[1]), glm::vec3(t[1]))
+        ),
+        glm::dot(glm::vec3(t[2]), glm::vec3(t[2]))
+    ));
+}
+}
@@ -0,0 +1,694 @@
+#include "GPUCulling.hpp"
+#include "IDPacking.hpp"
+#include "Shader.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <tuple>
+
+namespace VKR {
+namespace {
+constexpr uint32_t c_cull_models_spv[] = {
+#include "CullModels.comp.inc"
+};
+
+constexpr uint32_t c_occlusion_cull_spv[] = {
+#include "OcclusionCull.comp.inc"
+};
+
+constexpr uint32_t c_cull_group_size = 64;
+
+struct CullPushConstants {
+    std::array<glm::vec4, 6> planes;
+    glm::vec4 lod_camera;
+    uint32_t model_count;
+};
+
+// The late phase tests projected bounds, which also serves as its frustum
+// test
+struct OcclusionCullPushConstants {
+    glm::mat4 proj_view;
+    glm::vec4 lod_camera;
+    uint32_t model_count;
+};
+
+enum CullBinding: uint32_t {
+    Transforms,
+    ModelInfos,
+    MeshInfos,
+    Commands,
+    Counts,
+    Visibility,
+    LODs,
+    Count,
+};
+
+VkDescriptorSetLayout createCullSetLayout(VkDevice device) {
+    std::array<VkDescriptorSetLayoutBinding, CullBinding::Count> bindings;
+    for (uint32_t i = 0; i < bindings.size(); i++) {
+        bindings[i] = {
+            .binding = i,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        };
+    }
+
+    VkDescriptorSetLayoutCreateInfo create_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = bindings.size(),
+        .pBindings = bindings.data(),
+    };
+
+    VkDescriptorSetLayout layout;
+    vkCreateDescriptorSetLayout(device, &create_info, nullptr, &layout);
+    return layout;
+}
+
+VkDescriptorSetLayout createPyramidSetLayout(VkDevice device) {
+    VkDescriptorSetLayoutBinding binding = {
+        .binding = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .descriptorCount = 1,
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+    };
+
+    VkDescriptorSetLayoutCreateInfo create_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = 1,
+        .pBindings = &binding,
+    };
+
+    VkDescriptorSetLayout layout;
+    vkCreateDescriptorSetLayout(device, &create_info, nullptr, &layout);
+    return layout;
+}
+
+VkPipelineLayout createCullPipelineLayout(
+    VkDevice device,
+    std::span<const VkDescriptorSetLayout> set_layouts,
+    uint32_t push_constants_size
+) {
+    VkPushConstantRange push_range = {
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .size = push_constants_size,
+    };
+    VkPipelineLayoutCreateInfo create_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = static_cast<uint32_t>(set_layouts.size()),
+        .pSetLayouts = set_layouts.data(),
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &push_range,
+    };
+    VkPipelineLayout layout;
+    vkCreatePipelineLayout(device, &create_info, nullptr, &layout);
+    return layout;
+}
+
+VkPipeline createCullPipeline(
+    VkDevice device, VkPipelineLayout layout,
+    std::span<const uint32_t> spv,
+    const VkSpecializationInfo* specialization_info = nullptr
+) {
+    auto shader_module = createShaderModule(device, spv);
+
+    VkComputePipelineCreateInfo create_info = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .stage = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            .module = shader_module,
+            .pName = "main",
+            .pSpecializationInfo = specialization_info,
+        },
+        .layout = layout,
+    };
+
+    VkPipeline pipeline;
+    vkCreateComputePipelines(device, nullptr, 1, &create_info, nullptr, &pipeline);
+
+    vkDestroyShaderModule(device, shader_module, nullptr);
+
+    return pipeline;
+}
+
+VkDescriptorPool createCullDescriptorPool(
+    VkDevice device, size_t cull_set_count, bool occlusion
+) {
+    std::array pool_sizes = {
+        VkDescriptorPoolSize {
+            .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = static_cast<uint32_t>(cull_set_count * CullBinding::Count),
+        },
+        VkDescriptorPoolSize {
+            .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = 1,
+        },
+    };
+    VkDescriptorPoolCreateInfo create_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .maxSets = static_cast<uint32_t>(cull_set_count + occlusion),
+        .poolSizeCount = occlusion ? 2u : 1u,
+        .pPoolSizes = pool_sizes.data(),
+    };
+    VkDescriptorPool pool;
+    vkCreateDescriptorPool(device, &create_info, nullptr, &pool);
+    return pool;
+}
+
+auto createGPUOnlyBuffer(
+    VmaAllocator allocator,
+    size_t size,
+    VkBufferUsageFlags usage
+) {
+    return createBuffer(allocator, size, usage, 0, VMA_MEMORY_USAGE_GPU_ONLY);
+}
+}
+
+void GPUCulling::create(
+    VkDevice device, VmaAllocator allocator, size_t frame_count,
+    bool occlusion
+) {
+    m_device = device;
+    m_allocator = allocator;
+    m_occlusion = occlusion;
+    m_set_layout = createCullSetLayout(m_device);
+    m_layout = createCullPipelineLayout(
+        m_device, std::span(&m_set_layout, 1), sizeof(CullPushConstants)
+    );
+    {
+        VkBool32 skip_occluded = m_occlusion;
+        VkSpecializationMapEntry entry = {
+            .constantID = 0,
+            .offset = 0,
+            .size = sizeof(skip_occluded),
+        };
+        VkSpecializationInfo specialization_info = {
+            .mapEntryCount = 1,
+            .pMapEntries = &entry,
+            .dataSize = sizeof(skip_occluded),
+            .pData = &skip_occluded,
+        };
+        m_pipeline = createCullPipeline(
+            m_device, m_layout, c_cull_models_spv, &specialization_info
+        );
+    }
+
+    auto set_count = frame_count * phaseCount();
+    m_descriptor_pool = createCullDescriptorPool(m_device, set_count, m_occlusion);
+
+    m_frames.resize(frame_count);
+    std::vector<VkDescriptorSetLayout> set_layouts(set_count, m_set_layout);
+    std::vector<VkDescriptorSet> sets(set_count);
+    VkDescriptorSetAllocateInfo alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = m_descriptor_pool,
+        .descriptorSetCount = static_cast<uint32_t>(set_count),
+        .pSetLayouts = set_layouts.data(),
+    };
+    vkAllocateDescriptorSets(m_device, &alloc_info, sets.data());
+    for (size_t i = 0; i < frame_count; i++) {
+        for (size_t p = 0; p < phaseCount(); p++) {
+            m_frames[i].phases[p].set = sets[i * phaseCount() + p];
+        }
+    }
+
+    if (m_occlusion) {
+        m_pyramid_set_layout = createPyramidSetLayout(m_device);
+        std::array set_layouts = {m_set_layout, m_pyramid_set_layout};
+        m_occlusion_layout = createCullPipelineLayout(
+            m_device, set_layouts, sizeof(OcclusionCullPushConstants)
+        );
+        m_occlusion_pipeline = createCullPipeline(
+            m_device, m_occlusion_layout, c_occlusion_cull_spv
+        );
+        VkDescriptorSetAllocateInfo alloc_info = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .descriptorPool = m_descriptor_pool,
+            .descriptorSetCount = 1,
+            .pSetLayouts = &m_pyramid_set_layout,
+        };
+        vkAllocateDescriptorSets(m_device, &alloc_info, &m_pyramid_set);
+    }
+}
+
+void GPUCulling::setDepthPyramid(VkImageView view, VkSampler sampler) {
+    assert(m_occlusion);
+    VkDescriptorImageInfo image_info = {
+        .sampler = sampler,
+        .imageView = view,
+        .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+    };
+    VkWriteDescriptorSet write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = m_pyramid_set,
+        .dstBinding = 0,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .pImageInfo = &image_info,
+    };
+    vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+}
+
+void GPUCulling::destroy() {
+    if (!m_device) {
+        return;
+    }
+
+    for (auto& f: m_frames) {
+        for (auto& p: f.phases) {
+            p.commands.destroy(m_allocator);
+            p.counts.destroy(m_allocator);
+        }
+        f.staging.destroy(m_allocator);
+    }
+    m_frames.clear();
+    m_transforms.destroy(m_allocator);
+    m_model_infos.destroy(m_allocator);
+    m_mesh_infos.destroy(m_allocator);
+    m_visibility.destroy(m_allocator);
+    m_lods.destroy(m_allocator);
+
+    if (m_occlusion) {
+        vkDestroyPipeline(m_device, m_occlusion_pipeline, nullptr);
+        vkDestroyPipelineLayout(m_device, m_occlusion_layout, nullptr);
+        vkDestroyDescriptorSetLayout(m_device, m_pyramid_set_layout, nullptr);
+    }
+    vkDestroyDescriptorPool(m_device, m_descriptor_pool, nullptr);
+    vkDestroyPipeline(m_device, m_pipeline, nullptr);
+    vkDestroyPipelineLayout(m_device, m_layout, nullptr);
+    vkDestroyDescriptorSetLayout(m_device, m_set_layout, nullptr);
+    m_device = VK_NULL_HANDLE;
+}
+
+bool GPUCulling::update(
+    const ModelStorage& models,
+    std::span<const StaticMesh> meshes
+) {
+    bool reallocated = reserve(models.size(), meshes.size());
+    if (m_meshes_dirty) {
+        updateMeshInfos(meshes);
+    }
+    if (m_models_dirty) {
+        updateModelInfos(models, meshes);
+    }
+    return reallocated;
+}
+
+void GPUCulling::updateMeshInfos(std::span<const StaticMesh> meshes) {
+    m_mesh_info_data.resize(meshes.size());
+    for (size_t i = 0; i < meshes.size(); i++) {
+        const auto& lods = meshes[i].lods;
+        auto& info = m_mesh_info_data[i];
+        // Models are culled with their draw transforms, so bounds and
+        // errors are in the space of the vertex buffer
+        const auto& quantization = meshes[i].quantization;
+        info = {
+            .bounding_sphere =
+                quantization.quantizeSphere(meshes[i].bounds.sphere),
+            .lod_count = static_cast<uint32_t>(lods.size()),
+        };
+        for (size_t l = 0; l < lods.size(); l++) {
+            info.lods[l] = {
+                .first_index = lods[l].first_index,
+                .index_count = lods[l].index_count,
+                .error = lods[l].error / quantization.scale,
+                .vertex_offset = static_cast<int32_t>(meshes[i].vertices.first),
+            };
+        }
+    }
+}
+
+void GPUCulling::updateModelInfos(
+    const ModelStorage& models,
+    std::span<const StaticMesh> meshes
+) {
+    m_model_info_data.resize(models.size());
+    // Models of meshes with meshlets are culled by cluster instead
+    std::vector<uint32_t> order;
+    order.reserve(models.size());
+    for (uint32_t i = 0; i < models.size(); i++) {
+        auto mesh = getMeshIndex(models.mesh(i));
+        if (meshes[mesh].meshlets.empty()) {
+            order.push_back(i);
+        } else {
+            m_model_info_data[i] = {
+                .mesh = static_cast<uint32_t>(mesh),
+            };
+        }
+    }
+    auto getBuffers = [&](uint32_t i) {
+        return meshes[getMeshIndex(models.mesh(i))].buffers();
+    };
+    std::ranges::sort(order, {}, [&](uint32_t i) {
+        return std::tuple(models.material(i), getBuffers(i));
+    });
+
+    m_buckets.clear();
+    for (uint32_t cmd_idx = 0; cmd_idx < order.size(); cmd_idx++) {
+        auto i = order[cmd_idx];
+        auto material = models.material(i);
+        auto buffers = getBuffers(i);
+        if (
+            m_buckets.empty() or
+            m_buckets.back().material != material or
+            m_buckets.back().buffers != buffers
+        ) {
+            m_buckets.push_back({
+                .material = material,
+                .buffers = buffers,
+                .first_command = cmd_idx,
+                .capacity = 0,
+            });
+        }
+        auto& bucket = m_buckets.back();
+        bucket.capacity++;
+        m_model_info_data[i] = {
+            .mesh = static_cast<uint32_t>(getMeshIndex(models.mesh(i))),
+            .bucket = static_cast<uint32_t>(m_buckets.size() - 1),
+            .first_command = bucket.first_command,
+        };
+    }
+
+    m_transforms_dirty_begin = 0;
+    m_transforms_dirty_end = models.size();
+}
+
+bool GPUCulling::reserve(size_t model_count, size_t mesh_count) {
+    if (model_count <= m_model_capacity and mesh_count <= m_mesh_capacity) {
+        return false;
+    }
+
+    // Resident buffers are shared by all frames in flight, and growing
+    // them is rare enough to simply wait for the device
+    vkDeviceWaitIdle(m_device);
+
+    bool models_reallocated = model_count > m_model_capacity;
+    if (models_reallocated) {
+        m_model_capacity = std::max(model_count, m_model_capacity * 2);
+        m_transforms.destroy(m_allocator);
+        m_model_infos.destroy(m_allocator);
+        m_transforms = createGPUOnlyBuffer(
+            m_allocator, m_model_capacity * sizeof(glm::mat4),
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+        );
+        m_model_infos = createGPUOnlyBuffer(
+            m_allocator, m_model_capacity * sizeof(GPUModelInfo),
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+        );
+        m_visibility.destroy(m_allocator);
+        m_visibility = createGPUOnlyBuffer(
+            m_allocator, m_model_capacity * sizeof(uint32_t),
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+        );
+        m_lods.destroy(m_allocator);
+        m_lods = createGPUOnlyBuffer(
+            m_allocator, m_model_capacity * sizeof(uint32_t),
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+        );
+        for (auto& f: m_frames) {
+            for (size_t p = 0; p < phaseCount(); p++) {
+                auto& phase = f.phases[p];
+                phase.commands.destroy(m_allocator);
+                phase.counts.destroy(m_allocator);
+                phase.commands = createGPUOnlyBuffer(
+                    m_allocator,
+                    m_model_capacity * sizeof(VkDrawIndexedIndirectCommand),
+                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                    VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT
+                );
+                phase.counts = createGPUOnlyBuffer(
+                    m_allocator, m_model_capacity * sizeof(uint32_t),
+                    VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                    VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT
+                );
+            }
+        }
+        m_models_dirty = true;
+    }
+
+    if (mesh_count > m_mesh_capacity) {
+        m_mesh_capacity = std::max(mesh_count, m_mesh_capacity * 2);
+        m_mesh_infos.destroy(m_allocator);
+        m_mesh_infos = createGPUOnlyBuffer(
+            m_allocator, m_mesh_capacity * sizeof(GPUMeshInfo),
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+        );
+        m_meshes_dirty = true;
+    }
+
+    // Staging memory mirrors the layout of the resident buffers
+    auto staging_size =
+        m_model_capacity * (sizeof(glm::mat4) + sizeof(GPUModelInfo)) +
+        m_mesh_capacity * sizeof(GPUMeshInfo);
+    for (auto& f: m_frames) {
+        f.staging.destroy(m_allocator);
+        f.staging = createStagingBuffer(m_allocator, staging_size);
+        f.staging_data = static_cast<std::byte*>(
+            getMappedData(m_allocator, f.staging)
+        );
+    }
+
+    if (m_model_capacity and m_mesh_capacity) {
+        updateDescriptorSets();
+    }
+
+    return models_reallocated;
+}
+
+void GPUCulling::updateDescriptorSets() {
+    for (auto& f: m_frames) {
+        for (size_t p = 0; p < phaseCount(); p++) {
+            const auto& phase = f.phases[p];
+            std::array<VkDescriptorBufferInfo, CullBinding::Count> buffer_infos;
+            buffer_infos[CullBinding::Transforms] = {
+                .buffer = m_transforms.buffer, .range = VK_WHOLE_SIZE,
+            };
+            buffer_infos[CullBinding::ModelInfos] = {
+                .buffer = m_model_infos.buffer, .range = VK_WHOLE_SIZE,
+            };
+            buffer_infos[CullBinding::MeshInfos] = {
+                .buffer = m_mesh_infos.buffer, .range = VK_WHOLE_SIZE,
+            };
+            buffer_infos[CullBinding::Commands] = {
+                .buffer = phase.commands.buffer, .range = VK_WHOLE_SIZE,
+            };
+            buffer_infos[CullBinding::Counts] = {
+                .buffer = phase.counts.buffer, .range = VK_WHOLE_SIZE,
+            };
+            buffer_infos[CullBinding::Visibility] = {
+                .buffer = m_visibility.buffer, .range = VK_WHOLE_SIZE,
+            };
+            buffer_infos[CullBinding::LODs] = {
+                .buffer = m_lods.buffer, .range = VK_WHOLE_SIZE,
+            };
+
+            std::array<VkWriteDescriptorSet, CullBinding::Count> writes;
+            for (uint32_t i = 0; i < writes.size(); i++) {
+                writes[i] = {
+                    .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                    .dstSet = phase.set,
+                    .dstBinding = i,
+                    .descriptorCount = 1,
+                    .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                    .pBufferInfo = &buffer_infos[i],
+                };
+            }
+            vkUpdateDescriptorSets(m_device, writes.size(), writes.data(), 0, nullptr);
+        }
+    }
+}
+
+void GPUCulling::recordCulling(
+    VkCommandBuffer cmd_buffer, size_t frame,
+    const Frustum& frustum, const glm::vec4& lod_camera,
+    const ModelStorage& models,
+    std::span<const StaticMesh> meshes
+) {
+    auto& f = m_frames[frame];
+
+    size_t transforms_offset = 0;
+    auto model_infos_offset =
+        transforms_offset + m_model_capacity * sizeof(glm::mat4);
+    auto mesh_infos_offset =
+        model_infos_offset + m_model_capacity * sizeof(GPUModelInfo);
+
+    bool upload_transforms = m_transforms_dirty_begin != m_transforms_dirty_end;
+    if (upload_transforms or m_models_dirty or m_meshes_dirty) {
+        // Wait for previous frames to stop reading the resident buffers
+        vkCmdPipelineBarrier(
+            cmd_buffer,
+            VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0, 0, nullptr, 0, nullptr, 0, nullptr
+        );
+    }
+
+    if (upload_transforms) {
+        VkBufferCopy region = {
+            .srcOffset = transforms_offset + m_transforms_dirty_begin * sizeof(glm::mat4),
+            .dstOffset = m_transforms_dirty_begin * sizeof(glm::mat4),
+            .size = (m_transforms_dirty_end - m_transforms_dirty_begin) * sizeof(glm::mat4),
+        };
+        for (auto i = m_transforms_dirty_begin; i < m_transforms_dirty_end; i++) {
+            const auto& mesh = meshes[getMeshIndex(models.mesh(i))];
+            auto t = mesh.drawTransform(models.transform(i));
+            std::memcpy(
+                f.staging_data + transforms_offset + i * sizeof(glm::mat4),
+                &t, sizeof(t)
+            );
+        }
+        vmaFlushAllocation(m_allocator, f.staging.allocation, region.srcOffset, region.size);
+        vkCmdCopyBuffer(cmd_buffer, f.staging.buffer, m_transforms.buffer, 1, &region);
+        m_transforms_dirty_begin = m_transforms_dirty_end = 0;
+    }
+
+    if (m_models_dirty and !m_model_info_data.empty()) {
+        // Model indices have changed, so every model is drawn in the early
+        // phase until the late phase has tested it
+        vkCmdFillBuffer(
+            cmd_buffer, m_visibility.buffer,
+            0, m_model_info_data.size() * sizeof(uint32_t), 1
+        );
+        vkCmdFillBuffer(
+            cmd_buffer, m_lods.buffer,
+            0, m_model_info_data.size() * sizeof(uint32_t), 0
+        );
+
+        auto size = m_model_info_data.size() * sizeof(GPUModelInfo);
+        std::memcpy(f.staging_data + model_infos_offset, m_model_info_data.data(), size);
+        VkBufferCopy region = {
+            .srcOffset = model_infos_offset,
+            .size = size,
+        };
+        vmaFlushAllocation(m_allocator, f.staging.allocation, region.srcOffset, region.size);
+        vkCmdCopyBuffer(cmd_buffer, f.staging.buffer, m_model_infos.buffer, 1, &region);
+    }
+    m_models_dirty = false;
+
+    if (m_meshes_dirty and !m_mesh_info_data.empty()) {
+        auto size = m_mesh_info_data.size() * sizeof(GPUMeshInfo);
+        std::memcpy(f.staging_data + mesh_infos_offset, m_mesh_info_data.data(), size);
+        VkBufferCopy region = {
+            .srcOffset = mesh_infos_offset,
+            .size = size,
+        };
+        vmaFlushAllocation(m_allocator, f.staging.allocation, region.srcOffset, region.size);
+        vkCmdCopyBuffer(cmd_buffer, f.staging.buffer, m_mesh_infos.buffer, 1, &region);
+    }
+    m_meshes_dirty = false;
+
+    if (models.empty()) {
+        return;
+    }
+
+    for (size_t p = 0; p < phaseCount(); p++) {
+        vkCmdFillBuffer(cmd_buffer, f.phases[p].counts.buffer, 0, VK_WHOLE_SIZE, 0);
+    }
+
+    {
+        VkMemoryBarrier barrier = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask =
+                VK_ACCESS_SHADER_READ_BIT |
+                VK_ACCESS_SHADER_WRITE_BIT,
+        };
+        vkCmdPipelineBarrier(
+            cmd_buffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+            VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+            0, 1, &barrier, 0, nullptr, 0, nullptr
+        );
+    }
+
+    CullPushConstants push_constants = {
+        .planes = frustum.planes,
+        .lod_camera = lod_camera,
+        .model_count = static_cast<uint32_t>(models.size()),
+    };
+    vkCmdBindPipeline(cmd_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+    vkCmdBindDescriptorSets(
+        cmd_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_layout,
+        0, 1, &f.phases[CullPhase::Early].set, 0, nullptr
+    );
+    vkCmdPushConstants(
+        cmd_buffer, m_layout, VK_SHADER_STAGE_COMPUTE_BIT,
+        0, sizeof(push_constants), &push_constants
+    );
+    auto group_count =
+        (push_constants.model_count + c_cull_group_size - 1) / c_cull_group_size;
+    vkCmdDispatch(cmd_buffer, group_count, 1, 1);
+
+    {
+        VkMemoryBarrier barrier = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+        };
+        vkCmdPipelineBarrier(
+            cmd_buffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+            0, 1, &barrier, 0, nullptr, 0, nullptr
+        );
+    }
+}
+
+void GPUCulling::recordOcclusionCulling(
+    VkCommandBuffer cmd_buffer, size_t frame,
+    const glm::mat4& proj_view, const glm::vec4& lod_camera,
+    const ModelStorage& models
+) {
+    assert(m_occlusion);
+    if (models.empty()) {
+        return;
+    }
+
+    OcclusionCullPushConstants push_constants = {
+        .proj_view = proj_view,
+        .lod_camera = lod_camera,
+        .model_count = static_cast<uint32_t>(models.size()),
+    };
+    std::array sets = {
+        m_frames[frame].phases[CullPhase::Late].set, m_pyramid_set,
+    };
+    vkCmdBindPipeline(cmd_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_occlusion_pipeline);
+    vkCmdBindDescriptorSets(
+        cmd_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_occlusion_layout,
+        0, sets.size(), sets.data(), 0, nullptr
+    );
+    vkCmdPushConstants(
+        cmd_buffer, m_occlusion_layout, VK_SHADER_STAGE_COMPUTE_BIT,
+        0, sizeof(push_constants), &push_constants
+    );
+    auto group_count =
+        (push_constants.model_count + c_cull_group_size - 1) / c_cull_group_size;
+    vkCmdDispatch(cmd_buffer, group_count, 1, 1);
+
+    // Visibility is also read by the next frame's early phase
+    VkMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask =
+            VK_ACCESS_INDIRECT_COMMAND_READ_BIT |
+            VK_ACCESS_SHADER_READ_BIT,
+    };
+    vkCmdPipelineBarrier(
+        cmd_buffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 1, &barrier, 0, nullptr, 0, nullptr
+    );
+}
+}
@@ -0,0 +1,201 @@
+#pragma once
+#include "Buffer.hpp"
+#include "Frustum.hpp"
+#include "Mesh.hpp"
+#include "Model.hpp"
+
+#include <array>
+#include <vector>
+
+namespace VKR {
+struct GPUModelInfo {
+    static constexpr uint32_t NoBucket = -1;
+    uint32_t mesh;
+    uint32_t bucket = NoBucket;
+    uint32_t first_command;
+    uint32_t pad;
+};
+static_assert(sizeof(GPUModelInfo) == 16);
+
+struct GPUMeshLOD {
+    uint32_t first_index;
+    uint32_t index_count;
+    float error;
+    int32_t vertex_offset;
+};
+static_assert(sizeof(GPUMeshLOD) == 16);
+
+struct GPUMeshInfo {
+    glm::vec4 bounding_sphere;
+    uint32_t lod_count;
+    uint32_t pad[3];
+    std::array<GPUMeshLOD, c_max_mesh_lods> lods;
+};
+static_assert(sizeof(GPUMeshInfo) == 32 + 16 * c_max_mesh_lods);
+
+// All models sharing a material and the pool blocks of their meshes are
+// drawn with a single vkCmdDrawIndexedIndirectCount. Generated commands
+// point to their mesh's ranges within the blocks.
+struct GPUCullingBucket {
+    MaterialID material;
+    StaticMeshBuffers buffers;
+    uint32_t first_command;
+    uint32_t capacity;
+};
+
+// With occlusion culling, the early phase draws models that were visible
+// last frame and the late phase draws models that became visible after
+// being tested against the early phase's depth. Otherwise only the early
+// phase is used.
+enum CullPhase: size_t {
+    Early,
+    Late,
+};
+
+class GPUCulling {
+    VkDevice m_device = VK_NULL_HANDLE;
+    VmaAllocator m_allocator = VK_NULL_HANDLE;
+
+    VkDescriptorSetLayout m_set_layout = VK_NULL_HANDLE;
+    VkPipelineLayout m_layout = VK_NULL_HANDLE;
+    VkPipeline m_pipeline = VK_NULL_HANDLE;
+    VkDescriptorPool m_descriptor_pool = VK_NULL_HANDLE;
+
+    bool m_occlusion = false;
+    VkDescriptorSetLayout m_pyramid_set_layout = VK_NULL_HANDLE;
+    VkPipelineLayout m_occlusion_layout = VK_NULL_HANDLE;
+    VkPipeline m_occlusion_pipeline = VK_NULL_HANDLE;
+    VkDescriptorSet m_pyramid_set = VK_NULL_HANDLE;
+
+    struct Phase {
+        VkDescriptorSet set = VK_NULL_HANDLE;
+        Buffer commands;
+        Buffer counts;
+    };
+
+    struct Frame {
+        std::array<Phase, 2> phases;
+        Buffer staging;
+        std::byte* staging_data = nullptr;
+    };
+    std::vector<Frame> m_frames;
+
+    Buffer m_transforms;
+    Buffer m_model_infos;
+    Buffer m_mesh_infos;
+    // Whether a model passed the late phase of the last frame
+    Buffer m_visibility;
+    // Level of detail of every model, kept between frames for hysteresis
+    Buffer m_lods;
+    size_t m_model_capacity = 0;
+    size_t m_mesh_capacity = 0;
+
+    std::vector<GPUModelInfo> m_model_info_data;
+    std::vector<GPUMeshInfo> m_mesh_info_data;
+    std::vector<GPUCullingBucket> m_buckets;
+
+    bool m_models_dirty = true;
+    bool m_meshes_dirty = true;
+    size_t m_transforms_dirty_begin = 0;
+    size_t m_transforms_dirty_end = 0;
+
+public:
+    void create(
+        VkDevice device, VmaAllocator allocator, size_t frame_count,
+        bool occlusion
+    );
+    void destroy();
+
+    void setDepthPyramid(VkImageView view, VkSampler sampler);
+
+    void invalidateModels() {
+        m_models_dirty = true;
+    }
+
+    void invalidateMeshes() {
+        m_meshes_dirty = true;
+    }
+
+    // For when the vertex formats of meshes change, which changes the
+    // transforms of their models
+    void invalidateTransforms(size_t model_count) {
+        m_transforms_dirty_begin = 0;
+        m_transforms_dirty_end = model_count;
+    }
+
+    void setTransformDirty(size_t model_idx) {
+        if (m_transforms_dirty_begin == m_transforms_dirty_end) {
+            m_transforms_dirty_begin = model_idx;
+            m_transforms_dirty_end = model_idx + 1;
+        } else {
+            m_transforms_dirty_begin = std::min(m_transforms_dirty_begin, model_idx);
+            m_transforms_dirty_end = std::max(m_transforms_dirty_end, model_idx + 1);
+        }
+    }
+
+    // Returns true if the buffers indexed by model were reallocated, which
+    // invalidates the transform buffer and draws recorded with them. Mesh
+    // buffers are only read by the culling passes, which are updated here.
+    bool update(
+        const ModelStorage& models,
+        std::span<const StaticMesh> meshes
+    );
+
+    // Uploads changes and generates the draws of the early phase
+    // lod_camera is the camera position in xyz, and w scales model space
+    // error at unit distance to multiples of the pixel error threshold
+    void recordCulling(
+        VkCommandBuffer cmd_buffer, size_t frame,
+        const Frustum& frustum, const glm::vec4& lod_camera,
+        const ModelStorage& models,
+        std::span<const StaticMesh> meshes
+    );
+
+    // Generates the draws of the late phase. The depth pyramid must have
+    // been built from the early phase's depth.
+    void recordOcclusionCulling(
+        VkCommandBuffer cmd_buffer, size_t frame,
+        const glm::mat4& proj_view, const glm::vec4& lod_camera,
+        const ModelStorage& models
+    );
+
+    std::span<const GPUCullingBucket> buckets() const {
+        return m_buckets;
+    }
+
+    // Indexed by model, which is the first instance of every generated draw.
+    // Holds draw transforms, which dequantize quantized positions.
+    VkBuffer transformBuffer() const {
+        return m_transforms.buffer;
+    }
+
+    void drawBucket(
+        VkCommandBuffer cmd_buffer, size_t frame, CullPhase phase,
+        size_t bucket
+    ) {
+        const auto& p = m_frames[frame].phases[phase];
+        const auto& b = m_buckets[bucket];
+        vkCmdDrawIndexedIndirectCount(
+            cmd_buffer,
+            p.commands.buffer,
+            b.first_command * sizeof(VkDrawIndexedIndirectCommand),
+            p.counts.buffer, bucket * sizeof(uint32_t),
+            b.capacity, sizeof(VkDrawIndexedIndirectCommand)
+        );
+    }
+
+private:
+    size_t phaseCount() const {
+        return m_occlusion ? 2 : 1;
+    }
+
+    void updateMeshInfos(std::span<const StaticMesh> meshes);
+    void updateModelInfos(
+        const ModelStorage& models,
+        std::span<const StaticMesh> meshes
+    );
+    // Returns true if the model buffers were reallocated
+    bool reserve(size_t model_count, size_t mesh_count);
+    void updateDescriptorSets();
+};
+}
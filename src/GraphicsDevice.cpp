@@ -3,7 +3,9 @@
 #include "Mesh.hpp"
 
 #include <algorithm>
+#include <array>
 #include <cstring>
+#include <stdexcept>
 
 namespace VKR {
 namespace {
@@ -21,8 +23,29 @@ QueueFamilies findQueueFamilies(VkPhysicalDevice device) {
         }
     }
 
+    // Prefer a transfer only family, which is usually backed by a DMA
+    // engine, over an async compute one
+    uint32_t transfer_family = QueueFamilies::NotFound;
+    for (uint32_t i = 0; i < count; i++) {
+        auto flags = props[i].queueFlags;
+        if (
+            (flags & VK_QUEUE_GRAPHICS_BIT) or
+            !(flags & (VK_QUEUE_TRANSFER_BIT | VK_QUEUE_COMPUTE_BIT))
+        ) {
+            continue;
+        }
+        if (!(flags & VK_QUEUE_COMPUTE_BIT)) {
+            transfer_family = i;
+            break;
+        }
+        if (transfer_family == QueueFamilies::NotFound) {
+            transfer_family = i;
+        }
+    }
+
     return {
         .graphics = graphics_family,
+        .transfer = transfer_family,
     };
 }
 
@@ -37,28 +60,102 @@ bool extensionSupported(const char* ext, std::span<const VkExtensionProperties>
     return it != ext_props.end();
 }
 
+bool queryGPUCullingSupport(
+    VkPhysicalDevice device, const VkPhysicalDeviceProperties& props
+) {
+    if (props.apiVersion < VK_API_VERSION_1_2) {
+        return false;
+    }
+
+    VkPhysicalDeviceVulkan12Features features12 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_12_FEATURES,
+    };
+    VkPhysicalDeviceFeatures2 features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &features12,
+    };
+    vkGetPhysicalDeviceFeatures2(device, &features);
+
+    return
+        features.features.drawIndirectFirstInstance and
+        features12.drawIndirectCount;
+}
+
+// Uploads are tracked with timeline semaphores, which are core since
+// Vulkan 1.2
+bool queryTimelineSemaphoreSupport(
+    VkPhysicalDevice device, const VkPhysicalDeviceProperties& props
+) {
+    if (props.apiVersion < VK_API_VERSION_1_2) {
+        return false;
+    }
+
+    VkPhysicalDeviceVulkan12Features features12 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_12_FEATURES,
+    };
+    VkPhysicalDeviceFeatures2 features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &features12,
+    };
+    vkGetPhysicalDeviceFeatures2(device, &features);
+
+    return features12.timelineSemaphore;
+}
+
 VkDevice createDevice(
     VkPhysicalDevice physical_device, const QueueFamilies& queue_families,
+    const GraphicsDeviceConnectionFeatures& conf,
     std::span<const char* const> extensions
 ) {
     assert(queue_families.graphics != QueueFamilies::NotFound);
     float priority = 1.0f;
-    VkDeviceQueueCreateInfo queue_create_info = {
-        .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-        .queueFamilyIndex = queue_families.graphics,
-        .queueCount = 1,
-        .pQueuePriorities = &priority,
+    std::array<VkDeviceQueueCreateInfo, 2> queue_create_infos = {{
+        {
+            .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+            .queueFamilyIndex = queue_families.graphics,
+            .queueCount = 1,
+            .pQueuePriorities = &priority,
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+            .queueFamilyIndex = queue_families.transfer,
+            .queueCount = 1,
+            .pQueuePriorities = &priority,
+        },
+    }};
+    uint32_t queue_create_info_count =
+        queue_families.transfer != QueueFamilies::NotFound ? 2 : 1;
+    VkPhysicalDeviceVulkan12Features features12 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_12_FEATURES,
+        .drawIndirectCount = conf.gpu_culling,
+        .timelineSemaphore = true,
+    };
+    // Scenes count samples with occlusion queries when these are
+    // available
+    VkPhysicalDeviceFeatures supported;
+    vkGetPhysicalDeviceFeatures(physical_device, &supported);
+    VkPhysicalDeviceFeatures features = {
+        .drawIndirectFirstInstance = conf.gpu_culling,
+        .occlusionQueryPrecise = supported.occlusionQueryPrecise,
+        .inheritedQueries = supported.inheritedQueries,
     };
     VkDeviceCreateInfo device_create_info = {
         .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-        .queueCreateInfoCount = 1,
-        .pQueueCreateInfos = &queue_create_info,
+        .pNext = &features12,
+        .queueCreateInfoCount = queue_create_info_count,
+        .pQueueCreateInfos = queue_create_infos.data(),
         .enabledExtensionCount = static_cast<uint32_t>(extensions.size()),
         .ppEnabledExtensionNames = extensions.data(),
+        .pEnabledFeatures = &features,
     };
 
     VkDevice device;
-    vkCreateDevice(physical_device, &device_create_info, nullptr, &device);
+    auto result = vkCreateDevice(
+        physical_device, &device_create_info, nullptr, &device
+    );
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create device");
+    }
 
     return device;
 }
@@ -67,6 +164,9 @@ Queues findQueues(VkDevice dev, const QueueFamilies& queue_families) {
     assert(queue_families.graphics != QueueFamilies::NotFound);
     Queues queues;
     vkGetDeviceQueue(dev, queue_families.graphics, 0, &queues.graphics);
+    if (queue_families.transfer != QueueFamilies::NotFound) {
+        vkGetDeviceQueue(dev, queue_families.transfer, 0, &queues.transfer);
+    }
     return queues;
 }
 }
@@ -79,6 +179,10 @@ PhysicalDevice::PhysicalDevice(
     m_queue_families(findQueueFamilies(m_physical_device))
 {
     vkGetPhysicalDeviceProperties(m_physical_device, &m_properties);
+    m_timeline_semaphore_supported =
+        queryTimelineSemaphoreSupport(m_physical_device, m_properties);
+    m_gpu_culling_supported =
+        queryGPUCullingSupport(m_physical_device, m_properties);
 }
 
 bool PhysicalDevice::extensionsSupported(std::span<const char* const> exts) const {
@@ -102,6 +206,9 @@ Device& PhysicalDevice::createDevice(
     if (conf.present) {
         assert(presentSupported());
     }
+    if (conf.gpu_culling) {
+        assert(gpuCullingSupported());
+    }
     return m_devices.emplace_back(*this, conf);
 }
 
@@ -113,6 +220,10 @@ bool GraphicsDevice::presentSupported() const {
     return static_cast<const PhysicalDevice*>(this)->presentSupported();
 }
 
+bool GraphicsDevice::gpuCullingSupported() const {
+    return static_cast<const PhysicalDevice*>(this)->gpuCullingSupported();
+}
+
 GraphicsDeviceConnection& GraphicsDevice::createConnection(
     const GraphicsDeviceConnectionFeatures& conf
 ) {
@@ -124,7 +235,8 @@ Device::Device(
     const GraphicsDeviceConnectionFeatures& conf
 ): m_instance(dev.getInstance()),
    m_physical_device(dev.getPhysicalDevice()),
-   m_queue_families(dev.getQueueFamilies()) {
+   m_queue_families(dev.getQueueFamilies()),
+   m_features(conf) {
     create(conf);
 }
 
@@ -136,24 +248,30 @@ void Device::create(
         exts.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
     }
 
-    m_device.reset(createDevice(m_physical_device, m_queue_families, exts));
+    m_device.reset(createDevice(m_physical_device, m_queue_families, conf, exts));
     m_queues = findQueues(m_device.get(), m_queue_families); 
 }
 
 SceneImpl& Device::createSceneImpl(
-    const Camera& camera, uint32_t width, uint32_t height
+    const Camera& camera, uint32_t width, uint32_t height,
+    const SceneCreationFeatures& conf
 ) {
+    if (conf.gpu_culling) {
+        assert(m_features.gpu_culling);
+    }
 
     return m_scenes.emplace_back(
         camera,
         *this,
-        width, height
+        width, height,
+        conf
     );
 }
 
 Scene& GraphicsDeviceConnection::createScene(
-    const Camera& camera, uint32_t width, uint32_t height
+    const Camera& camera, uint32_t width, uint32_t height,
+    const SceneCreationFeatures& conf
 ) {
-    return static_cast<Device*>(this)->createSceneImpl(camera, width, height);
+    return static_cast<Device*>(this)->createSceneImpl(camera, width, height, conf);
 }
 }
@@ -1,6 +1,7 @@
 #pragma once
 #include "Scene.hpp"
 
+#include <deque>
 #include <memory>
 
 namespace VKR {
@@ -24,10 +25,12 @@ class Device: public Vulkan::GraphicsDeviceConnection {
     VkInstance m_instance = VK_NULL_HANDLE;
     VkPhysicalDevice m_physical_device = VK_NULL_HANDLE;
     QueueFamilies m_queue_families;
+    GraphicsDeviceConnectionFeatures m_features;
     Detail::VkDeviceUniqueHandle m_device = VK_NULL_HANDLE;
     Queues m_queues;
 
-    std::vector<SceneImpl> m_scenes;
+    // Scenes are handed out by reference, so they must never be relocated
+    std::deque<SceneImpl> m_scenes;
 
 public:
     Device(
@@ -51,6 +54,10 @@ public:
         return m_queue_families;
     }
 
+    const GraphicsDeviceConnectionFeatures& getFeatures() const {
+        return m_features;
+    }
+
     VkDevice getDevice() const {
         return m_device.get();
     }
@@ -60,7 +67,8 @@ public:
     }
 
     SceneImpl& createSceneImpl(
-        const Camera& camera, uint32_t width, uint32_t height
+        const Camera& camera, uint32_t width, uint32_t height,
+        const SceneCreationFeatures& conf
     );
 
     bool WSISwapchainPresentModeSupported(
@@ -74,6 +82,8 @@ class PhysicalDevice: public Vulkan::GraphicsDevice {
     QueueFamilies m_queue_families;
 
     VkPhysicalDeviceProperties m_properties;
+    bool m_timeline_semaphore_supported = false;
+    bool m_gpu_culling_supported = false;
 
     std::vector<Device> m_devices;
 
@@ -92,8 +102,11 @@ public:
         return m_queue_families;
     }
 
+    // Devices without timeline semaphores can't track uploads
     bool canUse() const {
-        return m_queue_families.graphics != QueueFamilies::NotFound;
+        return
+            m_queue_families.graphics != QueueFamilies::NotFound and
+            m_timeline_semaphore_supported;
     }
 
     explicit operator bool() const {
@@ -115,6 +128,10 @@ public:
 
     bool presentSupported() const;
 
+    bool gpuCullingSupported() const {
+        return m_gpu_culling_supported;
+    }
+
     Device& createDevice(
         const GraphicsDeviceConnectionFeatures& conf
     );
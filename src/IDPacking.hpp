@@ -26,8 +26,13 @@ inline constexpr auto getModelIDWidth() {
     );
 }
 
+// Generations let stale IDs of destroyed models be detected
+inline constexpr unsigned getModelIDGenerationWidth() {
+    return 8;
+}
+
 inline constexpr auto getModelIDIndexWidth() {
-    return getModelIDWidth() - getStorageWidth();
+    return getModelIDWidth() - getModelIDGenerationWidth() - getStorageWidth();
 }
 
 struct MeshIDImpl {
@@ -43,6 +48,7 @@ static_assert(sizeof(MaterialIDImpl) == sizeof(MaterialID));
 
 struct ModelIDImpl {
     Detail::modelid index: getModelIDIndexWidth();
+    Detail::modelid generation: getModelIDGenerationWidth();
     MeshStorageFormat storage_format: getStorageWidth();
 };
 static_assert(sizeof(ModelIDImpl) == sizeof(ModelID));
@@ -69,16 +75,22 @@ inline MeshStorageFormat getModelMeshStorageFormat(ModelID model) {
     return std::bit_cast<ModelIDImpl>(model).storage_format;
 }
 
-inline size_t getModelIndex(ModelID mesh) {
-    return std::bit_cast<ModelIDImpl>(mesh).index;
+inline size_t getModelIndex(ModelID model) {
+    return std::bit_cast<ModelIDImpl>(model).index;
+}
+
+inline Detail::modelid getModelGeneration(ModelID model) {
+    return std::bit_cast<ModelIDImpl>(model).generation;
 }
 
 inline ModelID makeModelID(
-    Detail::modelid index, MeshStorageFormat storage_format
+    Detail::modelid index, Detail::modelid generation,
+    MeshStorageFormat storage_format
 ) {
     ModelIDImpl id = {
         .index = index,
-        .storage_format = MeshStorageFormat::Static,
+        .generation = generation,
+        .storage_format = storage_format,
     };
     return std::bit_cast<ModelID>(id);
 }
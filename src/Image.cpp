@@ -6,7 +6,8 @@ void Image::create(
     VkFormat format,
     VkImageCreateFlags flags,
     uint32_t width, uint32_t height,
-    VkImageUsageFlags usage
+    VkImageUsageFlags usage,
+    uint32_t mip_levels
 ) {
     VkImageCreateInfo create_info = {
         .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
@@ -18,7 +19,7 @@ void Image::create(
             .height = height,
             .depth = 1,
         },
-        .mipLevels = 1,
+        .mipLevels = mip_levels,
         .arrayLayers = 1,
         .samples = VK_SAMPLE_COUNT_1_BIT,
         .tiling = VK_IMAGE_TILING_OPTIMAL,
@@ -38,7 +39,9 @@ VkImageView createImageView(
     VkDevice device,
     VkImage image,
     VkFormat format,
-    VkImageAspectFlags aspect
+    VkImageAspectFlags aspect,
+    uint32_t base_mip_level,
+    uint32_t mip_level_count
 ) {
     VkImageViewCreateInfo create_info = {
         .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
@@ -47,8 +50,8 @@ VkImageView createImageView(
         .format = format,
         .subresourceRange = {
             .aspectMask = aspect,
-            .baseMipLevel = 0,
-            .levelCount = 1,
+            .baseMipLevel = base_mip_level,
+            .levelCount = mip_level_count,
             .baseArrayLayer = 0,
             .layerCount = 1,
         },
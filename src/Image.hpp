@@ -11,7 +11,8 @@ struct Image {
         VkFormat format,
         VkImageCreateFlags flags,
         uint32_t width, uint32_t height,
-        VkImageUsageFlags usage
+        VkImageUsageFlags usage,
+        uint32_t mip_levels = 1
     );
 
     void destroy(VmaAllocator allocator) {
@@ -25,10 +26,11 @@ inline auto createImage(
     VkFormat format,
     VkImageCreateFlags flags,
     uint32_t width, uint32_t height,
-    VkImageUsageFlags usage
+    VkImageUsageFlags usage,
+    uint32_t mip_levels = 1
 ) {
     Image img;
-    img.create(allocator, format, flags, width, height, usage);
+    img.create(allocator, format, flags, width, height, usage, mip_levels);
     return img;
 }
 
@@ -49,11 +51,12 @@ inline auto createColorImage(
 inline auto createDepthImage(
     VmaAllocator allocator,
     VkFormat format,
-    uint32_t width, uint32_t height
+    uint32_t width, uint32_t height,
+    VkImageUsageFlags extra_usage = 0
 ) {
     return createImage(
         allocator, format, 0, width, height,
-        VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT
+        VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | extra_usage
     );
 }
 
@@ -62,7 +65,9 @@ VkImageView createImageView(
     VkDevice device,
     VkImage image,
     VkFormat format,
-    VkImageAspectFlags aspect
+    VkImageAspectFlags aspect,
+    uint32_t base_mip_level = 0,
+    uint32_t mip_level_count = 1
 );
 
 [[nodiscard]]
@@ -0,0 +1,52 @@
+#include "JobQueue.hpp"
+
+#include <cassert>
+
+namespace VKR {
+void JobQueue::create(size_t thread_count) {
+    assert(m_workers.empty());
+    assert(thread_count > 0);
+    for (size_t i = 0; i < thread_count; i++) {
+        m_workers.emplace_back([this] { workerLoop(); });
+    }
+}
+
+void JobQueue::destroy() {
+    {
+        std::lock_guard lock(m_mutex);
+        m_stop = true;
+        m_jobs.clear();
+    }
+    m_cv.notify_all();
+    for (auto& w: m_workers) {
+        w.join();
+    }
+    m_workers.clear();
+    m_stop = false;
+}
+
+void JobQueue::submit(std::function<void()> job) {
+    assert(!m_workers.empty());
+    {
+        std::lock_guard lock(m_mutex);
+        m_jobs.push_back(std::move(job));
+    }
+    m_cv.notify_one();
+}
+
+void JobQueue::workerLoop() {
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock lock(m_mutex);
+            m_cv.wait(lock, [&] { return m_stop or !m_jobs.empty(); });
+            if (m_stop) {
+                return;
+            }
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+        job();
+    }
+}
+}
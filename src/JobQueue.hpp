@@ -0,0 +1,33 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace VKR {
+// Background threads that run submitted jobs in order of submission, for
+// work that must not hold up the caller
+class JobQueue {
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<std::function<void()>> m_jobs;
+    bool m_stop = false;
+
+public:
+    void create(size_t thread_count);
+    // Drops the jobs that haven't started and waits for the running ones
+    void destroy();
+
+    bool empty() const {
+        return m_workers.empty();
+    }
+
+    void submit(std::function<void()> job);
+
+private:
+    void workerLoop();
+};
+}
@@ -1,16 +1,21 @@
 #include "Material.hpp"
+#include "Quantization.hpp"
+#include "Shader.hpp"
 
 namespace VKR {
 namespace {
 VkPipelineLayout createMaterialPipelineLayout(
-    VkDevice device
+    VkDevice device,
+    VkDescriptorSetLayout frame_set_layout
 ) {
     VkPushConstantRange push_range = {
         .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
-        .size = sizeof(glm::mat4),
+        .size = sizeof(MaterialPushConstants),
     };
     VkPipelineLayoutCreateInfo create_info = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &frame_set_layout,
         .pushConstantRangeCount = 1,
         .pPushConstantRanges = &push_range,
     };
@@ -19,34 +24,16 @@ VkPipelineLayout createMaterialPipelineLayout(
     return layout;
 }
 
-VkShaderModule createShaderModule(
-    VkDevice device,
-    std::span<const std::byte> shader_binary
-) {
-    VkShaderModuleCreateInfo create_info = {
-        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-        .codeSize = shader_binary.size_bytes(),
-        .pCode = reinterpret_cast<const uint32_t*>(
-            shader_binary.data()
-        ),
-    };
-
-    VkShaderModule shader_module;
-    vkCreateShaderModule(device, &create_info, nullptr, &shader_module);
-
-    return shader_module;
-}
-
 VkPipeline createMaterialPipeline(
     VkDevice device,
-    std::span<const std::byte> vert_shader_binary,
-    std::span<const std::byte> frag_shader_binary,
+    VkShaderModule vert_shader_module,
+    VkShaderModule frag_shader_module,
     VkPipelineLayout layout,
-    VkRenderPass render_pass
+    VkRenderPass render_pass,
+    MaterialPass pass,
+    VertexFormat vertex_format
 ) {
-    auto vert_shader_module = createShaderModule(device, vert_shader_binary);
-    auto frag_shader_module = createShaderModule(device, frag_shader_binary);
-
+    using enum MaterialPass;
     auto getShaderStageCreateInfo =
     [](VkShaderStageFlagBits stage, VkShaderModule shader_module) {
         return VkPipelineShaderStageCreateInfo {
@@ -61,17 +48,24 @@ VkPipeline createMaterialPipeline(
         getShaderStageCreateInfo(VK_SHADER_STAGE_VERTEX_BIT, vert_shader_module),
         getShaderStageCreateInfo(VK_SHADER_STAGE_FRAGMENT_BIT, frag_shader_module),
     };
+    // Depth only pipelines have no fragment shader
+    uint32_t stage_count = pass == Depth ? 1 : stages.size();
 
+    // The shader's vec3 input ignores the quantized position's w
+    bool quantized = vertex_format == VertexFormat::Quantized;
     VkVertexInputBindingDescription binding_desc = {
-        .binding = 0,
-        .stride = sizeof(glm::vec3),
+        .binding = c_vertex_binding,
+        .stride = static_cast<uint32_t>(
+            quantized ? sizeof(QuantizedPosition) : sizeof(glm::vec3)
+        ),
         .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
     };
 
     VkVertexInputAttributeDescription attribute_desc = {
         .location = 0,
-        .binding = 0,
-        .format = VK_FORMAT_R32G32B32_SFLOAT,
+        .binding = c_vertex_binding,
+        .format = quantized ?
+            VK_FORMAT_R16G16B16A16_SNORM : VK_FORMAT_R32G32B32_SFLOAT,
     };
 
     VkPipelineVertexInputStateCreateInfo vertex_input = {
@@ -107,8 +101,10 @@ VkPipeline createMaterialPipeline(
     VkPipelineDepthStencilStateCreateInfo depth_stencil = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
         .depthTestEnable = true,
-        .depthWriteEnable = true,
-        .depthCompareOp = VK_COMPARE_OP_LESS,
+        .depthWriteEnable = pass != Shading,
+        // Shading after the pre-pass only runs for the nearest surface
+        .depthCompareOp =
+            pass == Shading ? VK_COMPARE_OP_EQUAL : VK_COMPARE_OP_LESS,
     };
 
     VkPipelineColorBlendAttachmentState color_blend_attachment = {
@@ -121,7 +117,7 @@ VkPipeline createMaterialPipeline(
 
     VkPipelineColorBlendStateCreateInfo color_blend = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
-        .attachmentCount = 1,
+        .attachmentCount = pass == Depth ? 0u : 1u,
         .pAttachments = &color_blend_attachment,
     };
 
@@ -138,7 +134,7 @@ VkPipeline createMaterialPipeline(
 
     VkGraphicsPipelineCreateInfo create_info {
         .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-        .stageCount = stages.size(),
+        .stageCount = stage_count,
         .pStages = stages.data(),
         .pVertexInputState = &vertex_input,
         .pInputAssemblyState = &input_assembly,
@@ -150,14 +146,11 @@ VkPipeline createMaterialPipeline(
         .pDynamicState = &dynamic,
         .layout = layout,
         .renderPass = render_pass,
-        .subpass = 0,
+        .subpass = pass == Shading ? 1u : 0u,
     };
     
     VkPipeline pipeline;
     vkCreateGraphicsPipelines(device, nullptr, 1, &create_info, nullptr, &pipeline);
-
-    vkDestroyShaderModule(device, vert_shader_module, nullptr);
-    vkDestroyShaderModule(device, frag_shader_module, nullptr);
     
     return pipeline;
 }
@@ -167,15 +160,44 @@ void Material::create(
     VkDevice device,
     std::span<const std::byte> vert_shader_binary,
     std::span<const std::byte> frag_shader_binary,
-    VkRenderPass render_pass
+    VkRenderPass render_pass,
+    VkDescriptorSetLayout frame_set_layout,
+    bool depth_prepass,
+    bool quantized_positions
 ) {
-    layout = createMaterialPipelineLayout(device);
-    pipeline = createMaterialPipeline(
-        device,
-        vert_shader_binary,
-        frag_shader_binary,
-        layout,
-        render_pass
-    );
+    using enum MaterialPass;
+    auto vert_shader_module = createShaderModule(device, vert_shader_binary);
+    auto frag_shader_module = createShaderModule(device, frag_shader_binary);
+
+    layout = createMaterialPipelineLayout(device, frame_set_layout);
+    for (size_t i = 0; i < c_vertex_format_count; i++) {
+        auto format = static_cast<VertexFormat>(i);
+        if (format == VertexFormat::Quantized and !quantized_positions) {
+            continue;
+        }
+        pipelines[i] = createMaterialPipeline(
+            device,
+            vert_shader_module,
+            frag_shader_module,
+            layout,
+            render_pass,
+            depth_prepass ? Shading : Single,
+            format
+        );
+        if (depth_prepass) {
+            depth_pipelines[i] = createMaterialPipeline(
+                device,
+                vert_shader_module,
+                frag_shader_module,
+                layout,
+                render_pass,
+                Depth,
+                format
+            );
+        }
+    }
+
+    vkDestroyShaderModule(device, vert_shader_module, nullptr);
+    vkDestroyShaderModule(device, frag_shader_module, nullptr);
 }
 }
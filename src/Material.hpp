@@ -3,33 +3,94 @@
 
 #include <vulkan/vulkan.h>
 
+#include <array>
+#include <cassert>
 #include <span>
 
 namespace VKR {
+inline constexpr uint32_t c_vertex_binding = 0;
+inline constexpr uint32_t c_frame_set = 0;
+inline constexpr uint32_t c_frame_uniforms_binding = 0;
+inline constexpr uint32_t c_frame_transforms_binding = 1;
+
+enum class VertexFormat {
+    // R32G32B32_SFLOAT
+    Float,
+    // R16G16B16A16_SNORM, dequantized by the model matrix
+    Quantized,
+};
+inline constexpr size_t c_vertex_format_count = 2;
+
+struct FrameUniforms {
+    glm::mat4 proj_view;
+};
+
+// Draws read their model matrix at transform_base + gl_InstanceIndex
+struct MaterialPushConstants {
+    uint32_t transform_base;
+};
+
+// With a depth pre-pass, the render pass starts with a depth only subpass,
+// and materials shade in the second subpass where only the nearest surface
+// passes the depth test
+enum class MaterialPass {
+    Single,
+    Depth,
+    Shading,
+};
+
 struct Material {
     VkPipelineLayout layout = VK_NULL_HANDLE;
-    VkPipeline pipeline = VK_NULL_HANDLE;
+    // Indexed by VertexFormat. Quantized pipelines are only created for
+    // scenes with quantized positions.
+    std::array<VkPipeline, c_vertex_format_count> pipelines = {};
+    // Same vertex shader without a fragment shader, only with a depth
+    // pre-pass
+    std::array<VkPipeline, c_vertex_format_count> depth_pipelines = {};
 
     void create(
         VkDevice device,
         std::span<const std::byte> vert_shader_binary,
         std::span<const std::byte> frag_shader_binary,
-        VkRenderPass render_pass
+        VkRenderPass render_pass,
+        VkDescriptorSetLayout frame_set_layout,
+        bool depth_prepass,
+        bool quantized_positions
     );
 
     void destroy(VkDevice device) {
-        vkDestroyPipeline(device, pipeline, nullptr);
+        for (size_t i = 0; i < c_vertex_format_count; i++) {
+            vkDestroyPipeline(device, depth_pipelines[i], nullptr);
+            vkDestroyPipeline(device, pipelines[i], nullptr);
+        }
         vkDestroyPipelineLayout(device, layout, nullptr);
     }
 
-    void bind(VkCommandBuffer cmd_buffer) {
-        vkCmdBindPipeline(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    void bind(
+        VkCommandBuffer cmd_buffer, MaterialPass pass, VertexFormat format
+    ) {
+        auto i = static_cast<size_t>(format);
+        assert(pipelines[i]);
+        vkCmdBindPipeline(
+            cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+            pass == MaterialPass::Depth ? depth_pipelines[i] : pipelines[i]
+        );
     }
 
-    void setMVP(VkCommandBuffer cmd_buffer, const glm::mat4& mvp) {
+    void setTransformBase(VkCommandBuffer cmd_buffer, uint32_t transform_base) {
+        MaterialPushConstants pc = {
+            .transform_base = transform_base,
+        };
         vkCmdPushConstants(
             cmd_buffer, layout, VK_SHADER_STAGE_VERTEX_BIT,
-            0, sizeof(glm::mat4), &mvp
+            0, sizeof(pc), &pc
+        );
+    }
+
+    void bindFrameSet(VkCommandBuffer cmd_buffer, VkDescriptorSet set) {
+        vkCmdBindDescriptorSets(
+            cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout,
+            c_frame_set, 1, &set, 0, nullptr
         );
     }
 };
@@ -1,22 +1,468 @@
 #include "Mesh.hpp"
+#include "MeshOptimizer.hpp"
+
+#include <glm/geometric.hpp>
+
+#include <cassert>
+#include <cmath>
+#include <tuple>
 
 namespace VKR {
-void StaticMesh::create(
-    VkDevice device, VmaAllocator allocator,
-    VkQueue graphics_queue, VkCommandPool cmd_pool,
-    std::span<const glm::vec3> vertices
+namespace {
+// Cones whose normals are spread further than this never cull anything
+constexpr float c_min_meshlet_cone_cos = 0.1f;
+
+constexpr uint8_t c_no_local_index = 0xFF;
+
+class MeshletBuilder {
+    std::span<const glm::vec3> m_positions;
+    std::span<const uint32_t> m_indices;
+    MeshletData& m_data;
+    // Triangles around every vertex
+    std::vector<uint32_t> m_adjacency_offsets;
+    std::vector<uint32_t> m_adjacency;
+    std::vector<uint8_t> m_emitted;
+    // Triangles left around every vertex
+    std::vector<uint32_t> m_live_counts;
+    // Index of every vertex within the current meshlet
+    std::vector<uint8_t> m_local_indices;
+    std::vector<uint32_t> m_vertices;
+    glm::vec3 m_position_sum = {};
+    std::vector<uint32_t> m_triangles;
+    // Triangles next to the current meshlet, may hold emitted ones
+    std::vector<uint32_t> m_candidates;
+    // Meshlet for which every triangle was last made a candidate, which
+    // keeps duplicates out of the list
+    std::vector<uint32_t> m_candidate_meshlets;
+
+public:
+    MeshletBuilder(
+        std::span<const glm::vec3> positions,
+        std::span<const uint32_t> indices,
+        MeshletData& data
+    ):
+        m_positions(positions),
+        m_indices(indices),
+        m_data(data),
+        m_adjacency_offsets(positions.size() + 1, 0),
+        m_adjacency(indices.size()),
+        m_emitted(indices.size() / 3, false),
+        m_local_indices(positions.size(), c_no_local_index),
+        m_candidate_meshlets(indices.size() / 3, UINT32_MAX)
+    {
+        for (auto v: m_indices) {
+            m_adjacency_offsets[v + 1]++;
+        }
+        m_live_counts.assign(
+            m_adjacency_offsets.begin() + 1, m_adjacency_offsets.end()
+        );
+        for (size_t v = 0; v < positions.size(); v++) {
+            m_adjacency_offsets[v + 1] += m_adjacency_offsets[v];
+        }
+        auto fill = m_adjacency_offsets;
+        for (size_t i = 0; i < m_indices.size(); i++) {
+            m_adjacency[fill[m_indices[i]]++] = i / 3;
+        }
+    }
+
+    void build() {
+        auto triangle_count = m_emitted.size();
+        size_t next_unemitted = 0;
+        for (size_t emitted = 0; emitted < triangle_count; emitted++) {
+            auto t = pickCandidate();
+            if (t == UINT32_MAX) {
+                if (!m_candidates.empty()) {
+                    // Neighbours exist but don't fit, so start a new
+                    // meshlet next to this one
+                    finishMeshlet();
+                    t = pickCandidate();
+                } else {
+                    // Out of neighbours, start a new meshlet from the next
+                    // triangle of the input instead of stretching this one
+                    if (!m_triangles.empty()) {
+                        finishMeshlet();
+                    }
+                    while (m_emitted[next_unemitted]) {
+                        next_unemitted++;
+                    }
+                    t = next_unemitted;
+                }
+            }
+            addTriangle(t);
+            if (m_triangles.size() == c_meshlet_max_triangles) {
+                finishMeshlet();
+            }
+        }
+        if (!m_triangles.empty()) {
+            finishMeshlet();
+        }
+    }
+
+private:
+    uint32_t newVertexCount(uint32_t t) const {
+        uint32_t count = 0;
+        for (int i = 0; i < 3; i++) {
+            count += m_local_indices[m_indices[3 * t + i]] == c_no_local_index;
+        }
+        return count;
+    }
+
+    // Picks the neighbour that adds the fewest vertices. Ties go to the
+    // one with the fewest triangles left around its vertices, which fills
+    // corners instead of leaving isolated pockets behind, and then to the
+    // closest one to the meshlet's center, which keeps meshlets round.
+    // Emitted triangles are dropped from the candidates on the way.
+    uint32_t pickCandidate() {
+        auto center = m_vertices.empty() ?
+            glm::vec3(0.0f) : m_position_sum / float(m_vertices.size());
+        uint32_t best = UINT32_MAX;
+        uint32_t best_count = 4;
+        uint32_t best_live = 0;
+        float best_distance = 0.0f;
+        for (size_t i = 0; i < m_candidates.size();) {
+            auto t = m_candidates[i];
+            if (m_emitted[t]) {
+                m_candidates[i] = m_candidates.back();
+                m_candidates.pop_back();
+                continue;
+            }
+            i++;
+            auto count = newVertexCount(t);
+            if (
+                count > best_count or
+                m_vertices.size() + count > c_meshlet_max_vertices
+            ) {
+                continue;
+            }
+            const auto* tri = &m_indices[3 * t];
+            auto live =
+                m_live_counts[tri[0]] + m_live_counts[tri[1]] +
+                m_live_counts[tri[2]];
+            auto d =
+                m_positions[tri[0]] + m_positions[tri[1]] +
+                m_positions[tri[2]] - 3.0f * center;
+            auto distance = glm::dot(d, d);
+            if (
+                std::tie(count, live, distance) <
+                std::tie(best_count, best_live, best_distance)
+            ) {
+                best = t;
+                best_count = count;
+                best_live = live;
+                best_distance = distance;
+            }
+        }
+        return best;
+    }
+
+    void addCandidate(uint32_t t) {
+        auto meshlet = static_cast<uint32_t>(m_data.meshlets.size());
+        if (!m_emitted[t] and m_candidate_meshlets[t] != meshlet) {
+            m_candidate_meshlets[t] = meshlet;
+            m_candidates.push_back(t);
+        }
+    }
+
+    void addTriangle(uint32_t t) {
+        uint32_t packed = 0;
+        for (int i = 0; i < 3; i++) {
+            auto v = m_indices[3 * t + i];
+            if (m_local_indices[v] == c_no_local_index) {
+                m_local_indices[v] = m_vertices.size();
+                m_vertices.push_back(v);
+                m_position_sum += m_positions[v];
+                for (
+                    auto a = m_adjacency_offsets[v];
+                    a < m_adjacency_offsets[v + 1]; a++
+                ) {
+                    addCandidate(m_adjacency[a]);
+                }
+            }
+            packed |= uint32_t(m_local_indices[v]) << (8 * i);
+        }
+        m_triangles.push_back(packed);
+        m_emitted[t] = true;
+        for (int i = 0; i < 3; i++) {
+            m_live_counts[m_indices[3 * t + i]]--;
+        }
+    }
+
+    void finishMeshlet() {
+        std::array<glm::vec3, c_meshlet_max_vertices> positions;
+        for (size_t i = 0; i < m_vertices.size(); i++) {
+            positions[i] = m_positions[m_vertices[i]];
+        }
+        auto bounds = computeMeshBounds(
+            std::span(positions).first(m_vertices.size())
+        );
+
+        std::array<glm::vec3, c_meshlet_max_triangles> normals;
+        size_t normal_count = 0;
+        glm::vec3 axis = {};
+        for (auto packed: m_triangles) {
+            auto n = glm::cross(
+                positions[(packed >> 8) & 0xFF] - positions[packed & 0xFF],
+                positions[(packed >> 16) & 0xFF] - positions[packed & 0xFF]
+            );
+            auto length = glm::length(n);
+            if (length > 0.0f) {
+                normals[normal_count++] = n / length;
+                axis += n / length;
+            }
+        }
+        glm::vec4 cone = {0.0f, 0.0f, 0.0f, 1.0f};
+        auto axis_length = glm::length(axis);
+        if (axis_length > 0.0f) {
+            axis /= axis_length;
+            auto min_cos = 1.0f;
+            for (size_t i = 0; i < normal_count; i++) {
+                min_cos = std::min(min_cos, glm::dot(axis, normals[i]));
+            }
+            cone = {axis, 1.0f};
+            if (min_cos > c_min_meshlet_cone_cos) {
+                cone.w = std::sqrt(1.0f - min_cos * min_cos);
+            }
+        }
+
+        // The next meshlet starts from the neighbour that shares the most
+        // vertices with this one, which keeps the candidate list short and
+        // meshlets compact
+        uint32_t seed = UINT32_MAX;
+        uint32_t seed_count = 4;
+        for (auto t: m_candidates) {
+            if (!m_emitted[t] and newVertexCount(t) < seed_count) {
+                seed = t;
+                seed_count = newVertexCount(t);
+            }
+        }
+        m_candidates.clear();
+
+        m_data.meshlets.push_back({
+            .sphere = bounds.sphere,
+            .cone = cone,
+            .vertex_offset = static_cast<uint32_t>(m_data.vertices.size()),
+            .triangle_offset = static_cast<uint32_t>(m_data.triangles.size()),
+            .vertex_count = static_cast<uint32_t>(m_vertices.size()),
+            .triangle_count = static_cast<uint32_t>(m_triangles.size()),
+        });
+        for (auto v: m_vertices) {
+            m_local_indices[v] = c_no_local_index;
+        }
+        m_data.vertices.insert(
+            m_data.vertices.end(), m_vertices.begin(), m_vertices.end()
+        );
+        m_data.positions.insert(
+            m_data.positions.end(),
+            positions.begin(), positions.begin() + m_vertices.size()
+        );
+        m_data.triangles.insert(
+            m_data.triangles.end(), m_triangles.begin(), m_triangles.end()
+        );
+        m_vertices.clear();
+        m_triangles.clear();
+        m_position_sum = {};
+        if (seed != UINT32_MAX) {
+            addCandidate(seed);
+        }
+    }
+};
+}
+
+MeshletData buildMeshlets(
+    std::span<const glm::vec3> positions, std::span<const uint32_t> indices
 ) {
-    auto staging_buffer = createStagingBuffer(allocator, vertices.size_bytes());
-    copyToStagingBuffer(allocator, vertices, staging_buffer.allocation);
-    buffer = createStaticBuffer(allocator, vertices.size_bytes());
-    copyBuffer(
-        device, graphics_queue,
-        staging_buffer.buffer, buffer.buffer,
-        vertices.size_bytes(), 0, 0,
-        cmd_pool
+    assert(indices.size() % 3 == 0);
+    MeshletData data;
+    MeshletBuilder(positions, indices, data).build();
+    return data;
+}
+
+StaticMeshGeometry buildStaticMeshGeometry(std::span<const MeshLOD> lods) {
+    assert(!lods.empty() and lods.size() <= c_max_mesh_lods);
+    // Indexed levels are expanded, so that duplicates in their vertices
+    // are welded too
+    std::vector<glm::vec3> triangles;
+    for (const auto& lod: lods) {
+        if (lod.indices.empty()) {
+            triangles.insert(
+                triangles.end(), lod.vertices.begin(), lod.vertices.end()
+            );
+        } else {
+            for (auto i: lod.indices) {
+                triangles.push_back(lod.vertices[i]);
+            }
+        }
+    }
+
+    // Welded vertices are numbered in order of first occurrence, which
+    // puts the full detail level's first
+    StaticMeshGeometry geometry = {
+        .mesh = weldVertices(triangles),
+    };
+    auto& mesh = geometry.mesh;
+    uint32_t first_index = 0;
+    for (const auto& lod: lods) {
+        uint32_t count = lod.indices.empty() ?
+            lod.vertices.size() : lod.indices.size();
+        assert(count % 3 == 0);
+        optimizeVertexCache(
+            std::span(mesh.indices).subspan(first_index, count),
+            mesh.positions.size()
+        );
+        geometry.lods.push_back({
+            .first_index = first_index,
+            .index_count = count,
+            .error = lod.error,
+        });
+        first_index += count;
+    }
+    optimizeVertexFetch(mesh);
+
+    return geometry;
+}
+
+void GeometryPools::create(VmaAllocator allocator) {
+    // 48 MiB of positions and 64 MiB of indices. Blocks are only
+    // allocated once used, so scenes without quantized positions don't
+    // pay for their pool.
+    vertices.create(
+        allocator, sizeof(glm::vec3), 1 << 22,
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT
     );
-    vertex_count = vertices.size();
-    staging_buffer.destroy(allocator);
+    quantized_vertices.create(
+        allocator, sizeof(QuantizedPosition), 1 << 22,
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT
+    );
+    indices16.create(
+        allocator, sizeof(uint16_t), 1 << 25,
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT
+    );
+    indices32.create(
+        allocator, sizeof(uint32_t), 1 << 24,
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT
+    );
+}
+
+void GeometryPools::destroy() {
+    vertices.destroy();
+    quantized_vertices.destroy();
+    indices16.destroy();
+    indices32.destroy();
+}
+
+void StaticMesh::create(
+    GeometryPools& pools,
+    StaticMeshGeometry geometry,
+    const PositionQuantizationPolicy& quantization_policy,
+    StaticMeshUploads& uploads
+) {
+    const auto& g = uploads.geometry.emplace_back(std::move(geometry));
+    const auto& mesh = g.mesh;
+    // Coarse levels may bulge out of the full detail mesh, so bounds
+    // cover all of them
+    bounds = computeMeshBounds(mesh.positions);
+
+    vertex_format = VertexFormat::Float;
+    quantization = {};
+    std::span<const std::byte> vertex_data =
+        std::as_bytes(std::span(mesh.positions));
+    if (quantization_policy.enabled) {
+        std::vector<QuantizedPosition> quantized(mesh.positions.size());
+        auto q = quantizePositions(mesh.positions, bounds, quantized);
+        if (
+            quantization_policy.max_error == 0.0f or
+            q.error <= quantization_policy.max_error
+        ) {
+            vertex_format = VertexFormat::Quantized;
+            quantization = q;
+            vertex_data = std::as_bytes(std::span(
+                uploads.quantized_positions.emplace_back(std::move(quantized))
+            ));
+        } else {
+            quantization.error = q.error;
+        }
+    }
+
+    auto& vertex_pool = pools.vertexPool(vertex_format);
+    vertices = vertex_pool.allocate(mesh.positions.size());
+    uploads.copies.push_back({
+        .dst = vertex_pool.buffer(vertices.block),
+        .dst_offset = size_t(vertices.first) * vertex_pool.elementSize(),
+        .data = vertex_data,
+    });
+
+    // Levels are relative to the block, so draws don't need an offset
+    index_type = mesh.positions.size() <= (1 << 16) ?
+        VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+    auto& index_pool = pools.indices(index_type);
+    indices = index_pool.allocate(mesh.indices.size());
+    std::span<const std::byte> index_data;
+    if (index_type == VK_INDEX_TYPE_UINT16) {
+        auto& short_indices = uploads.short_indices.emplace_back(
+            mesh.indices.begin(), mesh.indices.end()
+        );
+        index_data = std::as_bytes(std::span(short_indices));
+    } else {
+        index_data = std::as_bytes(std::span(mesh.indices));
+    }
+    uploads.copies.push_back({
+        .dst = index_pool.buffer(indices.block),
+        .dst_offset = size_t(indices.first) * index_pool.elementSize(),
+        .data = index_data,
+    });
+
+    lods = g.lods;
+    for (auto& lod: lods) {
+        lod.first_index += indices.first;
+    }
+}
+
+void StaticMesh::getUploadRanges(
+    const GeometryPools& pools, std::vector<Uploader::Range>& ranges
+) const {
+    const auto& vertex_pool = pools.vertexPool(vertex_format);
+    ranges.push_back({
+        .buffer = vertex_pool.buffer(vertices.block),
+        .offset = size_t(vertices.first) * vertex_pool.elementSize(),
+        .size = size_t(vertices.count) * vertex_pool.elementSize(),
+    });
+    const auto& index_pool = pools.indices(index_type);
+    ranges.push_back({
+        .buffer = index_pool.buffer(indices.block),
+        .offset = size_t(indices.first) * index_pool.elementSize(),
+        .size = size_t(indices.count) * index_pool.elementSize(),
+    });
+}
+
+void StaticMeshBindings::bindVertices(
+    VkCommandBuffer cmd_buffer, const GeometryPools& pools,
+    VertexFormat vertex_format, uint32_t vertex_block
+) {
+    if (m_vertex_format != vertex_format or m_vertex_block != vertex_block) {
+        m_vertex_format = vertex_format;
+        m_vertex_block = vertex_block;
+        auto buffer = pools.vertexPool(m_vertex_format).buffer(m_vertex_block);
+        VkDeviceSize offset = 0;
+        vkCmdBindVertexBuffers(cmd_buffer, 0, 1, &buffer, &offset);
+    }
+}
+
+void StaticMeshBindings::bind(
+    VkCommandBuffer cmd_buffer,
+    const GeometryPools& pools, const StaticMeshBuffers& buffers
+) {
+    bindVertices(cmd_buffer, pools, buffers.vertex_format, buffers.vertex_block);
+    if (
+        m_index_type != buffers.index_type or
+        m_index_block != buffers.index_block
+    ) {
+        m_index_type = buffers.index_type;
+        m_index_block = buffers.index_block;
+        vkCmdBindIndexBuffer(
+            cmd_buffer, pools.indices(m_index_type).buffer(m_index_block),
+            0, m_index_type
+        );
+    }
 }
 
 void DynamicMesh::create(
@@ -41,5 +487,6 @@ void DynamicMesh::setVertexData(
         current_frame, frame_count
     );
     vertex_count = vertices.size();
+    bounds = computeMeshBounds(vertices);
 }
 };
@@ -1,28 +1,276 @@
 #pragma once
+#include "Bounds.hpp"
 #include "Buffer.hpp"
+#include "BufferPool.hpp"
+#include "Material.hpp"
+#include "Quantization.hpp"
+#include "Simplify.hpp"
+#include "Uploader.hpp"
+#include "VKR.hpp"
+
+#include <glm/vec4.hpp>
+
+#include <algorithm>
+#include <compare>
+#include <deque>
+#include <vector>
 
 namespace VKR {
+// Indices of one level of detail within the mesh's index buffer
+struct MeshLODRange {
+    uint32_t first_index;
+    uint32_t index_count;
+    float error;
+};
+
+// A coarser level is only picked once its error is this fraction of the
+// threshold, so that models near a switching distance don't flicker
+inline constexpr float c_lod_hysteresis = 0.75f;
+
+// error_scale converts model space error to multiples of the threshold.
+// Starts from the current level, which keeps switches rare.
+inline uint32_t selectMeshLOD(
+    std::span<const MeshLODRange> lods, uint32_t current, float error_scale
+) {
+    auto lod = std::min<uint32_t>(current, lods.size() - 1);
+    while (lod > 0 and lods[lod].error * error_scale > 1.0f) {
+        lod--;
+    }
+    while (
+        lod + 1 < lods.size() and
+        lods[lod + 1].error * error_scale <= c_lod_hysteresis
+    ) {
+        lod++;
+    }
+    return lod;
+}
+
+inline constexpr uint32_t c_meshlet_max_vertices = 64;
+inline constexpr uint32_t c_meshlet_max_triangles = 124;
+
+// Cluster of neighbouring triangles that is culled on its own
+struct Meshlet {
+    // Center in xyz, radius in w
+    glm::vec4 sphere;
+    // Axis of a cone around all triangle normals in xyz, and the sine of
+    // its half angle in w. A viewer for which the sphere is entirely in
+    // the cone's direction sees only back faces. w is 1 for cones too wide
+    // to ever cull.
+    glm::vec4 cone;
+    uint32_t vertex_offset;
+    uint32_t triangle_offset;
+    uint32_t vertex_count;
+    uint32_t triangle_count;
+};
+
+struct MeshletData {
+    std::vector<Meshlet> meshlets;
+    // Vertex buffer index of every vertex of every meshlet
+    std::vector<uint32_t> vertices;
+    // Position of every vertex of every meshlet, for culling triangles
+    // without access to the vertex buffer
+    std::vector<glm::vec3> positions;
+    // Three 8 bit indices into the meshlet's vertices per triangle
+    std::vector<uint32_t> triangles;
+
+    bool empty() const {
+        return meshlets.empty();
+    }
+};
+
+// Greedily grows meshlets over neighbouring triangles of an indexed
+// triangle list. Meshlet vertices are indices into positions.
+MeshletData buildMeshlets(
+    std::span<const glm::vec3> positions, std::span<const uint32_t> indices
+);
+
+// Levels of a static mesh welded into one vertex list. Triangles of every
+// level are ordered for the post-transform cache, and vertices in order of
+// first use. The full detail level only depends on its own triangles, so
+// adding levels later keeps its vertices and indices.
+struct StaticMeshGeometry {
+    IndexedMesh mesh;
+    // Index ranges of the levels, from 0
+    std::vector<MeshLODRange> lods;
+};
+
+StaticMeshGeometry buildStaticMeshGeometry(std::span<const MeshLOD> lods);
+
+// Buffers shared by all static meshes. Indices are relative to the mesh's
+// first vertex, so meshes with few vertices use 16 bit indices. Those have
+// a pool of their own, since the index type is set when binding. Quantized
+// positions also have their own pool, since its elements are smaller.
+struct GeometryPools {
+    BufferPool vertices;
+    BufferPool quantized_vertices;
+    BufferPool indices16;
+    BufferPool indices32;
+
+    void create(VmaAllocator allocator);
+    void destroy();
+
+    BufferPool& vertexPool(VertexFormat format) {
+        return format == VertexFormat::Quantized ? quantized_vertices : vertices;
+    }
+
+    const BufferPool& vertexPool(VertexFormat format) const {
+        return format == VertexFormat::Quantized ? quantized_vertices : vertices;
+    }
+
+    BufferPool& indices(VkIndexType type) {
+        return type == VK_INDEX_TYPE_UINT16 ? indices16 : indices32;
+    }
+
+    const BufferPool& indices(VkIndexType type) const {
+        return type == VK_INDEX_TYPE_UINT16 ? indices16 : indices32;
+    }
+};
+
+// Copies of static meshes and the data they point to, which has to be kept
+// until the call to Uploader::upload
+struct StaticMeshUploads {
+    std::vector<Uploader::Upload> copies;
+    std::deque<StaticMeshGeometry> geometry;
+    std::deque<std::vector<uint16_t>> short_indices;
+    std::deque<std::vector<QuantizedPosition>> quantized_positions;
+};
+
+// Static mesh positions are quantized when enabled, unless the
+// quantization error exceeds max_error. A max_error of 0 is no limit.
+struct PositionQuantizationPolicy {
+    bool enabled = false;
+    float max_error = 0.0f;
+};
+
+// Pool blocks that the draws of a static mesh read. Draws of meshes in the
+// same blocks can be issued with the same bindings.
+struct StaticMeshBuffers {
+    VertexFormat vertex_format = VertexFormat::Float;
+    uint32_t vertex_block = 0;
+    VkIndexType index_type = VK_INDEX_TYPE_UINT32;
+    uint32_t index_block = 0;
+
+    auto operator<=>(const StaticMeshBuffers& other) const = default;
+};
+
+// All levels of detail share one range of the vertex and index pools, so
+// switching levels doesn't rebind buffers
 struct StaticMesh {
-    Buffer buffer;
-    uint32_t vertex_count = 0;
+    BufferPool::Range vertices;
+    BufferPool::Range indices;
+    VkIndexType index_type = VK_INDEX_TYPE_UINT32;
+    VertexFormat vertex_format = VertexFormat::Float;
+    // Maps mesh space to the space of the vertex buffer, which model
+    // matrices and GPU culling data have to be adjusted for. Identity for
+    // float positions, but the error is still what quantizing would cost
+    // if the policy is enabled.
+    PositionQuantization quantization;
+    // Index ranges within the index pool's block
+    std::vector<MeshLODRange> lods;
+    MeshBounds bounds;
+    // Triangle list rasterized by CPU occlusion culling
+    std::vector<glm::vec3> occluder;
+    // Meshlets of the full detail level, only built for meshes that are
+    // culled by cluster
+    MeshletData meshlets;
+    // Uploader semaphore value of the geometry's upload, until the
+    // graphics queue acquires it. 0 afterwards.
+    uint64_t upload = 0;
+    // Number of static models that draw the mesh
+    uint32_t model_count = 0;
+    // Whether the mesh is in the scene's list of meshes to acquire
+    bool acquire_queued = false;
 
+    // Appends the copies of the geometry to uploads, so that many meshes
+    // can share a submission. upload has to be set to the result of
+    // uploading them.
     void create(
-        VkDevice device, VmaAllocator allocator,
-        VkQueue graphics_queue, VkCommandPool cmd_pool,
-        std::span<const glm::vec3> vertices
+        GeometryPools& pools,
+        StaticMeshGeometry geometry,
+        const PositionQuantizationPolicy& quantization_policy,
+        StaticMeshUploads& uploads
     );
 
-    void destroy(VmaAllocator allocator) {
-        buffer.destroy(allocator);
+    void destroy(GeometryPools& pools) {
+        pools.vertexPool(vertex_format).free(vertices);
+        pools.indices(index_type).free(indices);
     }
 
-    void bind(VkCommandBuffer cmd_buffer) {
-        VkDeviceSize offset = 0;
-        vkCmdBindVertexBuffers(cmd_buffer, 0, 1, &buffer.buffer, &offset);
+    StaticMeshBuffers buffers() const {
+        return {
+            .vertex_format = vertex_format,
+            .vertex_block = vertices.block,
+            .index_type = index_type,
+            .index_block = indices.block,
+        };
+    }
+
+    // Model matrix that the vertex shader has to use for positions in the
+    // vertex buffer
+    glm::mat4 drawTransform(const glm::mat4& model_transform) const {
+        if (vertex_format == VertexFormat::Float) {
+            return model_transform;
+        }
+        return model_transform * quantization.dequantization();
+    }
+
+    // Ranges that the uploads of create released
+    void getUploadRanges(
+        const GeometryPools& pools, std::vector<Uploader::Range>& ranges
+    ) const;
+
+    void draw(
+        VkCommandBuffer cmd_buffer, uint32_t lod,
+        uint32_t instance_count, uint32_t first_instance
+    ) {
+        const auto& range = lods[lod];
+        vkCmdDrawIndexed(
+            cmd_buffer,
+            range.index_count, instance_count,
+            range.first_index, static_cast<int32_t>(vertices.first),
+            first_instance
+        );
+    }
+};
+
+// Shared buffers bound by the last static mesh draw, so that they are only
+// rebound when a mesh lives in other blocks
+class StaticMeshBindings {
+    VertexFormat m_vertex_format = VertexFormat::Float;
+    uint32_t m_vertex_block = UINT32_MAX;
+    uint32_t m_index_block = UINT32_MAX;
+    VkIndexType m_index_type = VK_INDEX_TYPE_MAX_ENUM;
+
+public:
+    void bindVertices(
+        VkCommandBuffer cmd_buffer, const GeometryPools& pools,
+        VertexFormat vertex_format, uint32_t vertex_block
+    );
+
+    void bind(
+        VkCommandBuffer cmd_buffer,
+        const GeometryPools& pools, const StaticMeshBuffers& buffers
+    );
+
+    void bindVertices(
+        VkCommandBuffer cmd_buffer,
+        const GeometryPools& pools, const StaticMesh& mesh
+    ) {
+        bindVertices(
+            cmd_buffer, pools, mesh.vertex_format, mesh.vertices.block
+        );
+    }
+
+    void bind(
+        VkCommandBuffer cmd_buffer,
+        const GeometryPools& pools, const StaticMesh& mesh
+    ) {
+        bind(cmd_buffer, pools, mesh.buffers());
     }
 
-    void draw(VkCommandBuffer cmd_buffer) {
-        vkCmdDraw(cmd_buffer, vertex_count, 1, 0, 0);
+    // For draws that bind other vertex buffers in between
+    void invalidateVertices() {
+        m_vertex_block = UINT32_MAX;
     }
 };
 
@@ -35,6 +283,9 @@ struct DynamicMesh {
     uint32_t vertex_reserved_count = 0;
     uint32_t vertex_count = 0;
     uint8_t current_frame = 0;
+    MeshBounds bounds;
+    // Triangle list rasterized by CPU occlusion culling
+    std::vector<glm::vec3> occluder;
 
     void create(
         VkDevice device, VmaAllocator allocator,
@@ -51,8 +302,15 @@ struct DynamicMesh {
         vkCmdBindVertexBuffers(cmd_buffer, 0, 1, &buffer.buffer, &offset);
     }
 
-    void draw(VkCommandBuffer cmd_buffer) {
-        vkCmdDraw(cmd_buffer, vertex_count, 1, vertex_reserved_count * current_frame, 0);
+    void draw(
+        VkCommandBuffer cmd_buffer,
+        uint32_t instance_count, uint32_t first_instance
+    ) {
+        vkCmdDraw(
+            cmd_buffer,
+            vertex_count, instance_count,
+            vertex_reserved_count * current_frame, first_instance
+        );
     }
 
     void setVertexData(
@@ -0,0 +1,115 @@
+#include "MeshOptimizer.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+namespace VKR {
+void optimizeVertexCache(
+    std::span<uint32_t> indices, size_t vertex_count,
+    uint32_t cache_size
+) {
+    assert(indices.size() % 3 == 0);
+    constexpr auto none = UINT32_MAX;
+
+    // Triangles around every vertex
+    std::vector<uint32_t> offsets(vertex_count + 1, 0);
+    for (auto v: indices) {
+        offsets[v + 1]++;
+    }
+    // Triangles left around every vertex
+    std::vector<uint32_t> live_counts(offsets.begin() + 1, offsets.end());
+    for (size_t v = 0; v < vertex_count; v++) {
+        offsets[v + 1] += offsets[v];
+    }
+    std::vector<uint32_t> adjacency(indices.size());
+    auto fill = offsets;
+    for (size_t i = 0; i < indices.size(); i++) {
+        adjacency[fill[indices[i]]++] = i / 3;
+    }
+
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+    std::vector<uint8_t> emitted(indices.size() / 3, false);
+    // Time at which every vertex last entered the cache. Vertices are in
+    // the cache while fewer than cache_size others entered after them.
+    std::vector<uint32_t> cache_times(vertex_count, 0);
+    uint32_t time = cache_size + 1;
+    // Recently emitted vertices, to continue from when the last fan has
+    // no candidate left
+    std::vector<uint32_t> dead_ends;
+    std::vector<uint32_t> candidates;
+    uint32_t cursor = 0;
+
+    auto nextFan = [&] {
+        // Prefer the vertex that entered the cache the longest ago, as
+        // long as it stays in the cache while its fan is emitted
+        auto best = none;
+        uint32_t best_priority = 0;
+        for (auto v: candidates) {
+            if (!live_counts[v]) {
+                continue;
+            }
+            auto age = time - cache_times[v];
+            if (age + 2 * live_counts[v] <= cache_size and age > best_priority) {
+                best = v;
+                best_priority = age;
+            }
+        }
+        if (best != none) {
+            return best;
+        }
+        while (!dead_ends.empty()) {
+            auto v = dead_ends.back();
+            dead_ends.pop_back();
+            if (live_counts[v]) {
+                return v;
+            }
+        }
+        for (; cursor < vertex_count; cursor++) {
+            if (live_counts[cursor]) {
+                return cursor;
+            }
+        }
+        return none;
+    };
+
+    for (auto fan = nextFan(); fan != none; fan = nextFan()) {
+        candidates.clear();
+        for (auto a = offsets[fan]; a < offsets[fan + 1]; a++) {
+            auto t = adjacency[a];
+            if (emitted[t]) {
+                continue;
+            }
+            emitted[t] = true;
+            for (size_t i = 0; i < 3; i++) {
+                auto v = indices[3 * t + i];
+                output.push_back(v);
+                dead_ends.push_back(v);
+                candidates.push_back(v);
+                live_counts[v]--;
+                if (time - cache_times[v] > cache_size) {
+                    cache_times[v] = time++;
+                }
+            }
+        }
+    }
+
+    std::ranges::copy(output, indices.begin());
+}
+
+void optimizeVertexFetch(IndexedMesh& mesh) {
+    constexpr auto none = UINT32_MAX;
+    std::vector<uint32_t> remap(mesh.positions.size(), none);
+    std::vector<glm::vec3> positions;
+    positions.reserve(mesh.positions.size());
+    for (auto& i: mesh.indices) {
+        if (remap[i] == none) {
+            remap[i] = positions.size();
+            positions.push_back(mesh.positions[i]);
+        }
+        i = remap[i];
+    }
+    mesh.positions = std::move(positions);
+}
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include "Simplify.hpp"
+
+#include <cstdint>
+#include <span>
+
+namespace VKR {
+// Reorders the triangles of an indexed triangle list for a post-transform
+// vertex cache with cache_size entries, with Tipsify. Triangles are
+// emitted in fans around vertices, and the next fan is picked among the
+// vertices of the last one that are still in the cache.
+void optimizeVertexCache(
+    std::span<uint32_t> indices, size_t vertex_count,
+    uint32_t cache_size = 16
+);
+
+// Renumbers vertices in order of first use, which makes vertex fetches
+// mostly sequential, and drops unused vertices
+void optimizeVertexFetch(IndexedMesh& mesh);
+}
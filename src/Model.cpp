@@ -1 +0,0 @@
-#include "Model.hpp"
@@ -1,36 +1,195 @@
 #pragma once
+#include "IDPacking.hpp"
 #include "VKR.hpp"
 
+#include <algorithm>
+#include <cassert>
+#include <span>
+#include <vector>
+
 namespace VKR {
-struct StaticModel {
-    MeshID mesh;
-    MaterialID material;
-    glm::mat4 transform;
+// Sparse handle of a model, stays valid while the model is alive
+struct ModelSlot {
+    Detail::modelid index;
+    Detail::modelid generation;
+};
+
+inline ModelSlot getModelSlot(ModelID model) {
+    return {
+        .index = static_cast<Detail::modelid>(getModelIndex(model)),
+        .generation = getModelGeneration(model),
+    };
+}
+
+inline ModelID makeModelID(
+    ModelSlot slot, MeshStorageFormat storage_format
+) {
+    return makeModelID(slot.index, slot.generation, storage_format);
+}
+
+// Live models are kept packed in separate arrays, so that per-frame passes
+// only touch the fields they need and never see destroyed models. Slots
+// map stable handles to dense indices, which change when a model is
+// destroyed and the last one is moved into its place.
+class ModelStorage {
+    std::vector<glm::mat4> m_transforms;
+    std::vector<MeshID> m_meshes;
+    std::vector<MaterialID> m_materials;
+    std::vector<uint8_t> m_occluders;
+    // Level of detail picked in the last frame the model was visible
+    std::vector<uint8_t> m_lods;
+    // Dense index to slot index
+    std::vector<Detail::modelid> m_slot_indices;
+
+    struct Slot {
+        Detail::modelid dense_index;
+        Detail::modelid generation;
+    };
+    std::vector<Slot> m_slots;
+    std::vector<Detail::modelid> m_free_slots;
 
-    void create(
-        MeshID mesh_id, MaterialID material_id, const glm::mat4& t
-    ) {
-        mesh = mesh_id;
-        material = material_id;
-        transform = t;
+    static constexpr Detail::modelid c_generation_mask =
+        (Detail::modelid(1) << getModelIDGenerationWidth()) - 1;
+
+public:
+    size_t size() const {
+        return m_transforms.size();
     }
 
-    void destroy() {}
-};
+    bool empty() const {
+        return m_transforms.empty();
+    }
+
+    // Grows geometrically, so that batches of one model created in a loop
+    // don't reallocate every array every time
+    void reserve(size_t count) {
+        if (count <= m_transforms.capacity()) {
+            return;
+        }
+        count = std::max(count, 2 * m_transforms.capacity());
+        m_transforms.reserve(count);
+        m_meshes.reserve(count);
+        m_materials.reserve(count);
+        m_occluders.reserve(count);
+        m_lods.reserve(count);
+        m_slot_indices.reserve(count);
+    }
+
+    ModelSlot add(MeshID mesh, MaterialID material, const glm::mat4& t) {
+        Detail::modelid slot_idx;
+        if (m_free_slots.empty()) {
+            slot_idx = m_slots.size();
+            assert(slot_idx < (size_t(1) << getModelIDIndexWidth()));
+            m_slots.push_back({});
+        } else {
+            slot_idx = m_free_slots.back();
+            m_free_slots.pop_back();
+        }
+
+        auto& slot = m_slots[slot_idx];
+        slot.dense_index = size();
+        m_transforms.push_back(t);
+        m_meshes.push_back(mesh);
+        m_materials.push_back(material);
+        m_occluders.push_back(false);
+        m_lods.push_back(0);
+        m_slot_indices.push_back(slot_idx);
+
+        return {
+            .index = slot_idx,
+            .generation = slot.generation,
+        };
+    }
+
+    void remove(ModelSlot model) {
+        auto i = denseIndex(model);
+        auto last = size() - 1;
+        if (i != last) {
+            m_transforms[i] = m_transforms[last];
+            m_meshes[i] = m_meshes[last];
+            m_materials[i] = m_materials[last];
+            m_occluders[i] = m_occluders[last];
+            m_lods[i] = m_lods[last];
+            m_slot_indices[i] = m_slot_indices[last];
+            m_slots[m_slot_indices[i]].dense_index = i;
+        }
+        m_transforms.pop_back();
+        m_meshes.pop_back();
+        m_materials.pop_back();
+        m_occluders.pop_back();
+        m_lods.pop_back();
+        m_slot_indices.pop_back();
+
+        auto& slot = m_slots[model.index];
+        slot.generation = (slot.generation + 1) & c_generation_mask;
+        m_free_slots.push_back(model.index);
+    }
+
+    bool contains(ModelSlot model) const {
+        return model.index < m_slots.size() and
+            m_slots[model.index].generation == model.generation and
+            m_slots[model.index].dense_index < size() and
+            m_slot_indices[m_slots[model.index].dense_index] == model.index;
+    }
+
+    size_t denseIndex(ModelSlot model) const {
+        assert(contains(model) and "Stale or invalid model handle");
+        return m_slots[model.index].dense_index;
+    }
+
+    void clear() {
+        m_transforms.clear();
+        m_meshes.clear();
+        m_materials.clear();
+        m_occluders.clear();
+        m_lods.clear();
+        m_slot_indices.clear();
+        m_slots.clear();
+        m_free_slots.clear();
+    }
 
-struct DynamicModel {
-    MeshID mesh;
-    MaterialID material;
-    glm::mat4 transform;
+    glm::mat4& transform(size_t i) {
+        return m_transforms[i];
+    }
+
+    const glm::mat4& transform(size_t i) const {
+        return m_transforms[i];
+    }
 
-    void create(
-        MeshID mesh_id, MaterialID material_id, const glm::mat4& t
-    ) {
-        mesh = mesh_id;
-        material = material_id;
-        transform = t;
+    MeshID mesh(size_t i) const {
+        return m_meshes[i];
     }
 
-    void destroy() {}
+    MaterialID material(size_t i) const {
+        return m_materials[i];
+    }
+
+    bool occluder(size_t i) const {
+        return m_occluders[i];
+    }
+
+    void setOccluder(size_t i, bool occluder) {
+        m_occluders[i] = occluder;
+    }
+
+    uint32_t lod(size_t i) const {
+        return m_lods[i];
+    }
+
+    void setLOD(size_t i, uint32_t lod) {
+        m_lods[i] = lod;
+    }
+
+    std::span<const glm::mat4> transforms() const {
+        return m_transforms;
+    }
+
+    std::span<const MeshID> meshes() const {
+        return m_meshes;
+    }
+
+    std::span<const MaterialID> materials() const {
+        return m_materials;
+    }
 };
 };
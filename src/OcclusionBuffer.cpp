@@ -0,0 +1,366 @@
+#include "OcclusionBuffer.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+namespace VKR {
+namespace {
+constexpr float c_lane_offsets[] = {
+    0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f,
+};
+static_assert(std::size(c_lane_offsets) >= Simd::c_width);
+static_assert(OcclusionBuffer::c_tile_width % Simd::c_width == 0);
+
+// Triangles smaller than this, in pixels, can't cover a pixel center
+// reliably and are dropped
+constexpr float c_min_area = 1.0e-4f;
+
+float horizontalMax(Simd::Float v) {
+    float lanes[Simd::c_width];
+    Simd::store(lanes, v);
+    return *std::max_element(std::begin(lanes), std::end(lanes));
+}
+}
+
+void OcclusionBuffer::create(uint32_t width, uint32_t height) {
+    m_tiles_x = std::max<uint32_t>((width + c_tile_width - 1) / c_tile_width, 1);
+    m_tiles_y = std::max<uint32_t>((height + c_tile_height - 1) / c_tile_height, 1);
+    m_width = m_tiles_x * c_tile_width;
+    m_height = m_tiles_y * c_tile_height;
+    auto tile_count = m_tiles_x * m_tiles_y;
+    m_depths.assign(tile_count * c_tile_width * c_tile_height, 1.0f);
+    m_tile_max_depths.assign(tile_count, 1.0f);
+    m_bins.resize(tile_count);
+    clear();
+}
+
+void OcclusionBuffer::clear() {
+    m_triangles.clear();
+    for (auto& bin: m_bins) {
+        bin.clear();
+    }
+}
+
+void OcclusionBuffer::addOccluder(
+    const glm::mat4& proj_model,
+    std::span<const glm::vec3> triangles
+) {
+    m_clip_vertices.resize(triangles.size());
+    for (size_t i = 0; i < triangles.size(); i++) {
+        m_clip_vertices[i] = proj_model * glm::vec4(triangles[i], 1.0f);
+    }
+
+    auto to_screen = [&](const glm::vec4& v) {
+        auto inv_w = 1.0f / v.w;
+        return glm::vec3(
+            (v.x * inv_w * 0.5f + 0.5f) * m_width,
+            (v.y * inv_w * 0.5f + 0.5f) * m_height,
+            v.z * inv_w
+        );
+    };
+
+    for (size_t i = 0; i + 2 < m_clip_vertices.size(); i += 3) {
+        const auto* v = &m_clip_vertices[i];
+        // Clipping would only add occlusion, so it is not worth the cost
+        bool behind_near = std::ranges::any_of(
+            std::span(v, 3),
+            [](const glm::vec4& p) { return p.w <= 0.0f or p.z < 0.0f; }
+        );
+        if (behind_near) {
+            continue;
+        }
+        addTriangle(to_screen(v[0]), to_screen(v[1]), to_screen(v[2]));
+    }
+}
+
+void OcclusionBuffer::addTriangle(
+    const glm::vec3& v0, glm::vec3 v1, glm::vec3 v2
+) {
+    auto area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+    if (std::abs(area) < c_min_area) {
+        return;
+    }
+    // Both faces are rasterized, so make the winding counter clockwise
+    if (area < 0.0f) {
+        std::swap(v1, v2);
+        area = -area;
+    }
+
+    // Pixel centers are at half integers
+    auto min_p = glm::min(v0, glm::min(v1, v2));
+    auto max_p = glm::max(v0, glm::max(v1, v2));
+    Triangle tri = {
+        .min_x = std::max(static_cast<int32_t>(std::ceil(min_p.x - 0.5f)), 0),
+        .min_y = std::max(static_cast<int32_t>(std::ceil(min_p.y - 0.5f)), 0),
+        .max_x = std::min(
+            static_cast<int32_t>(std::floor(max_p.x - 0.5f)),
+            static_cast<int32_t>(m_width) - 1
+        ),
+        .max_y = std::min(
+            static_cast<int32_t>(std::floor(max_p.y - 0.5f)),
+            static_cast<int32_t>(m_height) - 1
+        ),
+    };
+    if (tri.min_x > tri.max_x or tri.min_y > tri.max_y) {
+        return;
+    }
+
+    const glm::vec3* v[] = {&v0, &v1, &v2};
+    for (int e = 0; e < 3; e++) {
+        const auto& a = *v[e];
+        const auto& b = *v[(e + 1) % 3];
+        tri.edge_a[e] = a.y - b.y;
+        tri.edge_b[e] = b.x - a.x;
+        tri.edge_c[e] = -(tri.edge_a[e] * a.x + tri.edge_b[e] * a.y);
+    }
+
+    auto d1 = v1 - v0;
+    auto d2 = v2 - v0;
+    tri.depth_a = (d1.z * d2.y - d2.z * d1.y) / area;
+    tri.depth_b = (d2.z * d1.x - d1.z * d2.x) / area;
+    tri.depth_c =
+        v0.z - tri.depth_a * v0.x - tri.depth_b * v0.y +
+        0.5f * (std::abs(tri.depth_a) + std::abs(tri.depth_b));
+    tri.max_depth = max_p.z;
+
+    auto tri_idx = static_cast<uint32_t>(m_triangles.size());
+    m_triangles.push_back(tri);
+    for (auto ty = tri.min_y / c_tile_height; ty <= tri.max_y / c_tile_height; ty++) {
+        for (auto tx = tri.min_x / c_tile_width; tx <= tri.max_x / c_tile_width; tx++) {
+            m_bins[ty * m_tiles_x + tx].push_back(tri_idx);
+        }
+    }
+}
+
+void OcclusionBuffer::rasterize(ThreadPool& thread_pool) {
+    auto tile_count = m_bins.size();
+    std::atomic<size_t> next_tile = 0;
+    thread_pool.run([&](size_t) {
+        for (
+            size_t tile = next_tile++;
+            tile < tile_count;
+            tile = next_tile++
+        ) {
+            rasterizeTile(tile);
+        }
+    });
+}
+
+void OcclusionBuffer::rasterizeTile(size_t tile) {
+    constexpr auto W = Simd::c_width;
+    auto origin_x = static_cast<int32_t>(tile % m_tiles_x * c_tile_width);
+    auto origin_y = static_cast<int32_t>(tile / m_tiles_x * c_tile_height);
+    auto* depths = &m_depths[tile * c_tile_width * c_tile_height];
+    std::fill_n(depths, c_tile_width * c_tile_height, 1.0f);
+
+    auto lanes = Simd::load(c_lane_offsets);
+    auto zero = Simd::set1(0.0f);
+    for (auto t: m_bins[tile]) {
+        const auto& tri = m_triangles[t];
+        auto min_y = std::max(tri.min_y, origin_y);
+        auto max_y = std::min<int32_t>(tri.max_y, origin_y + c_tile_height - 1);
+        auto min_chunk = (std::max(tri.min_x, origin_x) - origin_x) / W;
+        auto max_chunk = (std::min<int32_t>(
+            tri.max_x, origin_x + c_tile_width - 1
+        ) - origin_x) / W;
+
+        Simd::Float edge_a[3];
+        for (int e = 0; e < 3; e++) {
+            edge_a[e] = Simd::set1(tri.edge_a[e]);
+        }
+        auto depth_a = Simd::set1(tri.depth_a);
+        auto max_depth = Simd::set1(tri.max_depth);
+
+        for (auto y = min_y; y <= max_y; y++) {
+            auto py = y + 0.5f;
+            Simd::Float row_edge[3];
+            for (int e = 0; e < 3; e++) {
+                row_edge[e] = Simd::set1(tri.edge_b[e] * py + tri.edge_c[e]);
+            }
+            auto row_depth = Simd::set1(tri.depth_b * py + tri.depth_c);
+            auto* row = depths + (y - origin_y) * c_tile_width;
+
+            for (auto c = min_chunk; c <= max_chunk; c++) {
+                auto px = Simd::add(
+                    Simd::set1(origin_x + c * W + 0.5f), lanes
+                );
+                auto covered = Simd::maskAnd(
+                    Simd::cmpge(Simd::fmadd(edge_a[0], px, row_edge[0]), zero),
+                    Simd::maskAnd(
+                        Simd::cmpge(Simd::fmadd(edge_a[1], px, row_edge[1]), zero),
+                        Simd::cmpge(Simd::fmadd(edge_a[2], px, row_edge[2]), zero)
+                    )
+                );
+                if (!Simd::movemask(covered)) {
+                    continue;
+                }
+                auto z = Simd::min(Simd::fmadd(depth_a, px, row_depth), max_depth);
+                auto* p = row + c * W;
+                auto d = Simd::load(p);
+                Simd::store(p, Simd::select(covered, Simd::min(d, z), d));
+            }
+        }
+    }
+
+    auto tile_max = Simd::set1(0.0f);
+    for (size_t i = 0; i < c_tile_width * c_tile_height; i += W) {
+        tile_max = Simd::max(tile_max, Simd::load(depths + i));
+    }
+    m_tile_max_depths[tile] = horizontalMax(tile_max);
+}
+
+bool OcclusionBuffer::testRect(
+    float min_x, float min_y, float max_x, float max_y, float depth
+) const {
+    auto x0 = std::max(static_cast<int32_t>(std::floor(min_x)), 0);
+    auto y0 = std::max(static_cast<int32_t>(std::floor(min_y)), 0);
+    auto x1 = std::min(
+        static_cast<int32_t>(std::ceil(max_x)), static_cast<int32_t>(m_width)
+    );
+    auto y1 = std::min(
+        static_cast<int32_t>(std::ceil(max_y)), static_cast<int32_t>(m_height)
+    );
+    if (x0 >= x1 or y0 >= y1) {
+        return false;
+    }
+
+    int32_t tw = c_tile_width;
+    int32_t th = c_tile_height;
+    for (auto ty = y0 / th; ty <= (y1 - 1) / th; ty++) {
+        for (auto tx = x0 / tw; tx <= (x1 - 1) / tw; tx++) {
+            auto tile = ty * m_tiles_x + tx;
+            if (m_tile_max_depths[tile] < depth) {
+                continue;
+            }
+
+            // The farthest pixel of a fully covered tile is inside the
+            // rectangle
+            auto tx0 = std::max(x0 - tx * tw, 0);
+            auto ty0 = std::max(y0 - ty * th, 0);
+            auto tx1 = std::min(x1 - tx * tw, tw);
+            auto ty1 = std::min(y1 - ty * th, th);
+            if (tx0 == 0 and ty0 == 0 and tx1 == tw and ty1 == th) {
+                return true;
+            }
+
+            const auto* depths = &m_depths[tile * tw * th];
+            for (auto y = ty0; y < ty1; y++) {
+                for (auto x = tx0; x < tx1; x++) {
+                    if (depths[y * tw + x] >= depth) {
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+size_t OcclusionBuffer::cull(
+    const glm::mat4& proj_view,
+    const SphereBoundsSoA& bounds,
+    std::vector<uint8_t>& visible,
+    ThreadPool& thread_pool
+) const {
+    constexpr auto W = Simd::c_width;
+    auto count = bounds.count;
+    assert(visible.size() >= count);
+
+    auto thread_count = thread_pool.threadCount();
+    auto block_count = (count + W - 1) / W;
+    auto thread_block_count = (block_count + thread_count - 1) / thread_count;
+    std::vector<size_t> culled(thread_count, 0);
+
+    thread_pool.run([&](size_t thread_idx) {
+        auto first = std::min(thread_idx * thread_block_count * W, count);
+        auto last = std::min(first + thread_block_count * W, count);
+
+        Simd::Float m[4][4];
+        for (int c = 0; c < 4; c++) {
+            for (int r = 0; r < 4; r++) {
+                m[c][r] = Simd::set1(proj_view[c][r]);
+            }
+        }
+        auto one = Simd::set1(1.0f);
+
+        float rect_min_x[W], rect_min_y[W], rect_max_x[W], rect_max_y[W];
+        float rect_depth[W], rect_min_w[W];
+        for (auto i = first; i < last; i += W) {
+            auto x = Simd::load(bounds.x.data() + i);
+            auto y = Simd::load(bounds.y.data() + i);
+            auto z = Simd::load(bounds.z.data() + i);
+            auto radius = Simd::load(bounds.radius.data() + i);
+
+            // Corners of the bounding box of the sphere are the clip space
+            // center plus or minus the clip space half extent of every axis
+            Simd::Float center[4], axes[3][4];
+            for (int r = 0; r < 4; r++) {
+                center[r] = Simd::fmadd(m[0][r], x,
+                    Simd::fmadd(m[1][r], y, Simd::fmadd(m[2][r], z, m[3][r])));
+                for (int a = 0; a < 3; a++) {
+                    axes[a][r] = Simd::mul(m[a][r], radius);
+                }
+            }
+
+            auto min_x = Simd::set1(std::numeric_limits<float>::max());
+            auto min_y = min_x;
+            auto min_z = min_x;
+            auto min_w = min_x;
+            auto max_x = Simd::set1(std::numeric_limits<float>::lowest());
+            auto max_y = max_x;
+            for (int corner = 0; corner < 8; corner++) {
+                Simd::Float p[4];
+                for (int r = 0; r < 4; r++) {
+                    p[r] = center[r];
+                    for (int a = 0; a < 3; a++) {
+                        p[r] = (corner >> a & 1) ?
+                            Simd::add(p[r], axes[a][r]) :
+                            Simd::sub(p[r], axes[a][r]);
+                    }
+                }
+                auto inv_w = Simd::div(one, p[3]);
+                auto nx = Simd::mul(p[0], inv_w);
+                auto ny = Simd::mul(p[1], inv_w);
+                min_x = Simd::min(min_x, nx);
+                max_x = Simd::max(max_x, nx);
+                min_y = Simd::min(min_y, ny);
+                max_y = Simd::max(max_y, ny);
+                min_z = Simd::min(min_z, Simd::mul(p[2], inv_w));
+                min_w = Simd::min(min_w, p[3]);
+            }
+            Simd::store(rect_min_x, min_x);
+            Simd::store(rect_min_y, min_y);
+            Simd::store(rect_max_x, max_x);
+            Simd::store(rect_max_y, max_y);
+            Simd::store(rect_depth, min_z);
+            Simd::store(rect_min_w, min_w);
+
+            for (size_t l = 0; l < W and i + l < last; l++) {
+                // Boxes reaching behind the camera don't project to a
+                // rectangle
+                if (!visible[i + l] or rect_min_w[l] <= 0.0f) {
+                    continue;
+                }
+                auto to_x = [&](float ndc) { return (ndc * 0.5f + 0.5f) * m_width; };
+                auto to_y = [&](float ndc) { return (ndc * 0.5f + 0.5f) * m_height; };
+                bool hit = testRect(
+                    to_x(rect_min_x[l]), to_y(rect_min_y[l]),
+                    to_x(rect_max_x[l]), to_y(rect_max_y[l]),
+                    rect_depth[l]
+                );
+                if (!hit) {
+                    visible[i + l] = 0;
+                    culled[thread_idx]++;
+                }
+            }
+        }
+    });
+
+    return std::accumulate(culled.begin(), culled.end(), size_t(0));
+}
+}
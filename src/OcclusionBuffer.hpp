@@ -0,0 +1,88 @@
+#pragma once
+#include "Culling.hpp"
+#include "ThreadPool.hpp"
+
+#include <glm/mat4x4.hpp>
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace VKR {
+// Low resolution software depth buffer of occluders, in the spirit of
+// masked occlusion culling. Triangles are binned to the tiles they overlap
+// and every tile is rasterized by one thread with SIMD edge functions.
+// A covered pixel stores the farthest depth of the triangle within it, so
+// tests against the buffer never reject a visible model.
+class OcclusionBuffer {
+public:
+    static constexpr uint32_t c_tile_width = 32;
+    static constexpr uint32_t c_tile_height = 8;
+
+private:
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    uint32_t m_tiles_x = 0;
+    uint32_t m_tiles_y = 0;
+    // Tile after tile, rows of a tile are contiguous
+    std::vector<float> m_depths;
+    // Farthest depth of every tile
+    std::vector<float> m_tile_max_depths;
+
+    struct Triangle {
+        // Edge functions a * x + b * y + c, non-negative inside
+        float edge_a[3];
+        float edge_b[3];
+        float edge_c[3];
+        // Depth plane, offset to the farthest depth within a pixel
+        float depth_a;
+        float depth_b;
+        float depth_c;
+        float max_depth;
+        // Covered pixels, inclusive
+        int32_t min_x;
+        int32_t min_y;
+        int32_t max_x;
+        int32_t max_y;
+    };
+    std::vector<Triangle> m_triangles;
+    // Triangles overlapping every tile
+    std::vector<std::vector<uint32_t>> m_bins;
+    std::vector<glm::vec4> m_clip_vertices;
+
+public:
+    // The size is rounded up to whole tiles
+    void create(uint32_t width, uint32_t height);
+
+    // Removes all occluders
+    void clear();
+
+    // Bins a triangle list transformed by proj_model. Triangles that cross
+    // the near plane are dropped.
+    void addOccluder(
+        const glm::mat4& proj_model,
+        std::span<const glm::vec3> triangles
+    );
+
+    // Rasterizes the binned triangles into the depth buffer
+    void rasterize(ThreadPool& thread_pool);
+
+    // Writes 0 for visible spheres that are hidden behind occluders.
+    // Returns the number of rejected spheres.
+    size_t cull(
+        const glm::mat4& proj_view,
+        const SphereBoundsSoA& bounds,
+        std::vector<uint8_t>& visible,
+        ThreadPool& thread_pool
+    ) const;
+
+    // Whether any pixel of the rectangle, in pixels, is farther than depth
+    bool testRect(
+        float min_x, float min_y, float max_x, float max_y, float depth
+    ) const;
+
+private:
+    void addTriangle(const glm::vec3& v0, glm::vec3 v1, glm::vec3 v2);
+    void rasterizeTile(size_t tile);
+};
+}
@@ -0,0 +1,207 @@
+#include "OffsetAllocator.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+
+namespace VKR {
+namespace {
+constexpr uint32_t c_none = OffsetAllocator::c_no_space;
+constexpr uint32_t c_sub_bin_bits = 3;
+constexpr uint32_t c_sub_bin_count = 1 << c_sub_bin_bits;
+
+// Sizes below c_sub_bin_count get a bin each, larger ones are split into
+// c_sub_bin_count bins per power of two. Bins contain sizes of at least
+// binSize(bin).
+uint32_t binOf(uint32_t size) {
+    if (size < c_sub_bin_count) {
+        return size;
+    }
+    uint32_t log = std::bit_width(size) - 1;
+    uint32_t sub = (size >> (log - c_sub_bin_bits)) & (c_sub_bin_count - 1);
+    return (log - c_sub_bin_bits + 1) * c_sub_bin_count + sub;
+}
+
+uint32_t binSize(uint32_t bin) {
+    if (bin < c_sub_bin_count) {
+        return bin;
+    }
+    uint32_t log = bin / c_sub_bin_count + c_sub_bin_bits - 1;
+    uint32_t sub = bin % c_sub_bin_count;
+    return (c_sub_bin_count + sub) << (log - c_sub_bin_bits);
+}
+}
+
+void OffsetAllocator::create(uint32_t size) {
+    assert(size > 0);
+    m_size = size;
+    m_free_size = 0;
+    m_free_range_count = 0;
+    m_nodes.clear();
+    m_unused_nodes.clear();
+    m_bins.fill(c_none);
+    m_bin_masks.fill(0);
+    insertFree(newNode(0, size, c_none, c_none));
+}
+
+OffsetAllocator::Allocation OffsetAllocator::allocate(uint32_t size) {
+    assert(size > 0);
+    // Round up to the first bin whose ranges are all large enough
+    auto bin = binOf(size);
+    auto node = c_none;
+    auto fit = findBin(binSize(bin) < size ? bin + 1 : bin);
+    if (fit != c_none) {
+        node = m_bins[fit];
+    } else {
+        // Ranges in the size's own bin may still fit, like the whole
+        // resource when it isn't a bin size
+        for (auto n = m_bins[bin]; n != c_none; n = m_nodes[n].next_free) {
+            if (m_nodes[n].size >= size) {
+                node = n;
+                break;
+            }
+        }
+    }
+    if (node == c_none) {
+        return {};
+    }
+
+    removeFree(node);
+    m_nodes[node].used = true;
+    auto remainder = m_nodes[node].size - size;
+    if (remainder) {
+        m_nodes[node].size = size;
+        auto next = m_nodes[node].next;
+        auto rest = newNode(m_nodes[node].offset + size, remainder, node, next);
+        if (next != c_none) {
+            m_nodes[next].prev = rest;
+        }
+        m_nodes[node].next = rest;
+        insertFree(rest);
+    }
+
+    return {
+        .offset = m_nodes[node].offset,
+        .node = node,
+    };
+}
+
+void OffsetAllocator::free(Allocation allocation) {
+    auto node = allocation.node;
+    assert(node < m_nodes.size() and m_nodes[node].used);
+    m_nodes[node].used = false;
+
+    // Appends the range that follows first to it
+    auto merge = [&](uint32_t first, uint32_t second) {
+        m_nodes[first].size += m_nodes[second].size;
+        auto next = m_nodes[second].next;
+        m_nodes[first].next = next;
+        if (next != c_none) {
+            m_nodes[next].prev = first;
+        }
+        m_unused_nodes.push_back(second);
+    };
+
+    auto next = m_nodes[node].next;
+    if (next != c_none and !m_nodes[next].used) {
+        removeFree(next);
+        merge(node, next);
+    }
+    auto prev = m_nodes[node].prev;
+    if (prev != c_none and !m_nodes[prev].used) {
+        removeFree(prev);
+        merge(prev, node);
+        node = prev;
+    }
+    insertFree(node);
+}
+
+OffsetAllocator::Stats OffsetAllocator::stats() const {
+    Stats stats = {
+        .free_size = m_free_size,
+        .free_range_count = m_free_range_count,
+    };
+    for (uint32_t w = m_bin_masks.size(); w-- > 0;) {
+        if (m_bin_masks[w]) {
+            auto bin = 64 * w + std::bit_width(m_bin_masks[w]) - 1;
+            for (auto n = m_bins[bin]; n != c_none; n = m_nodes[n].next_free) {
+                stats.largest_free_range = std::max(
+                    stats.largest_free_range, m_nodes[n].size
+                );
+            }
+            break;
+        }
+    }
+    return stats;
+}
+
+uint32_t OffsetAllocator::newNode(
+    uint32_t offset, uint32_t size, uint32_t prev, uint32_t next
+) {
+    Node node = {
+        .offset = offset,
+        .size = size,
+        .prev = prev,
+        .next = next,
+        .prev_free = c_none,
+        .next_free = c_none,
+        .used = false,
+    };
+    if (m_unused_nodes.empty()) {
+        m_nodes.push_back(node);
+        return m_nodes.size() - 1;
+    }
+    auto i = m_unused_nodes.back();
+    m_unused_nodes.pop_back();
+    m_nodes[i] = node;
+    return i;
+}
+
+void OffsetAllocator::insertFree(uint32_t node) {
+    auto& n = m_nodes[node];
+    auto bin = binOf(n.size);
+    n.prev_free = c_none;
+    n.next_free = m_bins[bin];
+    if (n.next_free != c_none) {
+        m_nodes[n.next_free].prev_free = node;
+    }
+    m_bins[bin] = node;
+    m_bin_masks[bin / 64] |= uint64_t(1) << (bin % 64);
+    m_free_size += n.size;
+    m_free_range_count++;
+}
+
+void OffsetAllocator::removeFree(uint32_t node) {
+    const auto& n = m_nodes[node];
+    auto bin = binOf(n.size);
+    if (n.prev_free != c_none) {
+        m_nodes[n.prev_free].next_free = n.next_free;
+    } else {
+        m_bins[bin] = n.next_free;
+        if (n.next_free == c_none) {
+            m_bin_masks[bin / 64] &= ~(uint64_t(1) << (bin % 64));
+        }
+    }
+    if (n.next_free != c_none) {
+        m_nodes[n.next_free].prev_free = n.prev_free;
+    }
+    m_free_size -= n.size;
+    m_free_range_count--;
+}
+
+// Returns the first non-empty bin starting from first_bin, or c_none
+uint32_t OffsetAllocator::findBin(uint32_t first_bin) const {
+    if (first_bin >= c_bin_count) {
+        return c_none;
+    }
+    auto w = first_bin / 64;
+    auto mask = m_bin_masks[w] & (~uint64_t(0) << (first_bin % 64));
+    while (!mask) {
+        if (++w == m_bin_masks.size()) {
+            return c_none;
+        }
+        mask = m_bin_masks[w];
+    }
+    return 64 * w + std::countr_zero(mask);
+}
+}
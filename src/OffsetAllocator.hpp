@@ -0,0 +1,71 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace VKR {
+// Two level segregated fit allocator of ranges of a linear resource, like
+// the vertices of a shared buffer. Free ranges are binned by size, with
+// eight bins per power of two, and the first bin that fits is found with a
+// bitmap scan. Freed ranges are merged with free neighbours.
+class OffsetAllocator {
+public:
+    static constexpr uint32_t c_no_space = UINT32_MAX;
+
+    struct Allocation {
+        uint32_t offset = c_no_space;
+        uint32_t node = c_no_space;
+    };
+
+    struct Stats {
+        uint32_t free_size = 0;
+        uint32_t free_range_count = 0;
+        uint32_t largest_free_range = 0;
+    };
+
+private:
+    static constexpr uint32_t c_bin_count = 240;
+
+    struct Node {
+        uint32_t offset;
+        uint32_t size;
+        // Neighbouring ranges in the resource
+        uint32_t prev;
+        uint32_t next;
+        // Neighbouring free ranges in the same bin
+        uint32_t prev_free;
+        uint32_t next_free;
+        bool used;
+    };
+
+    uint32_t m_size = 0;
+    uint32_t m_free_size = 0;
+    uint32_t m_free_range_count = 0;
+    std::vector<Node> m_nodes;
+    std::vector<uint32_t> m_unused_nodes;
+    std::array<uint32_t, c_bin_count> m_bins;
+    std::array<uint64_t, (c_bin_count + 63) / 64> m_bin_masks;
+
+public:
+    void create(uint32_t size);
+
+    // Returns an allocation with an offset of c_no_space if no free range
+    // is large enough
+    Allocation allocate(uint32_t size);
+    void free(Allocation allocation);
+
+    uint32_t size() const {
+        return m_size;
+    }
+
+    Stats stats() const;
+
+private:
+    uint32_t newNode(
+        uint32_t offset, uint32_t size, uint32_t prev, uint32_t next
+    );
+    void insertFree(uint32_t node);
+    void removeFree(uint32_t node);
+    uint32_t findBin(uint32_t first_bin) const;
+};
+}
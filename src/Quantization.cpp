@@ -0,0 +1,95 @@
+#include "Quantization.hpp"
+#include "Simd.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+
+namespace VKR {
+namespace {
+constexpr float c_snorm16_max = 32767.0f;
+}
+
+glm::mat4 PositionQuantization::dequantization() const {
+    glm::mat4 m(scale);
+    m[3] = glm::vec4(offset, 1.0f);
+    return m;
+}
+
+PositionQuantization quantizePositions(
+    std::span<const glm::vec3> positions, const MeshBounds& bounds,
+    std::span<QuantizedPosition> quantized
+) {
+    assert(quantized.size() == positions.size());
+    PositionQuantization q = {
+        .offset = (bounds.aabb_min + bounds.aabb_max) * 0.5f,
+    };
+    auto extent = (bounds.aabb_max - bounds.aabb_min) * 0.5f;
+    auto half_extent = std::max({extent.x, extent.y, extent.z});
+    if (half_extent > 0.0f) {
+        q.scale = half_extent;
+    }
+
+    // Positions are loaded a component at a time, so that every lane
+    // holds one vertex. Quantized values are clamped, since rounding the
+    // scale may push the extremes just past 1.
+    static_assert(sizeof(glm::vec3) == 3 * sizeof(float));
+    auto data = reinterpret_cast<const float*>(positions.data());
+    auto to_snorm = c_snorm16_max / q.scale;
+    auto to_mesh = q.scale / c_snorm16_max;
+    constexpr auto W = Simd::c_width;
+    auto vlimit = Simd::set1(c_snorm16_max);
+    auto vneg_limit = Simd::set1(-c_snorm16_max);
+    auto vto_snorm = Simd::set1(to_snorm);
+    auto vto_mesh = Simd::set1(to_mesh);
+    Simd::Float voffset[3] = {
+        Simd::set1(q.offset.x), Simd::set1(q.offset.y), Simd::set1(q.offset.z),
+    };
+    auto verror2 = Simd::set1(0.0f);
+    size_t i = 0;
+    for (; i + W <= positions.size(); i += W) {
+        std::array<std::array<float, W>, 3> lanes;
+        auto distance2 = Simd::set1(0.0f);
+        for (size_t c = 0; c < 3; c++) {
+            auto p = Simd::gather(data + 3 * i + c, 3);
+            auto s = Simd::mul(Simd::sub(p, voffset[c]), vto_snorm);
+            s = Simd::round(Simd::min(Simd::max(s, vneg_limit), vlimit));
+            auto d = Simd::sub(Simd::fmadd(s, vto_mesh, voffset[c]), p);
+            distance2 = Simd::fmadd(d, d, distance2);
+            Simd::store(lanes[c].data(), s);
+        }
+        verror2 = Simd::max(verror2, distance2);
+        for (size_t k = 0; k < W; k++) {
+            quantized[i + k] = {
+                static_cast<int16_t>(lanes[0][k]),
+                static_cast<int16_t>(lanes[1][k]),
+                static_cast<int16_t>(lanes[2][k]),
+                0,
+            };
+        }
+    }
+
+    std::array<float, W> error2_lanes;
+    Simd::store(error2_lanes.data(), verror2);
+    auto error2 = *std::ranges::max_element(error2_lanes);
+    for (; i < positions.size(); i++) {
+        const auto& p = positions[i];
+        int16_t s[3];
+        float distance2 = 0.0f;
+        for (size_t c = 0; c < 3; c++) {
+            auto v = std::nearbyint(std::clamp(
+                (p[c] - q.offset[c]) * to_snorm, -c_snorm16_max, c_snorm16_max
+            ));
+            auto d = v * to_mesh + q.offset[c] - p[c];
+            distance2 += d * d;
+            s[c] = static_cast<int16_t>(v);
+        }
+        error2 = std::max(error2, distance2);
+        quantized[i] = {s[0], s[1], s[2], 0};
+    }
+    q.error = std::sqrt(error2);
+
+    return q;
+}
+}
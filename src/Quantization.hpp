@@ -0,0 +1,45 @@
+#pragma once
+#include "Bounds.hpp"
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include <cstdint>
+#include <span>
+
+namespace VKR {
+// Position in R16G16B16A16_SNORM, w is unused
+struct QuantizedPosition {
+    int16_t x, y, z, w;
+};
+
+// Positions are stored relative to the center of their bounding box, and
+// divided by the largest half extent. The scale is the same on every axis,
+// so that bounding spheres and normal cones stay spheres and cones in
+// quantized space.
+struct PositionQuantization {
+    glm::vec3 offset = {};
+    float scale = 1.0f;
+    // Largest distance between a position and its dequantized position
+    float error = 0.0f;
+
+    // Maps quantized positions to the space of the input positions
+    glm::mat4 dequantization() const;
+
+    glm::vec3 quantize(const glm::vec3& p) const {
+        return (p - offset) / scale;
+    }
+
+    // Center in xyz, radius in w
+    glm::vec4 quantizeSphere(const glm::vec4& sphere) const {
+        return {quantize(glm::vec3(sphere)), sphere.w / scale};
+    }
+};
+
+// bounds must be those of positions
+PositionQuantization quantizePositions(
+    std::span<const glm::vec3> positions, const MeshBounds& bounds,
+    std::span<QuantizedPosition> quantized
+);
+}
@@ -5,9 +5,12 @@ namespace VKR {
 struct QueueFamilies {
     static constexpr uint32_t NotFound = -1;
     uint32_t graphics = NotFound;
+    // Family without graphics, used for uploads. NotFound if there is none.
+    uint32_t transfer = NotFound;
 };
 
 struct Queues {
     VkQueue graphics = VK_NULL_HANDLE;
+    VkQueue transfer = VK_NULL_HANDLE;
 };
 }
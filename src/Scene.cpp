@@ -6,8 +6,49 @@
 
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <chrono>
+
 namespace VKR {
 namespace {
+// Calls f(format, first, count) for every run of consecutive elements with
+// the same storage format, so that dispatch happens once per run instead
+// of once per element
+template<typename GetFormat, typename F>
+void forEachStorageFormatRun(size_t count, GetFormat get_format, F f) {
+    size_t first = 0;
+    while (first < count) {
+        auto storage_format = get_format(first);
+        auto last = first + 1;
+        while (last < count and get_format(last) == storage_format) {
+            last++;
+        }
+        f(storage_format, first, last - first);
+        first = last;
+    }
+}
+
+void copyTransform(glm::mat4& dst, const glm::mat4& src) {
+    Simd::copy(&dst[0][0], &src[0][0], 16);
+}
+
+// Screen space error, in pixels, below which a coarser level of detail
+// is used
+constexpr float c_lod_pixel_error = 1.0f;
+
+// Occluders only need to be rasterized coarsely
+constexpr uint32_t c_occlusion_buffer_width = 256;
+
+// Smaller meshes are cheaper to cull as a whole
+constexpr size_t c_min_cluster_culled_triangles = 1 << 15;
+
+constexpr size_t c_default_upload_ring_size = 64 << 20;
+
+float getElapsedMs(std::chrono::steady_clock::time_point start) {
+    std::chrono::duration<float, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
 VmaAllocator createAllocator(
     VkInstance instance,
     VkPhysicalDevice physical_device, VkDevice device
@@ -59,34 +100,63 @@ VkFormat selectColorFormat(
 
 VkFormat selectDepthFormat(
     VkPhysicalDevice device,
-    std::span<const VkFormat> formats
+    std::span<const VkFormat> formats,
+    VkFormatFeatureFlags extra_features = 0
 ) {
     return selectFormat(
         device, formats,
-        VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT
+        VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | extra_features
     );
 }
 
+// With occlusion culling a frame is drawn in two render passes. The early
+// pass leaves depth readable by the depth pyramid build, and the late pass
+// continues drawing into both attachments. All passes are compatible, so
+// they share framebuffers and secondary command buffers.
+//
+// With a depth pre-pass every render pass has two subpasses. The first one
+// only writes depth, and the second one shades with an equal depth test.
+enum class RenderPassUse {
+    Single,
+    Early,
+    Late,
+};
+
 VkRenderPass createRenderPass(
     VkDevice device,
-    VkFormat color_format, VkFormat depth_format
+    VkFormat color_format, VkFormat depth_format,
+    RenderPassUse use, bool depth_prepass
 ) {
+    using enum RenderPassUse;
+    bool early = use == Early;
+    bool late = use == Late;
+    uint32_t shading_subpass = depth_prepass ? 1 : 0;
+
     VkAttachmentDescription color_attachment = {
         .format = color_format,
         .samples = VK_SAMPLE_COUNT_1_BIT,
-        .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+        .loadOp = late ?
+            VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR,
         .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-        .finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        .initialLayout = late ?
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED,
+        .finalLayout = early ?
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL :
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
     };
 
     VkAttachmentDescription depth_attachment = {
         .format = depth_format,
         .samples = VK_SAMPLE_COUNT_1_BIT,
-        .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-        .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-        .finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+        .loadOp = late ?
+            VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR,
+        .storeOp = early ?
+            VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        .initialLayout = late ?
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED,
+        .finalLayout = early ?
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL :
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
     };
 
     std::array attachments = {
@@ -104,21 +174,40 @@ VkRenderPass createRenderPass(
         .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
     };
 
-    VkSubpassDescription subpass = {
+    VkSubpassDescription depth_subpass = {
+        .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+        .pDepthStencilAttachment = &depth_reference,
+    };
+
+    VkSubpassDescription color_subpass = {
         .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
         .colorAttachmentCount = 1,
         .pColorAttachments = &color_reference,
         .pDepthStencilAttachment = &depth_reference,
     };
 
+    std::array subpasses = {
+        depth_subpass,
+        color_subpass,
+    };
+    auto used_subpasses =
+        std::span(subpasses).last(depth_prepass ? 2 : 1);
+
     VkSubpassDependency in_dep_color = {
         .srcSubpass = VK_SUBPASS_EXTERNAL,
-        .dstSubpass = 0,
+        .dstSubpass = shading_subpass,
         .srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT,
         .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
         .srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
         .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
     };
+    if (late) {
+        in_dep_color.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        in_dep_color.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        in_dep_color.dstAccessMask =
+            VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    }
 
     VkSubpassDependency in_dep_depth = {
         .srcSubpass = VK_SUBPASS_EXTERNAL,
@@ -128,28 +217,65 @@ VkRenderPass createRenderPass(
         .srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
         .dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
     };
+    if (late) {
+        // The depth pyramid build reads depth before it is written again
+        in_dep_depth.srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        in_dep_depth.dstStageMask =
+            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+            VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        in_dep_depth.srcAccessMask = 0;
+        in_dep_depth.dstAccessMask =
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    }
 
-    VkSubpassDependency out_dep_color = {
+    // Shading tests against the depth written by the pre-pass
+    VkSubpassDependency prepass_dep = {
         .srcSubpass = 0,
+        .dstSubpass = 1,
+        .srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+        .dstStageMask =
+            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+            VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+        .srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+        .dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT,
+    };
+
+    VkSubpassDependency out_dep_color = {
+        .srcSubpass = shading_subpass,
         .dstSubpass = VK_SUBPASS_EXTERNAL,
         .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
         .dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT,
         .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
         .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
     };
+    if (early) {
+        // The late pass continues drawing, and its own dependency orders
+        // the color writes
+        out_dep_color = {
+            .srcSubpass = shading_subpass,
+            .dstSubpass = VK_SUBPASS_EXTERNAL,
+            .srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            .srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+        };
+    }
 
     std::array deps = {
-        in_dep_color, in_dep_depth, out_dep_color
+        in_dep_color, in_dep_depth, out_dep_color, prepass_dep,
     };
+    auto used_deps = std::span(deps).first(depth_prepass ? 4 : 3);
 
     VkRenderPassCreateInfo render_pass_create_info = {
         .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
         .attachmentCount = attachments.size(),
         .pAttachments = attachments.data(),
-        .subpassCount = 1,
-        .pSubpasses = &subpass,
-        .dependencyCount = deps.size(),
-        .pDependencies = deps.data(),
+        .subpassCount = static_cast<uint32_t>(used_subpasses.size()),
+        .pSubpasses = used_subpasses.data(),
+        .dependencyCount = static_cast<uint32_t>(used_deps.size()),
+        .pDependencies = used_deps.data(),
     };
     
     VkRenderPass render_pass;
@@ -212,15 +338,98 @@ auto createTransientCommandPool(
     return createCommandPool(device, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, queue_family);
 }
 
+VkDescriptorSetLayout createFrameSetLayout(VkDevice device) {
+    std::array bindings = {
+        VkDescriptorSetLayoutBinding {
+            .binding = c_frame_uniforms_binding,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+        },
+        VkDescriptorSetLayoutBinding {
+            .binding = c_frame_transforms_binding,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+        },
+    };
+    VkDescriptorSetLayoutCreateInfo create_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = bindings.size(),
+        .pBindings = bindings.data(),
+    };
+    VkDescriptorSetLayout layout;
+    vkCreateDescriptorSetLayout(device, &create_info, nullptr, &layout);
+    return layout;
+}
+
+VkDescriptorPool createFrameDescriptorPool(VkDevice device, uint32_t set_count) {
+    std::array pool_sizes = {
+        VkDescriptorPoolSize {
+            .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .descriptorCount = set_count,
+        },
+        VkDescriptorPoolSize {
+            .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = set_count,
+        },
+    };
+    VkDescriptorPoolCreateInfo create_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .maxSets = set_count,
+        .poolSizeCount = pool_sizes.size(),
+        .pPoolSizes = pool_sizes.data(),
+    };
+    VkDescriptorPool pool;
+    vkCreateDescriptorPool(device, &create_info, nullptr, &pool);
+    return pool;
+}
+
+void writeFrameSet(
+    VkDevice device, VkDescriptorSet set,
+    VkBuffer uniforms, VkBuffer transforms
+) {
+    VkDescriptorBufferInfo uniforms_info = {
+        .buffer = uniforms,
+        .offset = 0,
+        .range = sizeof(FrameUniforms),
+    };
+    VkDescriptorBufferInfo transforms_info = {
+        .buffer = transforms,
+        .offset = 0,
+        .range = VK_WHOLE_SIZE,
+    };
+    std::array writes = {
+        VkWriteDescriptorSet {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = set,
+            .dstBinding = c_frame_uniforms_binding,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .pBufferInfo = &uniforms_info,
+        },
+        VkWriteDescriptorSet {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = set,
+            .dstBinding = c_frame_transforms_binding,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .pBufferInfo = &transforms_info,
+        },
+    };
+    vkUpdateDescriptorSets(device, writes.size(), writes.data(), 0, nullptr);
+}
+
 void allocateCommandBuffers(
     VkDevice device,
     VkCommandPool cmd_pool,
+    VkCommandBufferLevel level,
     std::span<VkCommandBuffer> cmd_buffers
 ) {
     VkCommandBufferAllocateInfo alloc_info = {
         .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
         .commandPool = cmd_pool,
-        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .level = level,
         .commandBufferCount = static_cast<uint32_t>(cmd_buffers.size()),
     };
     vkAllocateCommandBuffers(device, &alloc_info, cmd_buffers.data());
@@ -230,14 +439,16 @@ void allocateCommandBuffers(
 SceneImpl::SceneImpl(
     const Camera& cam,
     const Device& dev,
-    uint32_t width, uint32_t height
+    uint32_t width, uint32_t height,
+    const SceneCreationFeatures& conf
 ):  m_instance(dev.getInstance()),
     m_physical_device(dev.getPhysicalDevice()),
     m_queue_families(dev.getQueueFamilies()),
     m_device(dev.getDevice()),
     m_queues(dev.getQueues()),
     m_width(width), 
-    m_height(height)
+    m_height(height),
+    m_features(conf)
 {   
     m_camera = cam;
     create();
@@ -249,11 +460,28 @@ void SceneImpl::create() {
         m_physical_device, m_device
     );
 
+    m_geometry_pools.create(m_allocator);
+    m_position_quantization = {
+        .enabled = m_features.quantized_positions,
+        .max_error = m_features.max_position_quantization_error,
+    };
+    m_uploader.create(
+        m_device, m_allocator, m_queue_families, m_queues,
+        m_features.upload_ring_size ?
+            m_features.upload_ring_size : c_default_upload_ring_size
+    );
+
     auto color_fmt =
         selectColorFormat(m_physical_device, color_fmts);
     assert(color_fmt != VK_FORMAT_UNDEFINED);
-    auto depth_fmt =
-        selectDepthFormat(m_physical_device, depth_fmts);
+    assert(!m_features.occlusion_culling or m_features.gpu_culling);
+    assert(!m_features.cluster_culling or m_features.gpu_culling);
+    assert(!m_features.triangle_culling or m_features.cluster_culling);
+    auto depth_fmt = selectDepthFormat(
+        m_physical_device, depth_fmts,
+        m_features.occlusion_culling ?
+            VkFormatFeatureFlags(VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) : 0
+    );
     assert(depth_fmt != VK_FORMAT_UNDEFINED);
 
     for (size_t i = 0; i < c_img_cnt; i++) {
@@ -262,12 +490,29 @@ void SceneImpl::create() {
         m_color_views[i] =
             createColorImageView(m_device, m_color_imgs[i].image, color_fmt);
     }
-    m_depth_img =
-        createDepthImage(m_allocator, depth_fmt, m_width, m_height);
+    m_depth_img = createDepthImage(
+        m_allocator, depth_fmt, m_width, m_height,
+        m_features.occlusion_culling ?
+            VkImageUsageFlags(VK_IMAGE_USAGE_SAMPLED_BIT) : 0
+    );
     m_depth_view =
         createDepthImageView(m_device, m_depth_img.image, depth_fmt);
 
-    m_render_pass = createRenderPass(m_device, color_fmt, depth_fmt);
+    if (m_features.occlusion_culling) {
+        m_early_render_pass = createRenderPass(
+            m_device, color_fmt, depth_fmt, RenderPassUse::Early,
+            m_features.depth_prepass
+        );
+        m_render_pass = createRenderPass(
+            m_device, color_fmt, depth_fmt, RenderPassUse::Late,
+            m_features.depth_prepass
+        );
+    } else {
+        m_render_pass = createRenderPass(
+            m_device, color_fmt, depth_fmt, RenderPassUse::Single,
+            m_features.depth_prepass
+        );
+    }
 
     for (size_t i = 0; i < c_img_cnt; i++) {
         m_fbs[i] = createFramebuffer(
@@ -283,7 +528,74 @@ void SceneImpl::create() {
     m_transient_cmd_pool =
         createTransientCommandPool(m_device, m_queue_families.graphics);
 
-    allocateCommandBuffers(m_device, m_cmd_pool, m_cmd_bufs);
+    allocateCommandBuffers(
+        m_device, m_cmd_pool,
+        VK_COMMAND_BUFFER_LEVEL_PRIMARY, m_cmd_bufs
+    );
+
+    auto thread_count = std::max<size_t>(m_features.recording_thread_count, 1);
+    m_recording_threads.resize(thread_count);
+    for (auto& thread: m_recording_threads) {
+        for (size_t i = 0; i < c_img_cnt; i++) {
+            thread.cmd_pools[i] = createTransientCommandPool(
+                m_device, m_queue_families.graphics
+            );
+            std::array<VkCommandBuffer, 2> cmd_buffers;
+            allocateCommandBuffers(
+                m_device, thread.cmd_pools[i],
+                VK_COMMAND_BUFFER_LEVEL_SECONDARY, cmd_buffers
+            );
+            thread.cmd_bufs[i] = cmd_buffers[0];
+            thread.depth_cmd_bufs[i] = cmd_buffers[1];
+        }
+    }
+    m_thread_pool.create(thread_count);
+
+    for (auto& cache: m_static_caches) {
+        cache.cmd_pool = createCommandPool(
+            m_device, 0, m_queue_families.graphics
+        );
+        std::array<VkCommandBuffer, 4> cmd_buffers;
+        allocateCommandBuffers(
+            m_device, cache.cmd_pool,
+            VK_COMMAND_BUFFER_LEVEL_SECONDARY, cmd_buffers
+        );
+        cache.cmd_buffer = cmd_buffers[0];
+        cache.late_cmd_buffer = cmd_buffers[1];
+        cache.depth_cmd_buffer = cmd_buffers[2];
+        cache.late_depth_cmd_buffer = cmd_buffers[3];
+    }
+
+    m_frame_set_layout = createFrameSetLayout(m_device);
+    m_frame_descriptor_pool =
+        createFrameDescriptorPool(m_device, 2 * c_img_cnt);
+    {
+        std::array<VkDescriptorSetLayout, 2 * c_img_cnt> set_layouts;
+        set_layouts.fill(m_frame_set_layout);
+        std::array<VkDescriptorSet, 2 * c_img_cnt> sets;
+        VkDescriptorSetAllocateInfo alloc_info = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .descriptorPool = m_frame_descriptor_pool,
+            .descriptorSetCount = sets.size(),
+            .pSetLayouts = set_layouts.data(),
+        };
+        vkAllocateDescriptorSets(m_device, &alloc_info, sets.data());
+        std::ranges::copy(
+            std::span(sets).first(c_img_cnt), m_frame_sets.begin()
+        );
+        std::ranges::copy(
+            std::span(sets).last(c_img_cnt), m_gpu_culled_frame_sets.begin()
+        );
+    }
+    for (size_t i = 0; i < c_img_cnt; i++) {
+        m_frame_uniform_bufs[i] =
+            createUniformBuffer(m_allocator, sizeof(FrameUniforms));
+        m_transform_bufs[i].reserve(m_allocator, 1);
+        writeFrameSet(
+            m_device, m_frame_sets[i],
+            m_frame_uniform_bufs[i].buffer, m_transform_bufs[i].buffer.buffer
+        );
+    }
     
     for (auto& sem: m_dst_sems) {
         sem = createSemaphore(m_device);
@@ -291,35 +603,97 @@ void SceneImpl::create() {
     for (auto& fence: m_fences) {
         fence = createSignaledFence(m_device);
     }
+
+    if (m_features.gpu_culling) {
+        m_gpu_culling.create(
+            m_device, m_allocator, c_img_cnt, m_features.occlusion_culling
+        );
+    }
+    if (m_features.cluster_culling) {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(m_physical_device, &properties);
+        const auto& limits = properties.limits;
+        m_cluster_culling.create(
+            m_device, m_allocator, c_img_cnt, m_features.triangle_culling,
+            limits.timestampComputeAndGraphics ? limits.timestampPeriod : 0.0f
+        );
+    }
+    if (m_features.cpu_occlusion_culling) {
+        m_occlusion_buffer.create(
+            c_occlusion_buffer_width,
+            c_occlusion_buffer_width * m_height / m_width
+        );
+    }
+    if (m_features.occlusion_culling) {
+        m_depth_pyramid.create(
+            m_device, m_allocator, m_depth_view, m_width, m_height
+        );
+        m_gpu_culling.setDepthPyramid(
+            m_depth_pyramid.view(), m_depth_pyramid.sampler()
+        );
+    }
+    if (m_features.depth_prepass) {
+        // Counting samples across secondary command buffers needs
+        // inherited queries
+        VkPhysicalDeviceFeatures features;
+        vkGetPhysicalDeviceFeatures(m_physical_device, &features);
+        if (features.occlusionQueryPrecise and features.inheritedQueries) {
+            VkQueryPoolCreateInfo create_info = {
+                .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+                .queryType = VK_QUERY_TYPE_OCCLUSION,
+                .queryCount = c_sample_queries * c_img_cnt,
+            };
+            vkCreateQueryPool(
+                m_device, &create_info, nullptr, &m_sample_query_pool
+            );
+        }
+    }
 }
 
 void SceneImpl::destroy() {
     if (m_device) {
-        vkDeviceWaitIdle(m_device);
+        m_lod_jobs.destroy();
+        m_pending_lods.clear();
 
-        for (auto& model: m_static_models) {
-            model.destroy();
+        vkDeviceWaitIdle(m_device);
+        m_uploader.destroy();
+        for (auto& meshes: m_retired_meshes) {
+            meshes.clear();
         }
+
         m_static_models.clear();
-        for (auto& model: m_dynamic_models) {
-            model.destroy();
-        }
+        m_unacquired_meshes.clear();
         m_dynamic_models.clear();
+        m_hierarchy.clear();
 
         for (auto& mat: m_mats) {
             mat.destroy(m_device);
         }
         m_mats.clear();
 
-        for (auto& mesh: m_static_meshes) {
-            mesh.destroy(m_allocator);
-        }
         m_static_meshes.clear();
+        m_geometry_pools.destroy();
         for (auto& mesh: m_dynamic_meshes) {
             mesh.destroy(m_allocator);
         }
         m_dynamic_meshes.clear();
 
+        for (auto& buf: m_transform_bufs) {
+            buf.destroy(m_allocator);
+        }
+        for (auto& cache: m_static_caches) {
+            vkDestroyCommandPool(m_device, cache.cmd_pool, nullptr);
+        }
+        for (auto& buf: m_frame_uniform_bufs) {
+            buf.destroy(m_allocator);
+        }
+        vkDestroyDescriptorPool(m_device, m_frame_descriptor_pool, nullptr);
+        vkDestroyDescriptorSetLayout(m_device, m_frame_set_layout, nullptr);
+        m_gpu_culling.destroy();
+        m_cluster_culling.destroy();
+        m_depth_pyramid.destroy(m_allocator);
+        vkDestroyQueryPool(m_device, m_sample_query_pool, nullptr);
+
         for (auto& fence: m_fences) {
             vkDestroyFence(m_device, fence, nullptr);
         }
@@ -327,6 +701,14 @@ void SceneImpl::destroy() {
             vkDestroySemaphore(m_device, sem, nullptr);
         }
 
+        m_thread_pool.destroy();
+        for (auto& thread: m_recording_threads) {
+            for (auto& pool: thread.cmd_pools) {
+                vkDestroyCommandPool(m_device, pool, nullptr);
+            }
+        }
+        m_recording_threads.clear();
+
         vkFreeCommandBuffers(m_device, m_cmd_pool, m_cmd_bufs.size(), m_cmd_bufs.data());
 
         vkDestroyCommandPool(m_device, m_transient_cmd_pool, nullptr);
@@ -337,6 +719,7 @@ void SceneImpl::destroy() {
         }
 
         vkDestroyRenderPass(m_device, m_render_pass, nullptr);
+        vkDestroyRenderPass(m_device, m_early_render_pass, nullptr);
 
         if (m_allocator) {
             for (auto& v: m_color_views) {
@@ -356,10 +739,70 @@ void SceneImpl::destroy() {
 MeshID SceneImpl::createMesh(
     MeshStorageFormat storage_format,
     std::span<const glm::vec3> vertices
+) {
+    MeshLOD lod = {
+        .vertices = vertices,
+    };
+    return createMesh(storage_format, std::span(&lod, 1));
+}
+
+MeshID SceneImpl::createMesh(
+    MeshStorageFormat storage_format,
+    std::span<const glm::vec3> vertices,
+    std::span<const uint32_t> indices
+) {
+    MeshLOD lod = {
+        .vertices = vertices,
+        .indices = indices,
+    };
+    return createMesh(storage_format, std::span(&lod, 1));
+}
+
+MeshID SceneImpl::createMesh(
+    MeshStorageFormat storage_format,
+    std::span<const MeshLOD> lods
 ) {
     // TODO: maybe allow dynamic meshes
     assert(storage_format == MeshStorageFormat::Static);
-    return createStaticMesh(vertices);
+    return createStaticMesh(lods);
+}
+
+MeshID SceneImpl::createMesh(
+    MeshStorageFormat storage_format,
+    std::span<const glm::vec3> vertices,
+    const MeshLODGeneration& lod_generation
+) {
+    assert(storage_format == MeshStorageFormat::Static);
+    return createStaticMesh(vertices, lod_generation);
+}
+
+void SceneImpl::createMeshes(
+    MeshStorageFormat storage_format,
+    std::span<const std::span<const glm::vec3>> vertices,
+    std::span<MeshID> meshes
+) {
+    assert(storage_format == MeshStorageFormat::Static);
+    assert(vertices.size() == meshes.size());
+    if (vertices.empty()) {
+        return;
+    }
+
+    auto first = m_static_meshes.size();
+    StaticMeshUploads uploads;
+    for (size_t i = 0; i < vertices.size(); i++) {
+        MeshLOD lod = {
+            .vertices = vertices[i],
+        };
+        meshes[i] = createStaticMesh(
+            buildStaticMeshGeometry(std::span(&lod, 1)), uploads
+        );
+    }
+
+    auto upload = m_uploader.upload(uploads.copies);
+    for (size_t i = first; i < m_static_meshes.size(); i++) {
+        m_static_meshes[i].upload = upload;
+    }
+    m_gpu_culling.invalidateMeshes();
 }
 
 MeshID SceneImpl::createMesh(
@@ -379,6 +822,30 @@ void SceneImpl::setMeshVertexData(
     setDynamicMeshVertexData(mesh, vertices);
 }
 
+void SceneImpl::setMeshOccluder(
+    MeshID mesh,
+    std::span<const glm::vec3> triangles
+) {
+    assert(triangles.size() % 3 == 0);
+    using enum MeshStorageFormat;
+    switch (getMeshStorageFormat(mesh)) {
+        case Static:
+            getStaticMesh(mesh).occluder.assign(triangles.begin(), triangles.end());
+            return;
+        case Dynamic:
+            getDynamicMesh(mesh).occluder.assign(triangles.begin(), triangles.end());
+            return;
+    }
+    assert(!"Invalid enum value");
+}
+
+float SceneImpl::getMeshQuantizationError(MeshID mesh) const {
+    if (getMeshStorageFormat(mesh) != MeshStorageFormat::Static) {
+        return 0.0f;
+    }
+    return m_static_meshes[getMeshIndex(mesh)].quantization.error;
+}
+
 MaterialID SceneImpl::createMaterial(
     std::span<const std::byte> vert_shader_binary,
     std::span<const std::byte> frag_shader_binary
@@ -390,7 +857,10 @@ MaterialID SceneImpl::createMaterial(
     material.create(
         m_device,
         vert_shader_binary, frag_shader_binary,
-        m_render_pass
+        m_render_pass,
+        m_frame_set_layout,
+        m_features.depth_prepass,
+        m_features.quantized_positions
     );
 
     return id;
@@ -402,39 +872,154 @@ ModelID SceneImpl::createModel(
     MaterialID material,
     const glm::mat4& t
 ) {
-    using enum MeshStorageFormat;
-    switch (getMeshStorageFormat(mesh)) {
-        case Static:
-            return createStaticModel(mesh, material, t);
-        case Dynamic:
-            return createDynamicModel(mesh, material, t);
-    }
+    ModelID model;
+    createModels({&mesh, 1}, {&material, 1}, {&t, 1, sizeof(t)}, {&model, 1});
+    return model;
+}
+
+void SceneImpl::createModels(
+    std::span<const MeshID> meshes,
+    std::span<const MaterialID> materials,
+    StridedSpan<glm::mat4> transforms,
+    std::span<ModelID> models
+) {
+    assert(materials.size() == meshes.size());
+    assert(transforms.size() == meshes.size());
+    assert(models.size() == meshes.size());
+    forEachStorageFormatRun(
+        meshes.size(),
+        [&](size_t i) { return getMeshStorageFormat(meshes[i]); },
+        [&](MeshStorageFormat storage_format, size_t first, size_t count) {
+            auto run_meshes = meshes.subspan(first, count);
+            auto run_materials = materials.subspan(first, count);
+            auto run_transforms = transforms.subspan(first, count);
+            auto run_models = models.subspan(first, count);
+            using enum MeshStorageFormat;
+            switch (storage_format) {
+                case Static:
+                    return createStaticModels(
+                        run_meshes, run_materials, run_transforms, run_models
+                    );
+                case Dynamic:
+                    return createDynamicModels(
+                        run_meshes, run_materials, run_transforms, run_models
+                    );
+            }
+        }
+    );
 }
 
 void SceneImpl::destroyModel(ModelID model) {
-    using enum MeshStorageFormat;
-    switch (getModelMeshStorageFormat(model)) {
-        case Static:
-            return destroyStaticModel(model);
-        case Dynamic:
-            return destroyDynamicModel(model);
+    destroyModels({&model, 1});
+}
+
+void SceneImpl::destroyModels(std::span<const ModelID> models) {
+    if (!m_hierarchy.empty()) {
+        for (auto model: models) {
+            m_hierarchy.remove(model);
+        }
     }
+    forEachStorageFormatRun(
+        models.size(),
+        [&](size_t i) { return getModelMeshStorageFormat(models[i]); },
+        [&](MeshStorageFormat storage_format, size_t first, size_t count) {
+            auto run_models = models.subspan(first, count);
+            using enum MeshStorageFormat;
+            switch (storage_format) {
+                case Static:
+                    return destroyStaticModels(run_models);
+                case Dynamic:
+                    return destroyDynamicModels(run_models);
+            }
+        }
+    );
 }
 
 void SceneImpl::setModelTransform(
     ModelID model,
     const glm::mat4& t
 ) {
+    setModelTransforms({&model, 1}, {&t, 1, sizeof(t)});
+}
+
+void SceneImpl::setModelTransforms(
+    std::span<const ModelID> models,
+    StridedSpan<glm::mat4> transforms
+) {
+    assert(transforms.size() == models.size());
+    if (m_hierarchy.empty()) {
+        writeModelTransforms(models, transforms);
+        return;
+    }
+
+    // Transforms of models in the hierarchy are local and applied in draw.
+    // Runs of other models still take the batched path.
+    size_t run_first = 0;
+    auto flushRun = [&](size_t end) {
+        if (end > run_first) {
+            writeModelTransforms(
+                models.subspan(run_first, end - run_first),
+                transforms.subspan(run_first, end - run_first)
+            );
+        }
+    };
+    for (size_t i = 0; i < models.size(); i++) {
+        if (m_hierarchy.contains(models[i])) {
+            flushRun(i);
+            run_first = i + 1;
+            m_hierarchy.setLocalTransform(models[i], transforms[i]);
+        }
+    }
+    flushRun(models.size());
+}
+
+void SceneImpl::setModelOccluder(ModelID model, bool occluder) {
     using enum MeshStorageFormat;
     switch (getModelMeshStorageFormat(model)) {
         case Static:
-            return setStaticModelTransform(model, t);
+            m_static_models.setOccluder(getStaticModelIndex(model), occluder);
+            return;
         case Dynamic:
-            return setDynamicModelTransform(model, t);
+            m_dynamic_models.setOccluder(getDynamicModelIndex(model), occluder);
+            return;
     }
     assert(!"Invalid enum value");
 }
 
+void SceneImpl::setModelParent(ModelID model, ModelID parent) {
+    m_hierarchy.setParent(
+        model, getModelTransformRef(model),
+        parent, getModelTransformRef(parent)
+    );
+}
+
+void SceneImpl::clearModelParent(ModelID model) {
+    if (m_hierarchy.contains(model)) {
+        m_hierarchy.clearParent(model);
+    }
+}
+
+void SceneImpl::writeModelTransforms(
+    std::span<const ModelID> models,
+    StridedSpan<glm::mat4> transforms
+) {
+    forEachStorageFormatRun(
+        models.size(),
+        [&](size_t i) { return getModelMeshStorageFormat(models[i]); },
+        [&](MeshStorageFormat storage_format, size_t first, size_t count) {
+            auto run_models = models.subspan(first, count);
+            auto run_transforms = transforms.subspan(first, count);
+            using enum MeshStorageFormat;
+            switch (storage_format) {
+                case Static:
+                    return setStaticModelTransforms(run_models, run_transforms);
+                case Dynamic:
+                    return setDynamicModelTransforms(run_models, run_transforms);
+            }
+        }
+    );
+}
+
 std::tuple<uint32_t, uint32_t> SceneImpl::getViewport() const {
     return {m_width, m_height};
 }
@@ -458,6 +1043,12 @@ void SceneImpl::draw(Vulkan::ISwapchain* swapchain) {
     swapchain->presentImage(img_idx, draw_sem);
 }
 
+glm::vec4 SceneImpl::getLODCamera() const {
+    auto pixels_per_unit =
+        m_height / (2.0f * std::tan(m_camera.m_vfov * 0.5f));
+    return glm::vec4(m_camera.m_position, pixels_per_unit / c_lod_pixel_error);
+}
+
 glm::mat4 SceneImpl::getProj() const {
     auto proj = glm::perspectiveRH_ZO(
         m_camera.m_vfov, m_camera.m_aspect_ratio,
@@ -479,17 +1070,205 @@ std::tuple<MeshID, StaticMesh*> SceneImpl::getNewStaticMesh() {
     return {id, meshp};
 }
 
-MeshID SceneImpl::createStaticMesh(std::span<const glm::vec3> vertices) {
+MeshID SceneImpl::createStaticMesh(std::span<const MeshLOD> lods) {
+    StaticMeshUploads uploads;
+    auto id = createStaticMesh(buildStaticMeshGeometry(lods), uploads);
+    getStaticMesh(id).upload = m_uploader.upload(uploads.copies);
+    m_gpu_culling.invalidateMeshes();
+
+    return id;
+}
+
+// The caller uploads the geometry and sets the mesh's upload value
+MeshID SceneImpl::createStaticMesh(
+    StaticMeshGeometry geometry, StaticMeshUploads& uploads
+) {
     auto [id, mesh] = getNewStaticMesh();
+    const auto& lod = geometry.lods.front();
+    if (
+        m_features.cluster_culling and
+        lod.index_count / 3 >= c_min_cluster_culled_triangles
+    ) {
+        mesh->meshlets = buildMeshlets(
+            geometry.mesh.positions,
+            std::span(geometry.mesh.indices).subspan(
+                lod.first_index, lod.index_count
+            )
+        );
+        m_cluster_culling.invalidateMeshes();
+    }
     mesh->create(
-        m_device, m_allocator,
-        m_queues.graphics, m_transient_cmd_pool,
-        vertices
+        m_geometry_pools, std::move(geometry), m_position_quantization, uploads
     );
 
     return id;
 }
 
+MeshID SceneImpl::createStaticMesh(
+    std::span<const glm::vec3> vertices,
+    const MeshLODGeneration& lod_generation
+) {
+    MeshLOD lod = {
+        .vertices = vertices,
+    };
+    auto id = createStaticMesh(std::span(&lod, 1));
+
+    auto ratios = lod_generation.triangle_ratios.first(std::min(
+        lod_generation.triangle_ratios.size(), c_max_mesh_lods - 1
+    ));
+    auto triangle_count = vertices.size() / 3;
+    std::vector<size_t> targets;
+    for (auto ratio: ratios) {
+        auto target = static_cast<size_t>(ratio * triangle_count);
+        if (target < (targets.empty() ? triangle_count : targets.back())) {
+            targets.push_back(target);
+        }
+    }
+    if (targets.empty()) {
+        return id;
+    }
+
+    if (m_lod_jobs.empty()) {
+        m_lod_jobs.create(
+            std::max<size_t>(std::thread::hardware_concurrency() / 2, 1)
+        );
+    }
+    // std::function must be copyable, so the task is shared. Geometry is
+    // built on the job thread too, since welding and reordering large
+    // meshes is slow.
+    auto task = std::make_shared<
+        std::packaged_task<StaticMeshGeometry()>
+    >([
+        vertices = std::vector(vertices.begin(), vertices.end()),
+        targets = std::move(targets)
+    ] {
+        auto simplified = simplifyMesh(weldVertices(vertices), targets);
+        if (simplified.empty()) {
+            return StaticMeshGeometry();
+        }
+        std::vector<MeshLOD> lods = {{
+            .vertices = vertices,
+        }};
+        for (const auto& s: simplified) {
+            lods.push_back({
+                .vertices = s.vertices,
+                .error = s.error,
+            });
+        }
+        return buildStaticMeshGeometry(lods);
+    });
+    m_pending_lods.push_back({
+        .mesh = id,
+        .lods = task->get_future(),
+    });
+    m_lod_jobs.submit([task] { (*task)(); });
+
+    return id;
+}
+
+void SceneImpl::installGeneratedLODs() {
+    bool installed = false;
+    bool clustered_moved = false;
+    bool quantization_changed = false;
+    std::erase_if(m_pending_lods, [&](PendingLODs& pending) {
+        if (
+            pending.lods.wait_for(std::chrono::seconds(0)) !=
+            std::future_status::ready
+        ) {
+            return false;
+        }
+        auto geometry = pending.lods.get();
+        if (geometry.lods.empty()) {
+            return true;
+        }
+
+        auto& mesh = getStaticMesh(pending.mesh);
+        StaticMesh new_mesh;
+        StaticMeshUploads uploads;
+        new_mesh.create(
+            m_geometry_pools, std::move(geometry), m_position_quantization,
+            uploads
+        );
+        new_mesh.upload = m_uploader.upload(uploads.copies);
+        new_mesh.occluder = std::move(mesh.occluder);
+        // The full detail level is unchanged, so its meshlets stay valid
+        new_mesh.meshlets = std::move(mesh.meshlets);
+        new_mesh.model_count = mesh.model_count;
+        new_mesh.acquire_queued = mesh.acquire_queued;
+        if (mesh.upload) {
+            // The transfer queue may still write the old geometry
+            m_uploader.wait(mesh.upload);
+        }
+        // Coarse levels may grow the bounding box, which changes the
+        // dequantization of draw transforms
+        quantization_changed = quantization_changed or
+            mesh.vertex_format != new_mesh.vertex_format or
+            (new_mesh.vertex_format == VertexFormat::Quantized and (
+                mesh.quantization.offset != new_mesh.quantization.offset or
+                mesh.quantization.scale != new_mesh.quantization.scale
+            ));
+        m_retired_meshes[m_cur_img].push_back(std::move(mesh));
+        mesh = std::move(new_mesh);
+        queueStaticMeshAcquire(pending.mesh);
+        installed = true;
+        // Cluster draws point to the first vertex of the mesh
+        clustered_moved = clustered_moved or !mesh.meshlets.empty();
+        return true;
+    });
+
+    if (installed) {
+        invalidateStaticDraws();
+        m_gpu_culling.invalidateMeshes();
+        // New geometry may live in other pool blocks, which moves its
+        // models to other buckets
+        m_gpu_culling.invalidateModels();
+    }
+    if (clustered_moved) {
+        m_cluster_culling.invalidateMeshes();
+    }
+    if (quantization_changed) {
+        m_gpu_culling.invalidateTransforms(m_static_models.size());
+    }
+}
+
+// Meshes without models can't be drawn, and are left to the transfer
+// queue until a model uses them
+void SceneImpl::queueStaticMeshAcquire(MeshID id) {
+    auto& mesh = getStaticMesh(id);
+    if (!mesh.upload or !mesh.model_count or mesh.acquire_queued) {
+        return;
+    }
+    mesh.acquire_queued = true;
+    m_unacquired_meshes.push_back(id);
+}
+
+// Returns the uploader semaphore value the frame has to wait for
+uint64_t SceneImpl::acquireStaticMeshes(VkCommandBuffer cmd_buffer) {
+    if (m_unacquired_meshes.empty()) {
+        return 0;
+    }
+    uint64_t wait_value = 0;
+    std::vector<Uploader::Range> ranges;
+    for (auto id: m_unacquired_meshes) {
+        auto& mesh = getStaticMesh(id);
+        mesh.acquire_queued = false;
+        // All of the mesh's models may have been destroyed since
+        if (!mesh.model_count) {
+            continue;
+        }
+        mesh.getUploadRanges(m_geometry_pools, ranges);
+        wait_value = std::max(wait_value, mesh.upload);
+        mesh.upload = 0;
+    }
+    m_unacquired_meshes.clear();
+    m_uploader.recordAcquire(
+        cmd_buffer, ranges,
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+        VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT
+    );
+    return wait_value;
+}
+
 DynamicMesh& SceneImpl::getDynamicMesh(MeshID mesh) {
     assert(getMeshStorageFormat(mesh) == MeshStorageFormat::Dynamic);
     auto i = getMeshIndex(mesh);
@@ -523,98 +1302,93 @@ Material& SceneImpl::getMaterial(MaterialID material) {
     return m_mats[i];
 }
 
-StaticModel& SceneImpl::getStaticModel(ModelID model) {
+size_t SceneImpl::getStaticModelIndex(ModelID model) const {
     assert(getModelMeshStorageFormat(model) == MeshStorageFormat::Static);
-    auto i = getModelIndex(model);
-    return m_static_models[i];
-}
-
-std::tuple<ModelID, StaticModel*> SceneImpl::getNewStaticModel() {
-    if (m_static_model_id_pool.empty()) {
-        auto id = makeModelID(m_static_models.size(), MeshStorageFormat::Static);
-        auto modelp = &m_static_models.emplace_back();
-        return {id, modelp};
-    } else {
-        auto index = m_static_model_id_pool.top();
-        m_static_model_id_pool.pop();
-        auto id = makeModelID(index, MeshStorageFormat::Static);
-        auto modelp = &m_static_models[index];
-        return {id, modelp};
-    }
-}
-
-void SceneImpl::returnStaticModelIDToPool(Detail::modelid id) {
-    m_static_model_id_pool.push(id);
+    return m_static_models.denseIndex(getModelSlot(model));
 }
 
-ModelID SceneImpl::createStaticModel(
-    MeshID mesh,
-    MaterialID material, const glm::mat4& t
+void SceneImpl::createStaticModels(
+    std::span<const MeshID> meshes,
+    std::span<const MaterialID> materials,
+    StridedSpan<glm::mat4> transforms,
+    std::span<ModelID> models
 ) {
-    auto [id, model] = getNewStaticModel();
-    model->create(mesh, material, t);
-    return id;
+    m_static_models.reserve(m_static_models.size() + meshes.size());
+    for (size_t i = 0; i < meshes.size(); i++) {
+        auto slot = m_static_models.add(meshes[i], materials[i], transforms[i]);
+        models[i] = makeModelID(slot, MeshStorageFormat::Static);
+        getStaticMesh(meshes[i]).model_count++;
+        queueStaticMeshAcquire(meshes[i]);
+    }
+    invalidateStaticDraws();
+    m_gpu_culling.invalidateModels();
+    m_cluster_culling.invalidateModels();
 }
 
-void SceneImpl::destroyStaticModel(ModelID id) {
-    auto& model = getStaticModel(id);
-    model.destroy();
-    returnStaticModelIDToPool(id);
+void SceneImpl::destroyStaticModels(std::span<const ModelID> models) {
+    for (auto model: models) {
+        auto slot = getModelSlot(model);
+        auto idx = m_static_models.denseIndex(slot);
+        getStaticMesh(m_static_models.mesh(idx)).model_count--;
+        m_static_models.remove(slot);
+    }
+    invalidateStaticDraws();
+    m_gpu_culling.invalidateModels();
+    m_cluster_culling.invalidateModels();
 }
 
-void SceneImpl::setStaticModelTransform(
-    ModelID id,
-    const glm::mat4& t
+void SceneImpl::setStaticModelTransforms(
+    std::span<const ModelID> models,
+    StridedSpan<glm::mat4> transforms
 ) {
-    auto& model = getStaticModel(id);
-    model.transform = t;
+    for (size_t i = 0; i < models.size(); i++) {
+        auto idx = getStaticModelIndex(models[i]);
+        copyTransform(m_static_models.transform(idx), transforms[i]);
+        if (m_features.gpu_culling) {
+            m_gpu_culling.setTransformDirty(idx);
+        }
+    }
+    // With GPU culling transforms are read from a GPU buffer, so the cached
+    // draws stay valid
+    if (!m_features.gpu_culling) {
+        invalidateStaticDraws();
+    }
 }
 
-DynamicModel& SceneImpl::getDynamicModel(ModelID model) {
+size_t SceneImpl::getDynamicModelIndex(ModelID model) const {
     assert(getModelMeshStorageFormat(model) == MeshStorageFormat::Dynamic);
-    auto i = getModelIndex(model);
-    return m_dynamic_models[i];
+    return m_dynamic_models.denseIndex(getModelSlot(model));
 }
 
-std::tuple<ModelID, DynamicModel*> SceneImpl::getNewDynamicModel() {
-    if (m_dynamic_model_id_pool.empty()) {
-        auto id = makeModelID(m_dynamic_models.size(), MeshStorageFormat::Dynamic);
-        auto modelp = &m_dynamic_models.emplace_back();
-        return {id, modelp};
-    } else {
-        auto index = m_dynamic_model_id_pool.top();
-        m_dynamic_model_id_pool.pop();
-        auto id = makeModelID(index, MeshStorageFormat::Dynamic);
-        auto modelp = &m_dynamic_models[index];
-        return {id, modelp};
+void SceneImpl::createDynamicModels(
+    std::span<const MeshID> meshes,
+    std::span<const MaterialID> materials,
+    StridedSpan<glm::mat4> transforms,
+    std::span<ModelID> models
+) {
+    m_dynamic_models.reserve(m_dynamic_models.size() + meshes.size());
+    for (size_t i = 0; i < meshes.size(); i++) {
+        auto slot = m_dynamic_models.add(meshes[i], materials[i], transforms[i]);
+        models[i] = makeModelID(slot, MeshStorageFormat::Dynamic);
     }
+    m_draw_list.invalidate();
 }
 
-void SceneImpl::returnDynamicModelIDToPool(Detail::modelid id) {
-    m_dynamic_model_id_pool.push(id);
+void SceneImpl::destroyDynamicModels(std::span<const ModelID> models) {
+    for (auto model: models) {
+        m_dynamic_models.remove(getModelSlot(model));
+    }
+    m_draw_list.invalidate();
 }
 
-ModelID SceneImpl::createDynamicModel(
-    MeshID mesh,
-    MaterialID material, const glm::mat4& t
+void SceneImpl::setDynamicModelTransforms(
+    std::span<const ModelID> models,
+    StridedSpan<glm::mat4> transforms
 ) {
-    auto [id, model] = getNewDynamicModel();
-    model->create(mesh, material, t);
-    return id;
-}
-
-void SceneImpl::destroyDynamicModel(ModelID id) {
-    auto& model = getDynamicModel(id);
-    model.destroy();
-    returnDynamicModelIDToPool(id);
-}
-
-void SceneImpl::setDynamicModelTransform(
-    ModelID id,
-    const glm::mat4& t
-) {
-    auto& model = getDynamicModel(id);
-    model.transform = t;
+    for (size_t i = 0; i < models.size(); i++) {
+        auto idx = getDynamicModelIndex(models[i]);
+        copyTransform(m_dynamic_models.transform(idx), transforms[i]);
+    }
 }
 
 VkSemaphore SceneImpl::draw(
@@ -629,6 +1403,19 @@ VkSemaphore SceneImpl::draw(
         vkWaitForFences(m_device, 1, &fence, true, UINT64_MAX);
         vkResetFences(m_device, 1, &fence);
 
+        for (auto& mesh: m_retired_meshes[m_cur_img]) {
+            mesh.destroy(m_geometry_pools);
+        }
+        m_retired_meshes[m_cur_img].clear();
+        m_uploader.collect();
+        installGeneratedLODs();
+
+        for (auto& thread: m_recording_threads) {
+            vkResetCommandPool(m_device, thread.cmd_pools[m_cur_img], 0);
+        }
+        updateFrameUniforms(proj_view);
+        updateHierarchy();
+
         VkCommandBuffer cmd_buffer = m_cmd_bufs[m_cur_img];
         {
             VkCommandBufferBeginInfo begin_info = {
@@ -636,88 +1423,173 @@ VkSemaphore SceneImpl::draw(
             };
             vkBeginCommandBuffer(cmd_buffer, &begin_info);
         }
-
+        auto upload_wait_value = acquireStaticMeshes(cmd_buffer);
+
+        // GPU results of the last submission of this frame are complete
+        // after the fence, and are read before they are reset
+        m_frame_stats = {};
+        if (m_features.cluster_culling) {
+            m_frame_stats.cluster_culling_ms =
+                m_cluster_culling.elapsedMs(m_cur_img);
+        }
+        if (m_features.triangle_culling) {
+            auto counters = m_cluster_culling.triangleCounters(m_cur_img);
+            m_frame_stats.tested_triangles = counters.tested;
+            m_frame_stats.degenerate_triangles = counters.degenerate;
+            m_frame_stats.back_facing_triangles = counters.back_facing;
+            m_frame_stats.outside_triangles = counters.outside;
+            m_frame_stats.small_triangles = counters.small;
+        }
+        if (m_samples_counted[m_cur_img]) {
+            readSampleCounts();
+        }
         {
-            VkViewport viewport = {
-                .width = static_cast<float>(m_width),
-                .height = static_cast<float>(m_height),
-                .minDepth = 0.0f,
-                .maxDepth = 1.0f,
-            };
-            VkRect2D scissor = {
-                .extent = {
-                    .width = m_width,
-                    .height = m_height,
-                },
-            };
-            vkCmdSetViewport(cmd_buffer, 0, 1, &viewport);
-            vkCmdSetScissor(cmd_buffer, 0, 1, &scissor);
+            for (const auto* vertices: {
+                &m_geometry_pools.vertices,
+                &m_geometry_pools.quantized_vertices,
+            }) {
+                auto pool = vertices->stats();
+                auto& stats = m_frame_stats;
+                stats.vertex_pool_capacity += pool.capacity;
+                stats.vertex_pool_free += pool.free_elements;
+                stats.vertex_pool_free_ranges += pool.free_range_count;
+                stats.vertex_pool_largest_free = std::max(
+                    stats.vertex_pool_largest_free, pool.largest_free_range
+                );
+            }
         }
 
-        {
-            VkClearValue clear_color = {
-                .color = {
-                    .float32 = {
-                        0.0f, 0.0f, 0.0f, 1.0f,
-                    },
-                },
-            };
-            VkClearValue clear_depth = {
-                .depthStencil = {
-                    .depth = 1.0f,
-                },
-            };
-            std::array clear_values = {
-                clear_color,
-                clear_depth,  
-            };
-            VkRenderPassBeginInfo begin_info = {
-                .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-                .renderPass = m_render_pass,
-                .framebuffer = m_fbs[m_cur_img],
-                .renderArea = {
-                    .extent = {
-                        .width = m_width,
-                        .height = m_height,
-                    },
-                },
-                .clearValueCount = clear_values.size(),
-                .pClearValues = clear_values.data(),
-            };
-            vkCmdBeginRenderPass(cmd_buffer, &begin_info, VK_SUBPASS_CONTENTS_INLINE);
+        if (m_features.gpu_culling) {
+            if (m_gpu_culling.update(m_static_models, m_static_meshes)) {
+                // The device is idle after the reallocation, so every
+                // frame's set can be rewritten
+                for (size_t i = 0; i < c_img_cnt; i++) {
+                    writeFrameSet(
+                        m_device, m_gpu_culled_frame_sets[i],
+                        m_frame_uniform_bufs[i].buffer,
+                        m_gpu_culling.transformBuffer()
+                    );
+                    m_static_caches[i].valid = false;
+                }
+            }
+            m_gpu_culling.recordCulling(
+                cmd_buffer, m_cur_img,
+                makeFrustum(proj_view), getLODCamera(),
+                m_static_models, m_static_meshes
+            );
+        }
+        if (m_features.cluster_culling) {
+            if (m_cluster_culling.update(
+                m_uploader, cmd_buffer,
+                m_static_models, m_static_meshes,
+                m_gpu_culling.transformBuffer()
+            )) {
+                for (auto& cache: m_static_caches) {
+                    cache.valid = false;
+                }
+            }
+            upload_wait_value = std::max(
+                upload_wait_value, m_cluster_culling.uploadValue()
+            );
+            m_cluster_culling.recordCulling(
+                cmd_buffer, m_cur_img,
+                proj_view, m_camera.m_position,
+                glm::vec2(m_width, m_height)
+            );
         }
 
-        // TODO: deduplicate this
-        for (const auto& model: m_static_models) {
-            auto& material = getMaterial(model.material);
-            auto& mesh = getStaticMesh(model.mesh);
+        if (m_features.cpu_occlusion_culling) {
+            rasterizeOccluders(proj_view);
+        }
+        updateStaticDrawList(proj_view);
+        updateDrawList(proj_view);
+        for (const auto& p: m_static_draw_list.visiblePackets()) {
+            m_frame_stats.lod_draws[p.lod]++;
+        }
+        m_frame_stats.lod_draws[0] += m_draw_list.visiblePackets().size();
+        auto& transform_buf = m_transform_bufs[m_cur_img];
+        auto static_count = m_static_draw_list.visiblePackets().size();
+        auto dynamic_count = m_draw_list.visiblePackets().size();
+        if (transform_buf.reserve(m_allocator, static_count + dynamic_count)) {
+            writeFrameSet(
+                m_device, m_frame_sets[m_cur_img],
+                m_frame_uniform_bufs[m_cur_img].buffer,
+                transform_buf.buffer.buffer
+            );
+            m_static_caches[m_cur_img].valid = false;
+        }
 
-            glm::mat4 mvp = proj_view * model.transform;
+        recordStaticDraws();
+        m_thread_pool.run([&](size_t thread_idx) {
+            recordDynamicDraws(thread_idx);
+        });
+        transform_buf.flush(
+            m_allocator,
+            m_static_caches[m_cur_img].transform_count, dynamic_count
+        );
 
-            // TODO: reorder bind calls for greater efficiency
-            // TODO: check for empty model slots
-            material.bind(cmd_buffer);
-            material.setMVP(cmd_buffer, mvp);
-            mesh.bind(cmd_buffer);
-            mesh.draw(cmd_buffer);
+        const auto& cache = m_static_caches[m_cur_img];
+        if (m_sample_query_pool) {
+            vkCmdResetQueryPool(
+                cmd_buffer, m_sample_query_pool,
+                c_sample_queries * m_cur_img, c_sample_queries
+            );
+            m_samples_counted[m_cur_img] = true;
+        }
+        if (m_features.occlusion_culling) {
+            // Models visible last frame fill depth, which the rest are
+            // tested against
+            beginRenderPass(cmd_buffer, m_early_render_pass);
+            if (m_features.depth_prepass) {
+                executeSecondaries(
+                    cmd_buffer, std::span(&cache.depth_cmd_buffer, 1), 0
+                );
+                vkCmdNextSubpass(
+                    cmd_buffer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+                );
+            }
+            executeSecondaries(cmd_buffer, std::span(&cache.cmd_buffer, 1), 1);
+            vkCmdEndRenderPass(cmd_buffer);
+            m_depth_pyramid.record(cmd_buffer);
+            m_gpu_culling.recordOcclusionCulling(
+                cmd_buffer, m_cur_img, proj_view, getLODCamera(),
+                m_static_models
+            );
         }
 
-        for (const auto& model: m_dynamic_models) {
-            auto& material = getMaterial(model.material);
-            auto& mesh = getDynamicMesh(model.mesh);
-
-            glm::mat4 mvp = proj_view * model.transform;
+        {
+            beginRenderPass(cmd_buffer, m_render_pass);
+
+            // Dynamic secondaries are executed in thread order, which
+            // matches the draw order of a single threaded recording
+            std::vector<VkCommandBuffer> secondaries;
+            secondaries.reserve(m_recording_threads.size() + 1);
+            if (m_features.depth_prepass) {
+                secondaries.push_back(
+                    m_features.occlusion_culling ?
+                        cache.late_depth_cmd_buffer : cache.depth_cmd_buffer
+                );
+                for (const auto& thread: m_recording_threads) {
+                    secondaries.push_back(thread.depth_cmd_bufs[m_cur_img]);
+                }
+                executeSecondaries(cmd_buffer, secondaries, 2);
+                vkCmdNextSubpass(
+                    cmd_buffer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+                );
+                secondaries.clear();
+            }
+            secondaries.push_back(
+                m_features.occlusion_culling ?
+                    cache.late_cmd_buffer : cache.cmd_buffer
+            );
+            for (const auto& thread: m_recording_threads) {
+                secondaries.push_back(thread.cmd_bufs[m_cur_img]);
+            }
+            executeSecondaries(cmd_buffer, secondaries, 3);
 
-            // TODO: reorder bind calls for greater efficiency
-            // TODO: check for empty model slots
-            material.bind(cmd_buffer);
-            material.setMVP(cmd_buffer, mvp);
-            mesh.bind(cmd_buffer);
-            mesh.draw(cmd_buffer);
+            vkCmdEndRenderPass(cmd_buffer);
         }
 
-        vkCmdEndRenderPass(cmd_buffer);
-
         {
             VkImageMemoryBarrier to_layout_bar = {
                 .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
@@ -793,13 +1665,36 @@ VkSemaphore SceneImpl::draw(
 
         vkEndCommandBuffer(cmd_buffer);
 
-        VkPipelineStageFlags transfer_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        // Buffers acquired by this frame are waited for before their first
+        // use
+        m_uploader.flush();
+        std::array wait_sems = {
+            dst_img_sem,
+            m_uploader.semaphore(),
+        };
+        std::array<VkPipelineStageFlags, 2> wait_stages = {
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT |
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+        };
+        std::array<uint64_t, 2> wait_values = {
+            0,
+            upload_wait_value,
+        };
+        uint32_t wait_count = upload_wait_value ? 2 : 1;
+        VkTimelineSemaphoreSubmitInfo timeline_info = {
+            .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+            .waitSemaphoreValueCount = wait_count,
+            .pWaitSemaphoreValues = wait_values.data(),
+        };
         VkSemaphore dst_sem = m_dst_sems[m_cur_img];
         VkSubmitInfo submit_info = {
             .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-            .waitSemaphoreCount = 1,
-            .pWaitSemaphores = &dst_img_sem,
-            .pWaitDstStageMask = &transfer_stage,
+            .pNext = &timeline_info,
+            .waitSemaphoreCount = wait_count,
+            .pWaitSemaphores = wait_sems.data(),
+            .pWaitDstStageMask = wait_stages.data(),
             .commandBufferCount = 1,
             .pCommandBuffers = &cmd_buffer,
             .signalSemaphoreCount = 1,
@@ -817,6 +1712,607 @@ VkSemaphore SceneImpl::draw(
         return dst_sem;
     }
 
+const glm::mat4& SceneImpl::getModelTransformRef(ModelID model) const {
+    using enum MeshStorageFormat;
+    switch (getModelMeshStorageFormat(model)) {
+        case Static:
+            return m_static_models.transform(getStaticModelIndex(model));
+        case Dynamic:
+            return m_dynamic_models.transform(getDynamicModelIndex(model));
+    }
+    assert(!"Invalid enum value");
+}
+
+void SceneImpl::updateHierarchy() {
+    if (m_hierarchy.empty()) {
+        return;
+    }
+    m_hierarchy.update(m_thread_pool);
+    m_hierarchy.forEachUpdatedTree([&](
+        std::span<const ModelID> models,
+        std::span<const glm::mat4> transforms
+    ) {
+        writeModelTransforms(models, transforms);
+    });
+}
+
+const MeshBounds& SceneImpl::getMeshBounds(MeshID mesh) {
+    using enum MeshStorageFormat;
+    switch (getMeshStorageFormat(mesh)) {
+        case Static:
+            return getStaticMesh(mesh).bounds;
+        case Dynamic:
+            return getDynamicMesh(mesh).bounds;
+    }
+    assert(!"Invalid enum value");
+}
+
+std::span<const glm::vec3> SceneImpl::getMeshOccluder(MeshID mesh) {
+    using enum MeshStorageFormat;
+    switch (getMeshStorageFormat(mesh)) {
+        case Static:
+            return getStaticMesh(mesh).occluder;
+        case Dynamic:
+            return getDynamicMesh(mesh).occluder;
+    }
+    assert(!"Invalid enum value");
+}
+
+void SceneImpl::rasterizeOccluders(const glm::mat4& proj_view) {
+    auto start = std::chrono::steady_clock::now();
+    m_occlusion_buffer.clear();
+    for (const auto* models: {&m_static_models, &m_dynamic_models}) {
+        for (size_t i = 0; i < models->size(); i++) {
+            if (models->occluder(i)) {
+                m_occlusion_buffer.addOccluder(
+                    proj_view * models->transform(i),
+                    getMeshOccluder(models->mesh(i))
+                );
+            }
+        }
+    }
+    m_occlusion_buffer.rasterize(m_thread_pool);
+    m_frame_stats.occluder_raster_ms = getElapsedMs(start);
+}
+
+size_t SceneImpl::cullOccluded(
+    const glm::mat4& proj_view,
+    const SphereBoundsSoA& bounds,
+    std::vector<uint8_t>& visible
+) {
+    if (!m_features.cpu_occlusion_culling) {
+        return 0;
+    }
+    auto start = std::chrono::steady_clock::now();
+    auto culled = m_occlusion_buffer.cull(
+        proj_view, bounds, visible, m_thread_pool
+    );
+    m_frame_stats.occlusion_test_ms += getElapsedMs(start);
+    return culled;
+}
+
+void SceneImpl::updateDrawList(const glm::mat4& proj_view) {
+    bool rebuild_bvh = !m_draw_list.valid();
+    if (!m_draw_list.valid()) {
+        m_draw_list.reset();
+        for (size_t i = 0; i < m_dynamic_models.size(); i++) {
+            m_draw_list.add(
+                i, m_dynamic_models.mesh(i), m_dynamic_models.material(i)
+            );
+        }
+    }
+
+    // Bounds and depths are computed per model in storage order, which
+    // lets the SIMD pass stream through the packed transforms
+    auto model_cnt = m_dynamic_models.size();
+    m_model_spheres.resize(model_cnt);
+    auto meshes = m_dynamic_models.meshes();
+    for (size_t i = 0; i < model_cnt; i++) {
+        m_model_spheres[i] = getMeshBounds(meshes[i]).sphere;
+    }
+
+    // Clip space w is the view space distance for a perspective projection
+    glm::vec4 w_row = {
+        proj_view[0][3], proj_view[1][3], proj_view[2][3], proj_view[3][3],
+    };
+    transformBounds(
+        m_dynamic_models.transforms(), m_model_spheres, w_row,
+        m_cull_bounds, m_view_depths
+    );
+    // Dynamic models move every frame, so their tree is only refitted and
+    // rebuilt when models are added or removed
+    if (rebuild_bvh) {
+        m_dynamic_bvh.build(m_cull_bounds, m_thread_pool);
+    } else {
+        m_dynamic_bvh.refit(m_cull_bounds, m_thread_pool);
+    }
+    m_frame_stats.culled_models += m_dynamic_bvh.cull(
+        makeFrustum(proj_view), m_cull_bounds, m_cull_visibility
+    );
+    m_frame_stats.occluded_models +=
+        cullOccluded(proj_view, m_cull_bounds, m_cull_visibility);
+
+    auto depth_scale = 1.0f / (m_far - m_near);
+    for (auto& p: m_draw_list.packets()) {
+        auto i = p.model;
+        p.key = setDrawKeyDepth(p.key, (m_view_depths[i] - m_near) * depth_scale);
+        p.visible = m_cull_visibility[i];
+    }
+
+    m_draw_list.sort();
+    m_draw_list.compact();
+}
+
+void SceneImpl::invalidateStaticDraws() {
+    m_static_draw_list.invalidate();
+    for (auto& cache: m_static_caches) {
+        cache.valid = false;
+    }
+}
+
+void SceneImpl::updateFrameUniforms(const glm::mat4& proj_view) {
+    const auto& buf = m_frame_uniform_bufs[m_cur_img];
+    auto uniforms = static_cast<FrameUniforms*>(getMappedData(m_allocator, buf));
+    *uniforms = {
+        .proj_view = proj_view,
+    };
+    vmaFlushAllocation(m_allocator, buf.allocation, 0, sizeof(FrameUniforms));
+}
+
+void SceneImpl::beginRenderPass(
+    VkCommandBuffer cmd_buffer, VkRenderPass render_pass
+) {
+    VkClearValue clear_color = {
+        .color = {
+            .float32 = {
+                0.0f, 0.0f, 0.0f, 1.0f,
+            },
+        },
+    };
+    VkClearValue clear_depth = {
+        .depthStencil = {
+            .depth = 1.0f,
+        },
+    };
+    std::array clear_values = {
+        clear_color,
+        clear_depth,  
+    };
+    VkRenderPassBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+        .renderPass = render_pass,
+        .framebuffer = m_fbs[m_cur_img],
+        .renderArea = {
+            .extent = {
+                .width = m_width,
+                .height = m_height,
+            },
+        },
+        .clearValueCount = clear_values.size(),
+        .pClearValues = clear_values.data(),
+    };
+    vkCmdBeginRenderPass(
+        cmd_buffer, &begin_info,
+        VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+    );
+}
+
+void SceneImpl::executeSecondaries(
+    VkCommandBuffer cmd_buffer,
+    std::span<const VkCommandBuffer> secondaries,
+    uint32_t sample_query
+) {
+    auto query = c_sample_queries * m_cur_img + sample_query;
+    if (m_sample_query_pool) {
+        vkCmdBeginQuery(
+            cmd_buffer, m_sample_query_pool, query,
+            VK_QUERY_CONTROL_PRECISE_BIT
+        );
+    }
+    vkCmdExecuteCommands(cmd_buffer, secondaries.size(), secondaries.data());
+    if (m_sample_query_pool) {
+        vkCmdEndQuery(cmd_buffer, m_sample_query_pool, query);
+    }
+}
+
+void SceneImpl::readSampleCounts() {
+    // Without occlusion culling the early queries are never begun
+    uint32_t first = m_features.occlusion_culling ? 0 : 2;
+    std::array<uint64_t, c_sample_queries> samples = {};
+    auto result = vkGetQueryPoolResults(
+        m_device, m_sample_query_pool,
+        c_sample_queries * m_cur_img + first, c_sample_queries - first,
+        (c_sample_queries - first) * sizeof(uint64_t), &samples[first],
+        sizeof(uint64_t),
+        VK_QUERY_RESULT_64_BIT
+    );
+    if (result != VK_SUCCESS) {
+        return;
+    }
+    m_frame_stats.prepass_samples = samples[0] + samples[2];
+    m_frame_stats.shaded_samples = samples[1] + samples[3];
+}
+
+MaterialPass SceneImpl::shadingPass() const {
+    return m_features.depth_prepass ?
+        MaterialPass::Shading : MaterialPass::Single;
+}
+
+void SceneImpl::beginSecondary(
+    VkCommandBuffer cmd_buffer, VkCommandBufferUsageFlags flags,
+    MaterialPass pass
+) {
+    {
+        VkCommandBufferInheritanceInfo inheritance_info = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+            .renderPass = m_render_pass,
+            .subpass = pass == MaterialPass::Shading ? 1u : 0u,
+            .framebuffer = m_fbs[m_cur_img],
+            .occlusionQueryEnable = m_sample_query_pool != VK_NULL_HANDLE,
+            .queryFlags = m_sample_query_pool ?
+                VkQueryControlFlags(VK_QUERY_CONTROL_PRECISE_BIT) : 0,
+        };
+        VkCommandBufferBeginInfo begin_info = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            .flags = flags | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+            .pInheritanceInfo = &inheritance_info,
+        };
+        vkBeginCommandBuffer(cmd_buffer, &begin_info);
+    }
+
+    {
+        VkViewport viewport = {
+            .width = static_cast<float>(m_width),
+            .height = static_cast<float>(m_height),
+            .minDepth = 0.0f,
+            .maxDepth = 1.0f,
+        };
+        VkRect2D scissor = {
+            .extent = {
+                .width = m_width,
+                .height = m_height,
+            },
+        };
+        vkCmdSetViewport(cmd_buffer, 0, 1, &viewport);
+        vkCmdSetScissor(cmd_buffer, 0, 1, &scissor);
+    }
+
+    // All material pipeline layouts are compatible for the frame set
+    if (!m_mats.empty()) {
+        m_mats.front().bindFrameSet(cmd_buffer, m_frame_sets[m_cur_img]);
+    }
+}
+
+void SceneImpl::updateStaticDrawList(const glm::mat4& proj_view) {
+    bool rebuild = !m_static_draw_list.valid();
+    if (rebuild) {
+        m_static_draw_list.reset();
+        auto static_model_cnt =
+            m_features.gpu_culling ? 0 : m_static_models.size();
+        for (size_t i = 0; i < static_model_cnt; i++) {
+            m_static_draw_list.add(
+                i, m_static_models.mesh(i), m_static_models.material(i)
+            );
+        }
+
+        m_model_spheres.resize(static_model_cnt);
+        auto meshes = m_static_models.meshes();
+        for (size_t i = 0; i < static_model_cnt; i++) {
+            m_model_spheres[i] = getMeshBounds(meshes[i]).sphere;
+        }
+        transformBounds(
+            m_static_models.transforms().first(static_model_cnt),
+            m_model_spheres, glm::vec4(0.0f),
+            m_static_cull_bounds, m_view_depths
+        );
+        m_static_bvh.build(m_static_cull_bounds, m_thread_pool);
+        m_static_visibility.clear();
+    }
+
+    m_frame_stats.culled_models += m_static_bvh.cull(
+        makeFrustum(proj_view), m_static_cull_bounds, m_static_cull_visibility
+    );
+    m_frame_stats.occluded_models += cullOccluded(
+        proj_view, m_static_cull_bounds, m_static_cull_visibility
+    );
+
+    bool lods_changed = updateStaticLODs() or rebuild;
+    if (lods_changed) {
+        for (auto& p: m_static_draw_list.packets()) {
+            p.lod = m_static_models.lod(p.model);
+            p.key = setDrawKeyLOD(p.key, p.lod);
+        }
+        m_static_draw_list.sort();
+    }
+
+    // Static draws are only re-recorded when the set of visible models or
+    // their levels of detail change, so a still camera keeps using the
+    // cached draws
+    if (lods_changed or m_static_cull_visibility != m_static_visibility) {
+        std::swap(m_static_cull_visibility, m_static_visibility);
+        for (auto& p: m_static_draw_list.packets()) {
+            p.visible = m_static_visibility[p.model];
+        }
+        m_static_draw_list.compact();
+        m_static_visibility_version++;
+    }
+    auto& cache = m_static_caches[m_cur_img];
+    if (cache.visibility_version != m_static_visibility_version) {
+        cache.valid = false;
+    }
+}
+
+bool SceneImpl::updateStaticLODs() {
+    auto lod_camera = getLODCamera();
+    auto camera = glm::vec3(lod_camera);
+    const auto& bounds = m_static_cull_bounds;
+    bool changed = false;
+    for (size_t i = 0; i < bounds.count; i++) {
+        if (!m_static_cull_visibility[i]) {
+            continue;
+        }
+        const auto& lods = getStaticMesh(m_static_models.mesh(i)).lods;
+        if (lods.size() == 1) {
+            continue;
+        }
+        auto center = glm::vec3(bounds.x[i], bounds.y[i], bounds.z[i]);
+        auto distance = std::max(
+            glm::distance(center, camera) - bounds.radius[i], m_near
+        );
+        auto error_scale =
+            getMaxScale(m_static_models.transform(i)) * lod_camera.w / distance;
+        auto prev = m_static_models.lod(i);
+        auto lod = selectMeshLOD(lods, prev, error_scale);
+        if (lod != prev) {
+            m_static_models.setLOD(i, lod);
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+void SceneImpl::recordStaticDraws() {
+    auto& cache = m_static_caches[m_cur_img];
+    if (cache.valid) {
+        return;
+    }
+
+    // The cache of this frame is not in use, since its fence was waited on
+    vkResetCommandPool(m_device, cache.cmd_pool, 0);
+
+    auto& transform_buf = m_transform_bufs[m_cur_img];
+    auto transform_count = m_static_draw_list.visiblePackets().size();
+    writeTransforms(
+        m_static_draw_list, m_static_models, transform_buf, 0,
+        m_static_draw_list.batches()
+    );
+    transform_buf.flush(m_allocator, 0, transform_count);
+    cache.transform_count = transform_count;
+    cache.visibility_version = m_static_visibility_version;
+
+    using enum CullPhase;
+    recordStaticDraws(cache.cmd_buffer, Early, shadingPass());
+    if (m_features.depth_prepass) {
+        recordStaticDraws(cache.depth_cmd_buffer, Early, MaterialPass::Depth);
+    }
+    if (m_features.occlusion_culling) {
+        recordStaticDraws(cache.late_cmd_buffer, Late, shadingPass());
+        if (m_features.depth_prepass) {
+            recordStaticDraws(
+                cache.late_depth_cmd_buffer, Late, MaterialPass::Depth
+            );
+        }
+    }
+    cache.valid = true;
+}
+
+// CPU culled and cluster culled models are only drawn in the early phase
+void SceneImpl::recordStaticDraws(
+    VkCommandBuffer cmd_buffer, CullPhase phase, MaterialPass pass
+) {
+    beginSecondary(cmd_buffer, 0, pass);
+    if (phase == CullPhase::Early) {
+        recordDraws(
+            cmd_buffer, m_static_draw_list, 0,
+            m_static_draw_list.batches(), pass
+        );
+    }
+    if (m_features.gpu_culling) {
+        recordGPUCulledDraws(cmd_buffer, phase, pass);
+    }
+    if (m_features.cluster_culling and phase == CullPhase::Early) {
+        recordClusterCulledDraws(cmd_buffer, pass);
+    }
+    vkEndCommandBuffer(cmd_buffer);
+}
+
+void SceneImpl::recordDynamicDraws(size_t thread_idx) {
+    const auto& thread = m_recording_threads[thread_idx];
+
+    // Split batches into contiguous chunks with about the same number of
+    // packets. The split only depends on the draw list, so the recorded
+    // commands are the same from frame to frame.
+    auto batches = m_draw_list.batches();
+    auto packet_count = m_draw_list.visiblePackets().size();
+    auto thread_count = m_recording_threads.size();
+    auto chunkStart = [&](size_t chunk) {
+        auto first_packet = packet_count * chunk / thread_count;
+        return std::ranges::partition_point(batches, [&](const DrawBatch& b) {
+            return b.first < first_packet;
+        });
+    };
+    std::span<const DrawBatch> chunk = {
+        chunkStart(thread_idx), chunkStart(thread_idx + 1)
+    };
+    auto transform_base = m_static_caches[m_cur_img].transform_count;
+    writeTransforms(
+        m_draw_list, m_dynamic_models,
+        m_transform_bufs[m_cur_img], transform_base, chunk
+    );
+
+    auto record = [&](VkCommandBuffer cmd_buffer, MaterialPass pass) {
+        beginSecondary(
+            cmd_buffer, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, pass
+        );
+        recordDraws(cmd_buffer, m_draw_list, transform_base, chunk, pass);
+        vkEndCommandBuffer(cmd_buffer);
+    };
+    record(thread.cmd_bufs[m_cur_img], shadingPass());
+    if (m_features.depth_prepass) {
+        record(thread.depth_cmd_bufs[m_cur_img], MaterialPass::Depth);
+    }
+}
+
+void SceneImpl::writeTransforms(
+    const DrawList& draw_list, const ModelStorage& models,
+    TransformBuffer& transform_buf, uint32_t transform_base,
+    std::span<const DrawBatch> batches
+) {
+    if (batches.empty()) {
+        return;
+    }
+
+    // Each thread writes the transforms of its own batches. The CPU never
+    // reads them back, so they bypass the cache.
+    auto packets = draw_list.visiblePackets();
+    auto first_packet = batches.front().first;
+    auto last_packet = batches.back().first + batches.back().count;
+    auto transforms = transform_buf.transforms + transform_base;
+    for (auto i = first_packet; i < last_packet; i++) {
+        const auto& p = packets[i];
+        const auto& t = models.transform(p.model);
+        if (getMeshStorageFormat(p.mesh) == MeshStorageFormat::Static) {
+            const auto& mesh = getStaticMesh(p.mesh);
+            if (mesh.vertex_format != VertexFormat::Float) {
+                auto dt = mesh.drawTransform(t);
+                Simd::streamStore(&transforms[i][0][0], &dt[0][0], 16);
+                continue;
+            }
+        }
+        Simd::streamStore(&transforms[i][0][0], &t[0][0], 16);
+    }
+    Simd::streamFence();
+}
+
+void SceneImpl::recordDraws(
+    VkCommandBuffer cmd_buffer,
+    const DrawList& draw_list, uint32_t transform_base,
+    std::span<const DrawBatch> batches, MaterialPass pass
+) {
+    if (batches.empty()) {
+        return;
+    }
+
+    // All material pipeline layouts are compatible for push constants
+    m_mats.front().setTransformBase(cmd_buffer, transform_base);
+
+    auto packets = draw_list.visiblePackets();
+    const DrawPacket* prev = nullptr;
+    auto prev_format = VertexFormat::Float;
+    StaticMeshBindings bindings;
+    for (const auto& b: batches) {
+        const auto& p = packets[b.first];
+
+        auto storage_format = getMeshStorageFormat(p.mesh);
+        auto vertex_format = storage_format == MeshStorageFormat::Static ?
+            getStaticMesh(p.mesh).vertex_format : VertexFormat::Float;
+        if (
+            !prev or prev->material != p.material or
+            prev_format != vertex_format
+        ) {
+            getMaterial(p.material).bind(cmd_buffer, pass, vertex_format);
+        }
+
+        using enum MeshStorageFormat;
+        switch (storage_format) {
+            case Static: {
+                auto& mesh = getStaticMesh(p.mesh);
+                bindings.bind(cmd_buffer, m_geometry_pools, mesh);
+                mesh.draw(cmd_buffer, p.lod, b.count, b.first);
+                break;
+            }
+            case Dynamic: {
+                auto& mesh = getDynamicMesh(p.mesh);
+                if (!prev or prev->mesh != p.mesh) {
+                    mesh.bind(cmd_buffer);
+                }
+                bindings.invalidateVertices();
+                mesh.draw(cmd_buffer, b.count, b.first);
+                break;
+            }
+        }
+
+        prev = &p;
+        prev_format = vertex_format;
+    }
+}
+
+void SceneImpl::recordGPUCulledDraws(
+    VkCommandBuffer cmd_buffer, CullPhase phase, MaterialPass pass
+) {
+    auto buckets = m_gpu_culling.buckets();
+    if (buckets.empty()) {
+        return;
+    }
+
+    // Generated draws use the model index as their first instance
+    m_mats.front().bindFrameSet(cmd_buffer, m_gpu_culled_frame_sets[m_cur_img]);
+    m_mats.front().setTransformBase(cmd_buffer, 0);
+
+    const GPUCullingBucket* prev = nullptr;
+    auto prev_format = VertexFormat::Float;
+    StaticMeshBindings bindings;
+    for (size_t i = 0; i < buckets.size(); i++) {
+        const auto& b = buckets[i];
+        auto vertex_format = b.buffers.vertex_format;
+        if (
+            !prev or prev->material != b.material or
+            prev_format != vertex_format
+        ) {
+            getMaterial(b.material).bind(cmd_buffer, pass, vertex_format);
+        }
+        bindings.bind(cmd_buffer, m_geometry_pools, b.buffers);
+        m_gpu_culling.drawBucket(cmd_buffer, m_cur_img, phase, i);
+        prev = &b;
+        prev_format = vertex_format;
+    }
+}
+
+void SceneImpl::recordClusterCulledDraws(
+    VkCommandBuffer cmd_buffer, MaterialPass pass
+) {
+    auto buckets = m_cluster_culling.buckets();
+    if (buckets.empty()) {
+        return;
+    }
+
+    // Like GPU culled draws, cluster draws use the model index as their
+    // first instance
+    m_mats.front().bindFrameSet(cmd_buffer, m_gpu_culled_frame_sets[m_cur_img]);
+    m_mats.front().setTransformBase(cmd_buffer, 0);
+    m_cluster_culling.bindIndexBuffer(cmd_buffer, m_cur_img);
+
+    // Cluster draws use the index buffer of cluster culling
+    const ClusterCullingBucket* prev = nullptr;
+    auto prev_format = VertexFormat::Float;
+    StaticMeshBindings bindings;
+    for (size_t i = 0; i < buckets.size(); i++) {
+        const auto& b = buckets[i];
+        if (
+            !prev or prev->material != b.material or
+            prev_format != b.vertex_format
+        ) {
+            getMaterial(b.material).bind(cmd_buffer, pass, b.vertex_format);
+        }
+        bindings.bindVertices(
+            cmd_buffer, m_geometry_pools, b.vertex_format, b.vertex_block
+        );
+        m_cluster_culling.drawBucket(cmd_buffer, m_cur_img, i);
+        prev = &b;
+        prev_format = b.vertex_format;
+    }
+}
+
 glm::mat4 SceneImpl::getView() const {
     return glm::lookAt(
         m_camera.m_position,
@@ -834,6 +2330,36 @@ MeshID Scene::createMesh(
     );
 }
 
+MeshID Scene::createMesh(
+    MeshStorageFormat storage_format,
+    std::span<const glm::vec3> vertices,
+    std::span<const uint32_t> indices
+) {
+    return static_cast<SceneImpl*>(this)->createMesh(
+        storage_format, vertices, indices
+    );
+}
+
+MeshID Scene::createMesh(
+    MeshStorageFormat storage_format,
+    std::span<const glm::vec3> vertices,
+    const MeshLODGeneration& lod_generation
+) {
+    return static_cast<SceneImpl*>(this)->createMesh(
+        storage_format, vertices, lod_generation
+    );
+}
+
+void Scene::createMeshes(
+    MeshStorageFormat storage_format,
+    std::span<const std::span<const glm::vec3>> vertices,
+    std::span<MeshID> meshes
+) {
+    static_cast<SceneImpl*>(this)->createMeshes(
+        storage_format, vertices, meshes
+    );
+}
+
 MeshID Scene::createMesh(
     MeshStorageFormat storage_format,
     uint32_t vertex_count
@@ -843,6 +2369,13 @@ MeshID Scene::createMesh(
     );
 }
 
+MeshID Scene::createMesh(
+    MeshStorageFormat storage_format,
+    std::span<const MeshLOD> lods
+) {
+    return static_cast<SceneImpl*>(this)->createMesh(storage_format, lods);
+}
+
 void Scene::setMeshVertexData(
     MeshID mesh,
     std::span<const glm::vec3> vertices
@@ -860,6 +2393,17 @@ MaterialID Scene::createMaterial(
     );
 }
 
+void Scene::setMeshOccluder(
+    MeshID mesh,
+    std::span<const glm::vec3> triangles
+) {
+    static_cast<SceneImpl*>(this)->setMeshOccluder(mesh, triangles);
+}
+
+float Scene::getMeshQuantizationError(MeshID mesh) const {
+    return static_cast<const SceneImpl*>(this)->getMeshQuantizationError(mesh);
+}
+
 ModelID Scene::createModel(
     MeshID mesh,
     MaterialID material,
@@ -870,12 +2414,49 @@ ModelID Scene::createModel(
     );
 }
 
+void Scene::createModels(
+    std::span<const MeshID> meshes,
+    std::span<const MaterialID> materials,
+    StridedSpan<glm::mat4> transforms,
+    std::span<ModelID> models
+) {
+    static_cast<SceneImpl*>(this)->createModels(
+        meshes, materials, transforms, models
+    );
+}
+
 void Scene::destroyModel(
     ModelID model
 ) {
     static_cast<SceneImpl*>(this)->destroyModel(model);
 }
 
+void Scene::destroyModels(
+    std::span<const ModelID> models
+) {
+    static_cast<SceneImpl*>(this)->destroyModels(models);
+}
+
+void Scene::setModelOccluder(
+    ModelID model,
+    bool occluder
+) {
+    static_cast<SceneImpl*>(this)->setModelOccluder(model, occluder);
+}
+
+void Scene::setModelParent(
+    ModelID model,
+    ModelID parent
+) {
+    static_cast<SceneImpl*>(this)->setModelParent(model, parent);
+}
+
+void Scene::clearModelParent(
+    ModelID model
+) {
+    static_cast<SceneImpl*>(this)->clearModelParent(model);
+}
+
 void Scene::getModelTransform(
     ModelID model
 ) const {
@@ -889,6 +2470,13 @@ void Scene::setModelTransform(
     static_cast<SceneImpl*>(this)->setModelTransform(model, trans);
 }
 
+void Scene::setModelTransforms(
+    std::span<const ModelID> models,
+    StridedSpan<glm::mat4> transforms
+) {
+    static_cast<SceneImpl*>(this)->setModelTransforms(models, transforms);
+}
+
 std::tuple<uint32_t, uint32_t> Scene::getViewport() const {
     return static_cast<const SceneImpl*>(this)->getViewport();
 }
@@ -899,4 +2487,8 @@ void Scene::setViewport(uint32_t width, uint32_t height) {
 void Scene::draw(Vulkan::ISwapchain* swapchain) {
     static_cast<SceneImpl*>(this)->draw(swapchain);
 }
+
+const FrameStats& Scene::getFrameStats() const {
+    return static_cast<const SceneImpl*>(this)->getFrameStats();
+}
 }
@@ -1,12 +1,24 @@
 #pragma once
+#include "BVH.hpp"
+#include "ClusterCulling.hpp"
+#include "Culling.hpp"
+#include "DepthPyramid.hpp"
+#include "DrawList.hpp"
+#include "GPUCulling.hpp"
 #include "Image.hpp"
+#include "JobQueue.hpp"
 #include "Material.hpp"
 #include "Mesh.hpp"
 #include "Model.hpp"
+#include "OcclusionBuffer.hpp"
 #include "Queues.hpp"
+#include "Simplify.hpp"
+#include "ThreadPool.hpp"
+#include "TransformHierarchy.hpp"
+#include "Uploader.hpp"
 #include "VKRVulkan.hpp"
 
-#include <stack>
+#include <future>
 #include <vector>
 
 namespace VKR {
@@ -35,6 +47,10 @@ class SceneImpl: public VKR::Scene {
     VkImageView m_depth_view = VK_NULL_HANDLE;
 
     VkRenderPass m_render_pass = VK_NULL_HANDLE;
+    // Draws the early phase of occlusion culling, after which
+    // m_render_pass continues with the late phase
+    VkRenderPass m_early_render_pass = VK_NULL_HANDLE;
+    DepthPyramid m_depth_pyramid;
 
     std::array<VkFramebuffer, c_img_cnt> m_fbs = {
         VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE,
@@ -45,19 +61,105 @@ class SceneImpl: public VKR::Scene {
 
     std::vector<StaticMesh> m_static_meshes;
     std::vector<DynamicMesh> m_dynamic_meshes;
+    GeometryPools m_geometry_pools;
+    PositionQuantizationPolicy m_position_quantization;
+    Uploader m_uploader;
+    // Static meshes with models whose geometry the graphics queue hasn't
+    // acquired yet. The next frame acquires them.
+    std::vector<MeshID> m_unacquired_meshes;
+    // Meshes replaced while frames in flight may still read their
+    // geometry. They are freed once the frame's fence is waited on again.
+    std::array<std::vector<StaticMesh>, c_img_cnt> m_retired_meshes;
+
+    // Meshes whose levels of detail are being generated. Finished chains
+    // replace the mesh's single level at the start of a frame. Geometry
+    // without levels means that simplification failed.
+    struct PendingLODs {
+        MeshID mesh;
+        std::future<StaticMeshGeometry> lods;
+    };
+    std::vector<PendingLODs> m_pending_lods;
+    JobQueue m_lod_jobs;
 
     std::vector<Material> m_mats;
 
-    std::vector<StaticModel> m_static_models;
-    std::vector<DynamicModel> m_dynamic_models;
-
-    std::stack<Detail::modelid> m_static_model_id_pool;
-    std::stack<Detail::modelid> m_dynamic_model_id_pool;
+    ModelStorage m_static_models;
+    ModelStorage m_dynamic_models;
+    TransformHierarchy m_hierarchy;
+
+    SceneCreationFeatures m_features;
+
+    DrawList m_draw_list;
+    std::vector<glm::vec4> m_model_spheres;
+    std::vector<float> m_view_depths;
+    SphereBoundsSoA m_cull_bounds;
+    std::vector<uint8_t> m_cull_visibility;
+    BVH m_dynamic_bvh;
+    // Static bounds only change when static models do, so their tree is
+    // rebuilt together with the static draw list
+    SphereBoundsSoA m_static_cull_bounds;
+    std::vector<uint8_t> m_static_cull_visibility;
+    // Visibility the static draw list was last compacted with
+    std::vector<uint8_t> m_static_visibility;
+    uint64_t m_static_visibility_version = 0;
+    BVH m_static_bvh;
+    OcclusionBuffer m_occlusion_buffer;
+    // Model matrices of all CPU recorded draws. Static draws occupy the
+    // front of the buffer, followed by dynamic draws.
+    std::array<TransformBuffer, c_img_cnt> m_transform_bufs;
+
+    GPUCulling m_gpu_culling;
+    ClusterCulling m_cluster_culling;
 
     std::array<VkCommandBuffer, c_img_cnt> m_cmd_bufs = {
         VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE,
     };
 
+    // Each recording thread has its own pool per frame in flight, so pools
+    // are never shared between threads and are reset as a whole
+    struct RecordingThread {
+        std::array<VkCommandPool, c_img_cnt> cmd_pools = {
+            VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE,
+        };
+        std::array<VkCommandBuffer, c_img_cnt> cmd_bufs = {
+            VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE,
+        };
+        // The same draws for the depth pre-pass
+        std::array<VkCommandBuffer, c_img_cnt> depth_cmd_bufs = {
+            VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE,
+        };
+    };
+    std::vector<RecordingThread> m_recording_threads;
+    ThreadPool m_thread_pool;
+
+    // Static models are recorded once per framebuffer and re-recorded only
+    // when one of them changes
+    struct StaticDrawCache {
+        VkCommandPool cmd_pool = VK_NULL_HANDLE;
+        VkCommandBuffer cmd_buffer = VK_NULL_HANDLE;
+        // Draws of the late occlusion culling phase
+        VkCommandBuffer late_cmd_buffer = VK_NULL_HANDLE;
+        // Depth pre-pass draws of both phases
+        VkCommandBuffer depth_cmd_buffer = VK_NULL_HANDLE;
+        VkCommandBuffer late_depth_cmd_buffer = VK_NULL_HANDLE;
+        uint32_t transform_count = 0;
+        uint64_t visibility_version = 0;
+        bool valid = false;
+    };
+    std::array<StaticDrawCache, c_img_cnt> m_static_caches;
+    DrawList m_static_draw_list;
+
+    VkDescriptorSetLayout m_frame_set_layout = VK_NULL_HANDLE;
+    VkDescriptorPool m_frame_descriptor_pool = VK_NULL_HANDLE;
+    std::array<VkDescriptorSet, c_img_cnt> m_frame_sets = {
+        VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE,
+    };
+    // Same as the frame sets, but with GPU culling's transforms
+    std::array<VkDescriptorSet, c_img_cnt> m_gpu_culled_frame_sets = {
+        VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE,
+    };
+    std::array<Buffer, c_img_cnt> m_frame_uniform_bufs;
+
     std::array<VkSemaphore, c_img_cnt> m_dst_sems = {
         VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE,
     };
@@ -65,14 +167,23 @@ class SceneImpl: public VKR::Scene {
         VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE,
     };
 
+    // Samples passing the depth test of every subpass with a depth
+    // pre-pass: early pre-pass, early shading, pre-pass and shading
+    static constexpr uint32_t c_sample_queries = 4;
+    VkQueryPool m_sample_query_pool = VK_NULL_HANDLE;
+    std::array<bool, c_img_cnt> m_samples_counted = {};
+
     float m_near = 0.1;
     float m_far = 100.0f;
 
+    FrameStats m_frame_stats;
+
 public:
     SceneImpl(
         const Camera& cam,
         const Device& dev,
-        uint32_t width, uint32_t height
+        uint32_t width, uint32_t height,
+        const SceneCreationFeatures& conf
     );
     SceneImpl(const Scene& other) = delete;
     SceneImpl(Scene&& other);
@@ -91,11 +202,34 @@ public:
         std::span<const glm::vec3> vertices
     );
     
+    MeshID createMesh(
+        MeshStorageFormat storage_format,
+        std::span<const glm::vec3> vertices,
+        std::span<const uint32_t> indices
+    );
+
     MeshID createMesh(
         MeshStorageFormat storage_format,
         uint32_t vertex_count 
     );
 
+    MeshID createMesh(
+        MeshStorageFormat storage_format,
+        std::span<const MeshLOD> lods
+    );
+
+    MeshID createMesh(
+        MeshStorageFormat storage_format,
+        std::span<const glm::vec3> vertices,
+        const MeshLODGeneration& lod_generation
+    );
+
+    void createMeshes(
+        MeshStorageFormat storage_format,
+        std::span<const std::span<const glm::vec3>> vertices,
+        std::span<MeshID> meshes
+    );
+
     void setMeshVertexData(
         MeshID mesh,
         std::span<const glm::vec3> vertices
@@ -106,29 +240,68 @@ public:
         std::span<const std::byte> frag_shader_binary
     );
 
+    void setMeshOccluder(
+        MeshID mesh,
+        std::span<const glm::vec3> triangles
+    );
+
+    float getMeshQuantizationError(MeshID mesh) const;
+
     ModelID createModel(
         MeshID mesh,
         MaterialID material,
         const glm::mat4& t
     );
 
+    void createModels(
+        std::span<const MeshID> meshes,
+        std::span<const MaterialID> materials,
+        StridedSpan<glm::mat4> transforms,
+        std::span<ModelID> models
+    );
+
     void destroyModel(ModelID model);
+    void destroyModels(std::span<const ModelID> models);
 
     void setModelTransform(
         ModelID model,
         const glm::mat4& t
     );
 
+    void setModelTransforms(
+        std::span<const ModelID> models,
+        StridedSpan<glm::mat4> transforms
+    );
+
+    void setModelParent(ModelID model, ModelID parent);
+    void clearModelParent(ModelID model);
+
+    void setModelOccluder(ModelID model, bool occluder);
+
     std::tuple<uint32_t, uint32_t> getViewport() const;
     void setViewport(uint32_t width, uint32_t height);
 
     void draw(Vulkan::ISwapchain* swapchain);
 
+    const FrameStats& getFrameStats() const {
+        return m_frame_stats;
+    }
+
 private:
     // TODO: enum-based polymorphism sucks
     StaticMesh& getStaticMesh(MeshID mesh);
     std::tuple<MeshID, StaticMesh*> getNewStaticMesh();
-    MeshID createStaticMesh(std::span<const glm::vec3> vertices);
+    MeshID createStaticMesh(std::span<const MeshLOD> lods);
+    MeshID createStaticMesh(
+        StaticMeshGeometry geometry, StaticMeshUploads& uploads
+    );
+    MeshID createStaticMesh(
+        std::span<const glm::vec3> vertices,
+        const MeshLODGeneration& lod_generation
+    );
+    void installGeneratedLODs();
+    void queueStaticMeshAcquire(MeshID id);
+    uint64_t acquireStaticMeshes(VkCommandBuffer cmd_buffer);
 
     DynamicMesh& getDynamicMesh(MeshID mesh);
     std::tuple<MeshID, DynamicMesh*> getNewDynamicMesh();
@@ -137,30 +310,37 @@ private:
 
     Material& getMaterial(MaterialID material);
 
-    StaticModel& getStaticModel(ModelID model);
-    std::tuple<ModelID, StaticModel*> getNewStaticModel();
-    void returnStaticModelIDToPool(Detail::modelid id);
-    ModelID createStaticModel(
-        MeshID mesh,
-        MaterialID material, const glm::mat4& t
+    void writeModelTransforms(
+        std::span<const ModelID> models,
+        StridedSpan<glm::mat4> transforms
     );
-    void destroyStaticModel(ModelID id);
-    void setStaticModelTransform(
-        ModelID id,
-        const glm::mat4& t
+    const glm::mat4& getModelTransformRef(ModelID model) const;
+    void updateHierarchy();
+
+    size_t getStaticModelIndex(ModelID model) const;
+    void createStaticModels(
+        std::span<const MeshID> meshes,
+        std::span<const MaterialID> materials,
+        StridedSpan<glm::mat4> transforms,
+        std::span<ModelID> models
+    );
+    void destroyStaticModels(std::span<const ModelID> models);
+    void setStaticModelTransforms(
+        std::span<const ModelID> models,
+        StridedSpan<glm::mat4> transforms
     );
 
-    DynamicModel& getDynamicModel(ModelID model);
-    std::tuple<ModelID, DynamicModel*> getNewDynamicModel();
-    void returnDynamicModelIDToPool(Detail::modelid id);
-    ModelID createDynamicModel(
-        MeshID mesh,
-        MaterialID material, const glm::mat4& t
+    size_t getDynamicModelIndex(ModelID model) const;
+    void createDynamicModels(
+        std::span<const MeshID> meshes,
+        std::span<const MaterialID> materials,
+        StridedSpan<glm::mat4> transforms,
+        std::span<ModelID> models
     );
-    void destroyDynamicModel(ModelID id);
-    void setDynamicModelTransform(
-        ModelID id,
-        const glm::mat4& t
+    void destroyDynamicModels(std::span<const ModelID> models);
+    void setDynamicModelTransforms(
+        std::span<const ModelID> models,
+        StridedSpan<glm::mat4> transforms
     );
 
     VkSemaphore draw(
@@ -172,6 +352,56 @@ private:
         Vulkan::LayoutTransitionFromTransferDstInserter from_ins
     );
 
+    const MeshBounds& getMeshBounds(MeshID mesh);
+    std::span<const glm::vec3> getMeshOccluder(MeshID mesh);
+    void rasterizeOccluders(const glm::mat4& proj_view);
+    size_t cullOccluded(
+        const glm::mat4& proj_view,
+        const SphereBoundsSoA& bounds,
+        std::vector<uint8_t>& visible
+    );
+    void updateDrawList(const glm::mat4& proj_view);
+    void invalidateStaticDraws();
+    void updateFrameUniforms(const glm::mat4& proj_view);
+    void readSampleCounts();
+    MaterialPass shadingPass() const;
+    void beginSecondary(
+        VkCommandBuffer cmd_buffer, VkCommandBufferUsageFlags flags,
+        MaterialPass pass
+    );
+    void updateStaticDrawList(const glm::mat4& proj_view);
+    bool updateStaticLODs();
+    void recordStaticDraws();
+    void recordStaticDraws(
+        VkCommandBuffer cmd_buffer, CullPhase phase, MaterialPass pass
+    );
+    void recordDynamicDraws(size_t thread_idx);
+    void writeTransforms(
+        const DrawList& draw_list, const ModelStorage& models,
+        TransformBuffer& transform_buf, uint32_t transform_base,
+        std::span<const DrawBatch> batches
+    );
+    void recordDraws(
+        VkCommandBuffer cmd_buffer,
+        const DrawList& draw_list, uint32_t transform_base,
+        std::span<const DrawBatch> batches, MaterialPass pass
+    );
+    void recordClusterCulledDraws(
+        VkCommandBuffer cmd_buffer, MaterialPass pass
+    );
+    void recordGPUCulledDraws(
+        VkCommandBuffer cmd_buffer, CullPhase phase, MaterialPass pass
+    );
+    void beginRenderPass(VkCommandBuffer cmd_buffer, VkRenderPass render_pass);
+    void executeSecondaries(
+        VkCommandBuffer cmd_buffer,
+        std::span<const VkCommandBuffer> secondaries,
+        uint32_t sample_query
+    );
+
+    // Camera position in xyz, and w scales model space error at unit
+    // distance to multiples of the pixel error threshold
+    glm::vec4 getLODCamera() const;
     glm::mat4 getProj() const;
     glm::mat4 getView() const;
 };
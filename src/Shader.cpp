@@ -0,0 +1,21 @@
+#include "Shader.hpp"
+
+namespace VKR {
+VkShaderModule createShaderModule(
+    VkDevice device,
+    std::span<const std::byte> shader_binary
+) {
+    VkShaderModuleCreateInfo create_info = {
+        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+        .codeSize = shader_binary.size_bytes(),
+        .pCode = reinterpret_cast<const uint32_t*>(
+            shader_binary.data()
+        ),
+    };
+
+    VkShaderModule shader_module;
+    vkCreateShaderModule(device, &create_info, nullptr, &shader_module);
+
+    return shader_module;
+}
+}
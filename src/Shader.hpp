@@ -0,0 +1,20 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <span>
+
+namespace VKR {
+[[nodiscard]]
+VkShaderModule createShaderModule(
+    VkDevice device,
+    std::span<const std::byte> shader_binary
+);
+
+[[nodiscard]]
+inline VkShaderModule createShaderModule(
+    VkDevice device,
+    std::span<const uint32_t> shader_binary
+) {
+    return createShaderModule(device, std::as_bytes(shader_binary));
+}
+}
@@ -0,0 +1,137 @@
+#pragma once
+#if defined(__AVX2__) or defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include <cmath>
+#include <cstddef>
+
+namespace VKR::Simd {
+#if defined(__AVX2__)
+using Float = __m256;
+using Mask = __m256;
+inline constexpr size_t c_width = 8;
+
+inline Float load(const float* p) { return _mm256_loadu_ps(p); }
+inline void store(float* p, Float v) { _mm256_storeu_ps(p, v); }
+inline Float set1(float f) { return _mm256_set1_ps(f); }
+inline Float gather(const float* p, int stride) {
+    auto idx = _mm256_mullo_epi32(
+        _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(stride)
+    );
+    return _mm256_i32gather_ps(p, idx, sizeof(float));
+}
+inline Float min(Float a, Float b) { return _mm256_min_ps(a, b); }
+inline Float max(Float a, Float b) { return _mm256_max_ps(a, b); }
+inline Float add(Float a, Float b) { return _mm256_add_ps(a, b); }
+inline Float sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+inline Float mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+inline Float div(Float a, Float b) { return _mm256_div_ps(a, b); }
+inline Float sqrt(Float a) { return _mm256_sqrt_ps(a); }
+inline Float round(Float a) {
+    return _mm256_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+}
+#if defined(__FMA__)
+inline Float fmadd(Float a, Float b, Float c) { return _mm256_fmadd_ps(a, b, c); }
+#else
+inline Float fmadd(Float a, Float b, Float c) { return add(mul(a, b), c); }
+#endif
+inline Mask cmpge(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+inline Mask cmplt(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+inline Mask maskAnd(Mask a, Mask b) { return _mm256_and_ps(a, b); }
+inline Mask maskOr(Mask a, Mask b) { return _mm256_or_ps(a, b); }
+inline Mask maskTrue() { return _mm256_castsi256_ps(_mm256_set1_epi32(-1)); }
+inline unsigned movemask(Mask m) { return _mm256_movemask_ps(m); }
+inline Float select(Mask m, Float a, Float b) { return _mm256_blendv_ps(b, a, m); }
+#elif defined(__SSE2__)
+using Float = __m128;
+using Mask = __m128;
+inline constexpr size_t c_width = 4;
+
+inline Float load(const float* p) { return _mm_loadu_ps(p); }
+inline void store(float* p, Float v) { _mm_storeu_ps(p, v); }
+inline Float set1(float f) { return _mm_set1_ps(f); }
+inline Float gather(const float* p, int stride) {
+    return _mm_setr_ps(p[0], p[stride], p[2 * stride], p[3 * stride]);
+}
+inline Float min(Float a, Float b) { return _mm_min_ps(a, b); }
+inline Float max(Float a, Float b) { return _mm_max_ps(a, b); }
+inline Float add(Float a, Float b) { return _mm_add_ps(a, b); }
+inline Float sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+inline Float mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+inline Float div(Float a, Float b) { return _mm_div_ps(a, b); }
+inline Float sqrt(Float a) { return _mm_sqrt_ps(a); }
+// Only for values that fit in an int32
+inline Float round(Float a) { return _mm_cvtepi32_ps(_mm_cvtps_epi32(a)); }
+inline Float fmadd(Float a, Float b, Float c) { return add(mul(a, b), c); }
+inline Mask cmpge(Float a, Float b) { return _mm_cmpge_ps(a, b); }
+inline Mask cmplt(Float a, Float b) { return _mm_cmplt_ps(a, b); }
+inline Mask maskAnd(Mask a, Mask b) { return _mm_and_ps(a, b); }
+inline Mask maskOr(Mask a, Mask b) { return _mm_or_ps(a, b); }
+inline Mask maskTrue() { return _mm_castsi128_ps(_mm_set1_epi32(-1)); }
+inline unsigned movemask(Mask m) { return _mm_movemask_ps(m); }
+inline Float select(Mask m, Float a, Float b) {
+    return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b));
+}
+#else
+using Float = float;
+using Mask = bool;
+inline constexpr size_t c_width = 1;
+
+inline Float load(const float* p) { return *p; }
+inline void store(float* p, Float v) { *p = v; }
+inline Float set1(float f) { return f; }
+inline Float gather(const float* p, int stride) { return *p; }
+inline Float min(Float a, Float b) { return b < a ? b : a; }
+inline Float max(Float a, Float b) { return a < b ? b : a; }
+inline Float add(Float a, Float b) { return a + b; }
+inline Float sub(Float a, Float b) { return a - b; }
+inline Float mul(Float a, Float b) { return a * b; }
+inline Float div(Float a, Float b) { return a / b; }
+inline Float sqrt(Float a) { return std::sqrt(a); }
+inline Float round(Float a) { return std::nearbyint(a); }
+inline Float fmadd(Float a, Float b, Float c) { return a * b + c; }
+inline Mask cmpge(Float a, Float b) { return a >= b; }
+inline Mask cmplt(Float a, Float b) { return a < b; }
+inline Mask maskAnd(Mask a, Mask b) { return a and b; }
+inline Mask maskOr(Mask a, Mask b) { return a or b; }
+inline Mask maskTrue() { return true; }
+inline unsigned movemask(Mask m) { return m; }
+inline Float select(Mask m, Float a, Float b) { return m ? a : b; }
+#endif
+
+inline void copy(float* dst, const float* src, size_t count) {
+    size_t i = 0;
+    for (; i + c_width <= count; i += c_width) {
+        store(dst + i, load(src + i));
+    }
+    for (; i < count; i++) {
+        dst[i] = src[i];
+    }
+}
+
+// Copies with non-temporal stores that bypass the cache, for data that is
+// only read by the GPU. dst must be 16 byte aligned.
+inline void streamStore(float* dst, const float* src, size_t count) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 4 <= count; i += 4) {
+        _mm_stream_ps(dst + i, _mm_loadu_ps(src + i));
+    }
+#endif
+    for (; i < count; i++) {
+        dst[i] = src[i];
+    }
+}
+
+// Orders preceding non-temporal stores before later stores
+inline void streamFence() {
+#if defined(__SSE2__)
+    _mm_sfence();
+#endif
+}
+
+inline constexpr size_t roundUp(size_t count) {
+    return (count + c_width - 1) / c_width * c_width;
+}
+}
@@ -0,0 +1,375 @@
+#include "Simplify.hpp"
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <tuple>
+#include <unordered_map>
+
+namespace VKR {
+namespace {
+struct PositionHash {
+    size_t operator()(const glm::vec3& p) const {
+        uint32_t bits[3];
+        std::memcpy(bits, &p, sizeof(bits));
+        return
+            (size_t(bits[0]) * 73856093 ^
+            size_t(bits[1]) * 19349663 ^
+            size_t(bits[2]) * 83492791) * 0x9E3779B97F4A7C15 >> 16;
+    }
+};
+
+// Weighted sum of squared distances to a set of planes, as the upper
+// triangle of a symmetric 4x4 matrix
+struct Quadric {
+    double a2 = 0, ab = 0, ac = 0, ad = 0;
+    double b2 = 0, bc = 0, bd = 0;
+    double c2 = 0, cd = 0;
+    double d2 = 0;
+    double weight = 0;
+
+    static Quadric plane(const glm::vec3& n, float d, double weight) {
+        double a = n.x, b = n.y, c = n.z, e = d;
+        return {
+            weight * a * a, weight * a * b, weight * a * c, weight * a * e,
+            weight * b * b, weight * b * c, weight * b * e,
+            weight * c * c, weight * c * e,
+            weight * e * e,
+            weight,
+        };
+    }
+
+    Quadric& operator+=(const Quadric& q) {
+        a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+        b2 += q.b2; bc += q.bc; bd += q.bd;
+        c2 += q.c2; cd += q.cd;
+        d2 += q.d2;
+        weight += q.weight;
+        return *this;
+    }
+
+    // Mean squared distance, so that errors don't grow with the number of
+    // merged planes
+    double evaluate(const glm::vec3& p) const {
+        if (weight == 0) {
+            return 0;
+        }
+        double x = p.x, y = p.y, z = p.z;
+        auto sum =
+            a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x +
+            b2 * y * y + 2 * bc * y * z + 2 * bd * y +
+            c2 * z * z + 2 * cd * z +
+            d2;
+        return std::max(sum / weight, 0.0);
+    }
+};
+
+// Borders have no triangle on the other side to hold them in place, so
+// they get a heavily weighted plane through the edge, perpendicular to the
+// triangle
+constexpr double c_border_weight = 16.0;
+
+// Collapses that turn a triangle by more than this are rejected
+constexpr float c_min_normal_cos = 0.25f;
+
+struct Collapse {
+    double cost;
+    uint32_t from;
+    uint32_t to;
+    uint32_t from_version;
+    uint32_t to_version;
+
+    bool operator>(const Collapse& other) const {
+        return cost > other.cost;
+    }
+};
+
+class Simplifier {
+    std::vector<glm::vec3> m_positions;
+    std::vector<uint32_t> m_indices;
+    std::vector<Quadric> m_quadrics;
+    // Triangles around every vertex, including removed ones
+    std::vector<std::vector<uint32_t>> m_vertex_triangles;
+    std::vector<uint8_t> m_triangle_alive;
+    std::vector<uint8_t> m_vertex_alive;
+    // Bumped when the quadric or the neighbourhood of a vertex changes,
+    // which invalidates queued collapses
+    std::vector<uint32_t> m_versions;
+    std::priority_queue<
+        Collapse, std::vector<Collapse>, std::greater<Collapse>
+    > m_queue;
+    size_t m_triangle_count = 0;
+    double m_max_cost = 0.0;
+
+public:
+    explicit Simplifier(const IndexedMesh& mesh):
+        m_positions(mesh.positions),
+        m_indices(mesh.indices),
+        m_quadrics(mesh.positions.size()),
+        m_vertex_triangles(mesh.positions.size()),
+        m_triangle_alive(mesh.indices.size() / 3, true),
+        m_vertex_alive(mesh.positions.size(), true),
+        m_versions(mesh.positions.size(), 0),
+        m_triangle_count(mesh.indices.size() / 3)
+    {
+        computeQuadrics();
+        for (size_t t = 0; t < m_triangle_count; t++) {
+            for (int e = 0; e < 3; e++) {
+                pushCollapse(
+                    m_indices[3 * t + e], m_indices[3 * t + (e + 1) % 3]
+                );
+            }
+        }
+    }
+
+    size_t triangleCount() const {
+        return m_triangle_count;
+    }
+
+    // Returns false when no valid collapse is left
+    bool collapseNext() {
+        while (!m_queue.empty()) {
+            auto c = m_queue.top();
+            m_queue.pop();
+            if (
+                !m_vertex_alive[c.from] or !m_vertex_alive[c.to] or
+                m_versions[c.from] != c.from_version or
+                m_versions[c.to] != c.to_version
+            ) {
+                continue;
+            }
+            if (!isValid(c.from, c.to)) {
+                continue;
+            }
+            collapse(c.from, c.to);
+            m_max_cost = std::max(m_max_cost, c.cost);
+            return true;
+        }
+        return false;
+    }
+
+    SimplifiedMesh snapshot() const {
+        SimplifiedMesh mesh = {
+            .error = static_cast<float>(std::sqrt(m_max_cost)),
+        };
+        mesh.vertices.reserve(m_triangle_count * 3);
+        for (size_t t = 0; t < m_triangle_alive.size(); t++) {
+            if (m_triangle_alive[t]) {
+                for (int i = 0; i < 3; i++) {
+                    mesh.vertices.push_back(m_positions[m_indices[3 * t + i]]);
+                }
+            }
+        }
+        return mesh;
+    }
+
+private:
+    void computeQuadrics() {
+        // Edges used by a single triangle are borders
+        std::unordered_map<uint64_t, uint32_t> edge_uses;
+        auto edge_key = [](uint32_t a, uint32_t b) {
+            return (uint64_t(std::min(a, b)) << 32) | std::max(a, b);
+        };
+        for (size_t i = 0; i < m_indices.size(); i++) {
+            auto t = i / 3;
+            auto next = 3 * t + (i + 1) % 3;
+            edge_uses[edge_key(m_indices[i], m_indices[next])]++;
+        }
+
+        for (uint32_t t = 0; t < m_triangle_count; t++) {
+            const auto* tri = &m_indices[3 * t];
+            for (int i = 0; i < 3; i++) {
+                m_vertex_triangles[tri[i]].push_back(t);
+            }
+
+            auto normal = getNormal(tri[0], tri[1], tri[2]);
+            auto length = glm::length(normal);
+            if (length == 0.0f) {
+                continue;
+            }
+            normal /= length;
+            // Planes are weighted by area, length is twice the area
+            auto plane = Quadric::plane(
+                normal, -glm::dot(normal, m_positions[tri[0]]), length
+            );
+            for (int i = 0; i < 3; i++) {
+                m_quadrics[tri[i]] += plane;
+            }
+
+            for (int e = 0; e < 3; e++) {
+                auto a = tri[e];
+                auto b = tri[(e + 1) % 3];
+                if (edge_uses[edge_key(a, b)] != 1) {
+                    continue;
+                }
+                auto border_normal = glm::cross(
+                    m_positions[b] - m_positions[a], normal
+                );
+                auto border_length = glm::length(border_normal);
+                if (border_length == 0.0f) {
+                    continue;
+                }
+                border_normal /= border_length;
+                auto border = Quadric::plane(
+                    border_normal,
+                    -glm::dot(border_normal, m_positions[a]),
+                    c_border_weight * border_length * border_length
+                );
+                m_quadrics[a] += border;
+                m_quadrics[b] += border;
+            }
+        }
+    }
+
+    glm::vec3 getNormal(uint32_t a, uint32_t b, uint32_t c) const {
+        return glm::cross(
+            m_positions[b] - m_positions[a], m_positions[c] - m_positions[a]
+        );
+    }
+
+    // Queues the cheaper direction of the edge
+    void pushCollapse(uint32_t a, uint32_t b) {
+        auto q = m_quadrics[a];
+        q += m_quadrics[b];
+        auto cost_ab = q.evaluate(m_positions[b]);
+        auto cost_ba = q.evaluate(m_positions[a]);
+        auto [from, to, cost] = cost_ab <= cost_ba ?
+            std::tuple(a, b, cost_ab) : std::tuple(b, a, cost_ba);
+        m_queue.push({
+            .cost = cost,
+            .from = from,
+            .to = to,
+            .from_version = m_versions[from],
+            .to_version = m_versions[to],
+        });
+    }
+
+    // Rejects collapses that flip or degenerate a remaining triangle
+    bool isValid(uint32_t from, uint32_t to) const {
+        for (auto t: m_vertex_triangles[from]) {
+            if (!m_triangle_alive[t]) {
+                continue;
+            }
+            const auto* tri = &m_indices[3 * t];
+            if (tri[0] == to or tri[1] == to or tri[2] == to) {
+                continue;
+            }
+            std::array<uint32_t, 3> moved = {tri[0], tri[1], tri[2]};
+            auto before = getNormal(moved[0], moved[1], moved[2]);
+            std::ranges::replace(moved, from, to);
+            auto after = getNormal(moved[0], moved[1], moved[2]);
+            auto lengths = glm::length(before) * glm::length(after);
+            if (
+                lengths == 0.0f or
+                glm::dot(before, after) < c_min_normal_cos * lengths
+            ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void collapse(uint32_t from, uint32_t to) {
+        auto& to_triangles = m_vertex_triangles[to];
+        for (auto t: m_vertex_triangles[from]) {
+            if (!m_triangle_alive[t]) {
+                continue;
+            }
+            auto* tri = &m_indices[3 * t];
+            if (tri[0] == to or tri[1] == to or tri[2] == to) {
+                m_triangle_alive[t] = false;
+                m_triangle_count--;
+                continue;
+            }
+            std::replace(tri, tri + 3, from, to);
+            to_triangles.push_back(t);
+        }
+        m_vertex_triangles[from].clear();
+        m_vertex_alive[from] = false;
+        m_quadrics[to] += m_quadrics[from];
+        m_versions[to]++;
+
+        // Drop removed triangles, and requeue the edges around the vertex
+        // with its new quadric
+        std::erase_if(to_triangles, [&](uint32_t t) {
+            return !m_triangle_alive[t];
+        });
+        for (auto t: to_triangles) {
+            const auto* tri = &m_indices[3 * t];
+            for (int i = 0; i < 3; i++) {
+                if (tri[i] != to) {
+                    pushCollapse(to, tri[i]);
+                }
+            }
+        }
+    }
+};
+}
+
+IndexedMesh weldVertices(std::span<const glm::vec3> vertices) {
+    IndexedMesh mesh;
+    mesh.indices.reserve(vertices.size());
+
+    // Open addressing with linear probing, which is a lot faster than
+    // std::unordered_map for meshes with millions of vertices
+    size_t table_size = 1;
+    while (table_size < 2 * vertices.size()) {
+        table_size *= 2;
+    }
+    constexpr auto empty = UINT32_MAX;
+    std::vector<uint32_t> table(table_size, empty);
+    for (const auto& v: vertices) {
+        // -0 and 0 compare equal, so they must also hash the same
+        auto p = v + glm::vec3(0.0f);
+        auto slot = PositionHash()(p) & (table_size - 1);
+        while (table[slot] != empty and mesh.positions[table[slot]] != p) {
+            slot = (slot + 1) & (table_size - 1);
+        }
+        if (table[slot] == empty) {
+            table[slot] = mesh.positions.size();
+            mesh.positions.push_back(p);
+        }
+        mesh.indices.push_back(table[slot]);
+    }
+    return mesh;
+}
+
+std::vector<SimplifiedMesh> simplifyMesh(
+    const IndexedMesh& mesh,
+    std::span<const size_t> target_triangle_counts
+) {
+    assert(std::ranges::is_sorted(target_triangle_counts, std::greater()));
+    std::vector<SimplifiedMesh> meshes;
+    Simplifier simplifier(mesh);
+    auto prev_count = simplifier.triangleCount();
+    for (auto target: target_triangle_counts) {
+        // A level without triangles would make models vanish instead of
+        // showing their coarsest mesh
+        target = std::max<size_t>(target, 1);
+        bool reached = true;
+        while (simplifier.triangleCount() > target) {
+            if (!simplifier.collapseNext()) {
+                reached = false;
+                break;
+            }
+        }
+        if (simplifier.triangleCount() == 0) {
+            break;
+        }
+        if (simplifier.triangleCount() < prev_count) {
+            meshes.push_back(simplifier.snapshot());
+            prev_count = simplifier.triangleCount();
+        }
+        if (!reached) {
+            break;
+        }
+    }
+    return meshes;
+}
+}
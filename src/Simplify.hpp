@@ -0,0 +1,34 @@
+#pragma once
+#include <glm/vec3.hpp>
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace VKR {
+// Triangle list with vertices merged by position
+struct IndexedMesh {
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> indices;
+};
+
+IndexedMesh weldVertices(std::span<const glm::vec3> vertices);
+
+struct SimplifiedMesh {
+    // Non-indexed triangle list
+    std::vector<glm::vec3> vertices;
+    // Square root of the largest area weighted mean squared plane distance
+    // of a collapse, an estimate of the distance from the input surface
+    float error = 0.0f;
+};
+
+// Collapses edges onto one of their vertices in order of quadric error,
+// and takes a snapshot every time the triangle count reaches the next
+// target. Targets must be decreasing, and are at least one triangle.
+// Returns fewer meshes if collapses run out before the last target, and
+// never returns an empty mesh.
+std::vector<SimplifiedMesh> simplifyMesh(
+    const IndexedMesh& mesh,
+    std::span<const size_t> target_triangle_counts
+);
+}
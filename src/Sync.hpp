@@ -27,3 +27,18 @@ inline VkFence createSignaledFence(VkDevice dev) {
 inline VkFence createUnsignaledFence(VkDevice dev) {
     return createFence(dev, 0);
 }
+
+inline VkSemaphore createTimelineSemaphore(VkDevice dev, uint64_t initial_value) {
+    VkSemaphoreTypeCreateInfo type_create_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+        .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+        .initialValue = initial_value,
+    };
+    VkSemaphoreCreateInfo create_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = &type_create_info,
+    };
+    VkSemaphore sem;
+    vkCreateSemaphore(dev, &create_info, nullptr, &sem);
+    return sem;
+}
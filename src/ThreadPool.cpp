@@ -0,0 +1,73 @@
+#include "ThreadPool.hpp"
+
+#include <cassert>
+
+namespace VKR {
+void ThreadPool::create(size_t thread_count) {
+    assert(m_workers.empty());
+    for (size_t i = 1; i < thread_count; i++) {
+        m_workers.emplace_back([this, i] { workerLoop(i); });
+    }
+}
+
+void ThreadPool::destroy() {
+    {
+        std::lock_guard lock(m_mutex);
+        m_stop = true;
+    }
+    m_start_cv.notify_all();
+    for (auto& w: m_workers) {
+        w.join();
+    }
+    m_workers.clear();
+    m_stop = false;
+}
+
+void ThreadPool::run(std::function<void(size_t)> job) {
+    if (m_workers.empty()) {
+        job(0);
+        return;
+    }
+
+    {
+        std::lock_guard lock(m_mutex);
+        m_job = std::move(job);
+        m_pending = m_workers.size();
+        m_generation++;
+    }
+    m_start_cv.notify_all();
+
+    m_job(0);
+
+    std::unique_lock lock(m_mutex);
+    m_done_cv.wait(lock, [&] { return m_pending == 0; });
+    m_job = nullptr;
+}
+
+void ThreadPool::workerLoop(size_t thread_idx) {
+    uint64_t generation = 0;
+    while (true) {
+        {
+            std::unique_lock lock(m_mutex);
+            m_start_cv.wait(lock, [&] {
+                return m_stop or m_generation != generation;
+            });
+            if (m_stop) {
+                return;
+            }
+            generation = m_generation;
+        }
+
+        m_job(thread_idx);
+
+        bool last = false;
+        {
+            std::lock_guard lock(m_mutex);
+            last = --m_pending == 0;
+        }
+        if (last) {
+            m_done_cv.notify_one();
+        }
+    }
+}
+}
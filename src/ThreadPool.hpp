@@ -0,0 +1,36 @@
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace VKR {
+// Fork-join pool where every thread, including the caller, runs the same
+// job with its own index
+class ThreadPool {
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_start_cv;
+    std::condition_variable m_done_cv;
+    std::function<void(size_t)> m_job;
+    uint64_t m_generation = 0;
+    size_t m_pending = 0;
+    bool m_stop = false;
+
+public:
+    void create(size_t thread_count);
+    void destroy();
+
+    size_t threadCount() const {
+        return m_workers.size() + 1;
+    }
+
+    // Calls job(i) for i in [0, threadCount()), job(0) on the calling
+    // thread, and returns when all calls have returned
+    void run(std::function<void(size_t)> job);
+
+private:
+    void workerLoop(size_t thread_idx);
+};
+}
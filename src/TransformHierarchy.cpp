@@ -0,0 +1,336 @@
+#include "TransformHierarchy.hpp"
+
+#include <cassert>
+
+namespace VKR {
+void TransformHierarchy::setLocalTransform(ModelID model, const glm::mat4& t) {
+    auto node = m_nodes.at(model);
+    m_locals[node] = t;
+    markDirty(node);
+}
+
+void TransformHierarchy::setParent(
+    ModelID model, const glm::mat4& model_transform,
+    ModelID parent, const glm::mat4& parent_transform
+) {
+    auto parent_node = getOrAddNode(parent, parent_transform);
+    auto node = getOrAddNode(model, model_transform);
+    assert(!isAncestor(node, parent_node) and "Cycle in model hierarchy");
+    detach(node);
+    attach(node, parent_node);
+    markDirty(node);
+    m_sorted = false;
+}
+
+void TransformHierarchy::clearParent(ModelID model) {
+    auto node = m_nodes.at(model);
+    if (m_parents[node] == c_no_parent) {
+        return;
+    }
+    // Pending changes are applied before detaching, so that the model
+    // keeps the transform it would have had
+    m_locals[node] = getCurrentWorld(node);
+    detach(node);
+    markDirty(node);
+    m_sorted = false;
+}
+
+void TransformHierarchy::remove(ModelID model) {
+    auto it = m_nodes.find(model);
+    if (it == m_nodes.end()) {
+        return;
+    }
+    auto node = it->second;
+    m_nodes.erase(it);
+
+    // Children become roots that keep their current world transforms
+    auto child = m_first_children[node];
+    while (child != c_no_node) {
+        auto next = m_next_siblings[child];
+        m_locals[child] = getCurrentWorld(child);
+        m_parents[child] = c_no_parent;
+        m_next_siblings[child] = c_no_node;
+        m_dirty[child] = true;
+        child = next;
+    }
+    m_first_children[node] = c_no_node;
+    detach(node);
+
+    // The last node moves into the removed one's place, and its parent
+    // and children are pointed there
+    auto last = static_cast<uint32_t>(m_models.size() - 1);
+    if (node != last) {
+        m_models[node] = m_models[last];
+        m_parents[node] = m_parents[last];
+        m_first_children[node] = m_first_children[last];
+        m_next_siblings[node] = m_next_siblings[last];
+        m_locals[node] = m_locals[last];
+        m_worlds[node] = m_worlds[last];
+        m_dirty[node] = m_dirty[last];
+        m_nodes[m_models[node]] = node;
+        for (
+            auto c = m_first_children[node]; c != c_no_node;
+            c = m_next_siblings[c]
+        ) {
+            m_parents[c] = node;
+        }
+        if (m_parents[node] != c_no_parent) {
+            auto* link = &m_first_children[m_parents[node]];
+            while (*link != last) {
+                link = &m_next_siblings[*link];
+            }
+            *link = node;
+        }
+    }
+    m_models.pop_back();
+    m_parents.pop_back();
+    m_first_children.pop_back();
+    m_next_siblings.pop_back();
+    m_locals.pop_back();
+    m_worlds.pop_back();
+    m_dirty.pop_back();
+    m_sorted = false;
+}
+
+void TransformHierarchy::clear() {
+    m_models.clear();
+    m_parents.clear();
+    m_first_children.clear();
+    m_next_siblings.clear();
+    m_locals.clear();
+    m_worlds.clear();
+    m_dirty.clear();
+    m_nodes.clear();
+    m_trees.clear();
+    m_node_trees.clear();
+    m_dirty_trees.clear();
+    m_sorted = true;
+}
+
+void TransformHierarchy::update(ThreadPool& thread_pool) {
+    if (!m_sorted) {
+        sort();
+    }
+
+    m_dirty_trees.clear();
+    for (uint32_t t = 0; t < m_trees.size(); t++) {
+        if (m_trees[t].dirty) {
+            m_dirty_trees.push_back(t);
+            m_trees[t].dirty = false;
+        }
+    }
+    if (m_dirty_trees.empty()) {
+        return;
+    }
+
+    // A moving vehicle only dirties its own tree, which is not worth
+    // waking up the workers for
+    if (m_dirty_trees.size() == 1) {
+        updateTree(m_trees[m_dirty_trees.front()]);
+        return;
+    }
+
+    thread_pool.run([&](size_t thread_idx) {
+        auto thread_count = thread_pool.threadCount();
+        for (size_t i = thread_idx; i < m_dirty_trees.size(); i += thread_count) {
+            updateTree(m_trees[m_dirty_trees[i]]);
+        }
+    });
+}
+
+uint32_t TransformHierarchy::getOrAddNode(ModelID model, const glm::mat4& t) {
+    auto [it, inserted] = m_nodes.try_emplace(
+        model, static_cast<uint32_t>(m_models.size())
+    );
+    if (inserted) {
+        m_models.push_back(model);
+        m_parents.push_back(c_no_parent);
+        m_first_children.push_back(c_no_node);
+        m_next_siblings.push_back(c_no_node);
+        m_locals.push_back(t);
+        m_worlds.push_back(t);
+        m_dirty.push_back(false);
+        m_sorted = false;
+    }
+    return it->second;
+}
+
+void TransformHierarchy::attach(uint32_t node, uint32_t parent) {
+    m_parents[node] = parent;
+    m_next_siblings[node] = m_first_children[parent];
+    m_first_children[parent] = node;
+}
+
+void TransformHierarchy::detach(uint32_t node) {
+    auto parent = m_parents[node];
+    if (parent == c_no_parent) {
+        return;
+    }
+    auto* link = &m_first_children[parent];
+    while (*link != node) {
+        link = &m_next_siblings[*link];
+    }
+    *link = m_next_siblings[node];
+    m_parents[node] = c_no_parent;
+    m_next_siblings[node] = c_no_node;
+}
+
+// World transform with the pending changes of the node and its ancestors
+// applied. Worlds above the topmost dirty node of the chain are current.
+glm::mat4 TransformHierarchy::getCurrentWorld(uint32_t node) const {
+    auto top = c_no_node;
+    for (auto i = node; i != c_no_parent; i = m_parents[i]) {
+        if (m_dirty[i]) {
+            top = i;
+        }
+    }
+    if (top == c_no_node) {
+        return m_worlds[node];
+    }
+
+    auto world = m_locals[node];
+    for (auto i = node; i != top;) {
+        i = m_parents[i];
+        world = m_locals[i] * world;
+    }
+    if (m_parents[top] != c_no_parent) {
+        world = m_worlds[m_parents[top]] * world;
+    }
+    return world;
+}
+
+void TransformHierarchy::markDirty(uint32_t node) {
+    m_dirty[node] = true;
+    if (m_sorted) {
+        m_trees[m_node_trees[node]].dirty = true;
+    }
+}
+
+bool TransformHierarchy::isAncestor(uint32_t node, uint32_t descendant) const {
+    for (auto i = descendant; i != c_no_parent; i = m_parents[i]) {
+        if (i == node) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void TransformHierarchy::sort() {
+    auto node_count = static_cast<uint32_t>(m_models.size());
+
+    // Children of every node as ranges of a single array
+    std::vector<uint32_t> child_offsets(node_count + 1, 0);
+    for (auto p: m_parents) {
+        if (p != c_no_parent) {
+            child_offsets[p + 1]++;
+        }
+    }
+    for (uint32_t i = 0; i < node_count; i++) {
+        child_offsets[i + 1] += child_offsets[i];
+    }
+    std::vector<uint32_t> children(child_offsets.back());
+    {
+        auto cursors = child_offsets;
+        for (uint32_t i = 0; i < node_count; i++) {
+            if (m_parents[i] != c_no_parent) {
+                children[cursors[m_parents[i]]++] = i;
+            }
+        }
+    }
+
+    // Roots without children have left the hierarchy. Once their last
+    // change has been applied they are dropped.
+    auto isLoneRoot = [&](uint32_t i) {
+        return
+            m_parents[i] == c_no_parent and
+            child_offsets[i] == child_offsets[i + 1];
+    };
+
+    std::vector<uint32_t> order;
+    order.reserve(node_count);
+    m_trees.clear();
+    for (uint32_t root = 0; root < node_count; root++) {
+        if (m_parents[root] != c_no_parent) {
+            continue;
+        }
+        if (isLoneRoot(root) and !m_dirty[root]) {
+            continue;
+        }
+        Tree tree = {
+            .first = static_cast<uint32_t>(order.size()),
+            .dirty = false,
+        };
+        order.push_back(root);
+        for (auto i = tree.first; i < order.size(); i++) {
+            auto n = order[i];
+            tree.dirty = tree.dirty or m_dirty[n];
+            for (auto c = child_offsets[n]; c < child_offsets[n + 1]; c++) {
+                order.push_back(children[c]);
+            }
+        }
+        tree.count = order.size() - tree.first;
+        m_trees.push_back(tree);
+    }
+
+    std::vector<uint32_t> new_indices(node_count, c_no_parent);
+    for (uint32_t i = 0; i < order.size(); i++) {
+        new_indices[order[i]] = i;
+    }
+
+    auto permute = [&]<typename T>(std::vector<T>& v) {
+        std::vector<T> sorted(order.size());
+        for (uint32_t i = 0; i < order.size(); i++) {
+            sorted[i] = v[order[i]];
+        }
+        v = std::move(sorted);
+    };
+    permute(m_models);
+    permute(m_parents);
+    permute(m_locals);
+    permute(m_worlds);
+    permute(m_dirty);
+    for (auto& p: m_parents) {
+        if (p != c_no_parent) {
+            p = new_indices[p];
+        }
+    }
+    m_first_children.assign(order.size(), c_no_node);
+    m_next_siblings.assign(order.size(), c_no_node);
+    for (auto i = static_cast<uint32_t>(order.size()); i-- > 0;) {
+        if (m_parents[i] != c_no_parent) {
+            attach(i, m_parents[i]);
+        }
+    }
+
+    m_nodes.clear();
+    m_node_trees.resize(order.size());
+    for (uint32_t t = 0; t < m_trees.size(); t++) {
+        const auto& tree = m_trees[t];
+        for (auto i = tree.first; i < tree.first + tree.count; i++) {
+            m_nodes[m_models[i]] = i;
+            m_node_trees[i] = t;
+        }
+    }
+
+    m_sorted = true;
+}
+
+void TransformHierarchy::updateTree(const Tree& tree) {
+    // Breadth-first order guarantees that a parent is final before any of
+    // its children is visited, so dirtiness flows down in the same pass
+    auto end = tree.first + tree.count;
+    for (auto i = tree.first; i < end; i++) {
+        auto p = m_parents[i];
+        if (p != c_no_parent) {
+            m_dirty[i] = m_dirty[i] or m_dirty[p];
+        }
+        if (m_dirty[i]) {
+            m_worlds[i] = p == c_no_parent ?
+                m_locals[i] : m_worlds[p] * m_locals[i];
+        }
+    }
+    for (auto i = tree.first; i < end; i++) {
+        m_dirty[i] = false;
+    }
+}
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include "ThreadPool.hpp"
+#include "VKR.hpp"
+
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace VKR {
+// Models with a parent or with children. Every tree is stored contiguously
+// in breadth-first order, so parents precede their children and a tree
+// can be updated with a single linear pass, independently of other trees.
+class TransformHierarchy {
+    static constexpr uint32_t c_no_parent = UINT32_MAX;
+    static constexpr uint32_t c_no_node = UINT32_MAX;
+
+    std::vector<ModelID> m_models;
+    std::vector<uint32_t> m_parents;
+    // Children of every node as a singly linked list, so that detaching
+    // and removing nodes only visits their neighbours
+    std::vector<uint32_t> m_first_children;
+    std::vector<uint32_t> m_next_siblings;
+    std::vector<glm::mat4> m_locals;
+    std::vector<glm::mat4> m_worlds;
+    std::vector<uint8_t> m_dirty;
+    std::unordered_map<ModelID, uint32_t> m_nodes;
+
+    struct Tree {
+        uint32_t first;
+        uint32_t count;
+        bool dirty;
+    };
+    std::vector<Tree> m_trees;
+    std::vector<uint32_t> m_node_trees;
+    std::vector<uint32_t> m_dirty_trees;
+    bool m_sorted = true;
+
+public:
+    bool empty() const {
+        return m_nodes.empty();
+    }
+
+    bool contains(ModelID model) const {
+        return m_nodes.contains(model);
+    }
+
+    // The local transform of a root is its world transform
+    void setLocalTransform(ModelID model, const glm::mat4& t);
+
+    // Both models join the hierarchy with their current transforms as
+    // local transforms if they are not part of it yet
+    void setParent(
+        ModelID model, const glm::mat4& model_transform,
+        ModelID parent, const glm::mat4& parent_transform
+    );
+    // Makes model a root that keeps its current world transform
+    void clearParent(ModelID model);
+    // Children of the removed model become roots
+    void remove(ModelID model);
+    void clear();
+
+    // Recomputes world transforms of dirty nodes and their descendants,
+    // with trees spread over the threads of the pool
+    void update(ThreadPool& thread_pool);
+
+    // Calls f(models, world_transforms) for every tree recomputed by the
+    // last update
+    template<typename F>
+    void forEachUpdatedTree(F f) const {
+        for (auto t: m_dirty_trees) {
+            const auto& tree = m_trees[t];
+            f(
+                std::span(m_models).subspan(tree.first, tree.count),
+                std::span(m_worlds).subspan(tree.first, tree.count)
+            );
+        }
+    }
+
+private:
+    uint32_t getOrAddNode(ModelID model, const glm::mat4& t);
+    void attach(uint32_t node, uint32_t parent);
+    void detach(uint32_t node);
+    glm::mat4 getCurrentWorld(uint32_t node) const;
+    void markDirty(uint32_t node);
+    bool isAncestor(uint32_t node, uint32_t descendant) const;
+    void sort();
+    void updateTree(const Tree& tree);
+};
+}
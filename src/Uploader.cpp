@@ -0,0 +1,249 @@
+#include "Uploader.hpp"
+#include "Sync.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace VKR {
+void Uploader::create(
+    VkDevice device, VmaAllocator allocator,
+    const QueueFamilies& queue_families, const Queues& queues,
+    size_t ring_size
+) {
+    m_device = device;
+    m_allocator = allocator;
+    m_graphics_family = queue_families.graphics;
+    if (queue_families.transfer != QueueFamilies::NotFound) {
+        m_transfer_family = queue_families.transfer;
+        m_queue = queues.transfer;
+    } else {
+        m_transfer_family = queue_families.graphics;
+        m_queue = queues.graphics;
+    }
+
+    VkCommandPoolCreateInfo create_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags =
+            VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
+            VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        .queueFamilyIndex = m_transfer_family,
+    };
+    vkCreateCommandPool(m_device, &create_info, nullptr, &m_cmd_pool);
+    m_semaphore = createTimelineSemaphore(m_device, 0);
+    m_last_value = 0;
+
+    assert(ring_size > 0);
+    m_ring = createStagingBuffer(m_allocator, ring_size);
+    m_ring_data = static_cast<std::byte*>(getMappedData(m_allocator, m_ring));
+    m_ring_size = ring_size;
+    m_head = m_tail = 0;
+}
+
+void Uploader::destroy() {
+    if (!m_device) {
+        return;
+    }
+    m_batches.clear();
+    m_cmd_buffer = VK_NULL_HANDLE;
+    m_free_cmd_buffers.clear();
+    m_ring.destroy(m_allocator);
+    m_ring_data = nullptr;
+    vkDestroySemaphore(m_device, m_semaphore, nullptr);
+    vkDestroyCommandPool(m_device, m_cmd_pool, nullptr);
+    m_device = VK_NULL_HANDLE;
+}
+
+uint64_t Uploader::upload(std::span<const Upload> uploads) {
+    assert(!uploads.empty());
+    std::vector<VkBufferMemoryBarrier> releases;
+    for (const auto& upload: uploads) {
+        const auto& data = upload.data;
+        // Copies are recorded right away, since the ring space belongs to
+        // the batch that is being recorded when it is allocated
+        for (size_t done = 0; done < data.size();) {
+            auto size = std::min(data.size() - done, m_ring_size);
+            auto offset = allocate(size);
+            std::memcpy(m_ring_data + offset, data.data() + done, size);
+            VkBufferCopy region = {
+                .srcOffset = offset,
+                .dstOffset = upload.dst_offset + done,
+                .size = size,
+            };
+            vkCmdCopyBuffer(
+                batchCommandBuffer(), m_ring.buffer, upload.dst, 1, &region
+            );
+            done += size;
+        }
+
+        // Shared buffers may be in use by the graphics queue outside of
+        // the copied range
+        if (transfersOwnership() and !data.empty()) {
+            releases.push_back({
+                .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+                .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                .srcQueueFamilyIndex = m_transfer_family,
+                .dstQueueFamilyIndex = m_graphics_family,
+                .buffer = upload.dst,
+                .offset = upload.dst_offset,
+                .size = data.size(),
+            });
+        }
+    }
+
+    // The barrier also covers copies of batches flushed in between, which
+    // were submitted to the same queue earlier
+    if (!releases.empty()) {
+        vkCmdPipelineBarrier(
+            batchCommandBuffer(),
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+            0, 0, nullptr, releases.size(), releases.data(), 0, nullptr
+        );
+    }
+
+    // Empty uploads still get a batch to signal
+    batchCommandBuffer();
+
+    return m_last_value + 1;
+}
+
+size_t Uploader::allocate(size_t size) {
+    assert(size <= m_ring_size);
+    while (true) {
+        if (m_head == m_tail) {
+            m_head = m_tail = 0;
+        }
+        // Allocations don't wrap around, the end of the ring is skipped
+        // instead
+        auto offset = m_head % m_ring_size;
+        auto skip = offset + size > m_ring_size ? m_ring_size - offset : 0;
+        if (m_ring_size - (m_head - m_tail) >= skip + size) {
+            m_head += skip;
+            offset = m_head % m_ring_size;
+            m_head += size;
+            return offset;
+        }
+        // Everything in use belongs to the batch being recorded
+        if (m_batches.empty()) {
+            flush();
+        }
+        wait(m_batches.front().value);
+        collect();
+    }
+}
+
+VkCommandBuffer Uploader::batchCommandBuffer() {
+    if (m_cmd_buffer) {
+        return m_cmd_buffer;
+    }
+
+    if (m_free_cmd_buffers.empty()) {
+        VkCommandBufferAllocateInfo alloc_info = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = m_cmd_pool,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = 1,
+        };
+        VkCommandBuffer cmd_buffer;
+        vkAllocateCommandBuffers(m_device, &alloc_info, &cmd_buffer);
+        m_free_cmd_buffers.push_back(cmd_buffer);
+    }
+    m_cmd_buffer = m_free_cmd_buffers.back();
+    m_free_cmd_buffers.pop_back();
+
+    // Beginning implicitly resets the command buffer
+    VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    vkBeginCommandBuffer(m_cmd_buffer, &begin_info);
+
+    return m_cmd_buffer;
+}
+
+void Uploader::flush() {
+    if (!m_cmd_buffer) {
+        return;
+    }
+    vkEndCommandBuffer(m_cmd_buffer);
+    vmaFlushAllocation(m_allocator, m_ring.allocation, 0, VK_WHOLE_SIZE);
+
+    auto value = ++m_last_value;
+    VkTimelineSemaphoreSubmitInfo timeline_info = {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .signalSemaphoreValueCount = 1,
+        .pSignalSemaphoreValues = &value,
+    };
+    VkSubmitInfo submit_info = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = &timeline_info,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &m_cmd_buffer,
+        .signalSemaphoreCount = 1,
+        .pSignalSemaphores = &m_semaphore,
+    };
+    vkQueueSubmit(m_queue, 1, &submit_info, VK_NULL_HANDLE);
+
+    m_batches.push_back({
+        .value = value,
+        .cmd_buffer = m_cmd_buffer,
+        .ring_end = m_head,
+    });
+    m_cmd_buffer = VK_NULL_HANDLE;
+}
+
+void Uploader::collect() {
+    if (m_batches.empty()) {
+        return;
+    }
+    uint64_t value;
+    vkGetSemaphoreCounterValue(m_device, m_semaphore, &value);
+    while (!m_batches.empty() and m_batches.front().value <= value) {
+        const auto& batch = m_batches.front();
+        m_tail = batch.ring_end;
+        m_free_cmd_buffers.push_back(batch.cmd_buffer);
+        m_batches.pop_front();
+    }
+}
+
+void Uploader::wait(uint64_t value) {
+    if (value > m_last_value) {
+        flush();
+    }
+    VkSemaphoreWaitInfo wait_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .semaphoreCount = 1,
+        .pSemaphores = &m_semaphore,
+        .pValues = &value,
+    };
+    vkWaitSemaphores(m_device, &wait_info, UINT64_MAX);
+}
+
+void Uploader::recordAcquire(
+    VkCommandBuffer cmd_buffer, std::span<const Range> ranges,
+    VkPipelineStageFlags dst_stage_mask, VkAccessFlags dst_access_mask
+) const {
+    // Within one family, waiting for the semaphore is enough
+    if (!transfersOwnership() or ranges.empty()) {
+        return;
+    }
+    std::vector<VkBufferMemoryBarrier> acquires;
+    acquires.reserve(ranges.size());
+    for (const auto& range: ranges) {
+        acquires.push_back({
+            .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+            .dstAccessMask = dst_access_mask,
+            .srcQueueFamilyIndex = m_transfer_family,
+            .dstQueueFamilyIndex = m_graphics_family,
+            .buffer = range.buffer,
+            .offset = range.offset,
+            .size = range.size,
+        });
+    }
+    vkCmdPipelineBarrier(
+        cmd_buffer,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dst_stage_mask,
+        0, 0, nullptr, acquires.size(), acquires.data(), 0, nullptr
+    );
+}
+}
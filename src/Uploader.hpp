@@ -0,0 +1,114 @@
+#pragma once
+#include "Buffer.hpp"
+#include "Queues.hpp"
+
+#include <cstddef>
+#include <deque>
+#include <span>
+#include <vector>
+
+namespace VKR {
+// Copies data into device local buffers on the transfer queue without
+// waiting for the copies to finish. Data is staged in a persistently
+// mapped ring, and copies are recorded into a batch that is submitted by
+// flush(). Every batch signals the next value of a timeline semaphore,
+// after which its part of the ring and its command buffer are reused.
+// When the transfer queue belongs to its own family, the copies release
+// their buffers, and the graphics queue has to acquire them before use.
+class Uploader {
+    VkDevice m_device = VK_NULL_HANDLE;
+    VmaAllocator m_allocator = VK_NULL_HANDLE;
+    VkQueue m_queue = VK_NULL_HANDLE;
+    uint32_t m_transfer_family = QueueFamilies::NotFound;
+    uint32_t m_graphics_family = QueueFamilies::NotFound;
+    VkCommandPool m_cmd_pool = VK_NULL_HANDLE;
+    VkSemaphore m_semaphore = VK_NULL_HANDLE;
+    // Value of the last submitted batch
+    uint64_t m_last_value = 0;
+
+    Buffer m_ring;
+    std::byte* m_ring_data = nullptr;
+    size_t m_ring_size = 0;
+    // Ever increasing positions, taken modulo the ring size. Everything
+    // from tail to head belongs to unfinished batches.
+    uint64_t m_head = 0;
+    uint64_t m_tail = 0;
+
+    struct Batch {
+        uint64_t value;
+        VkCommandBuffer cmd_buffer;
+        uint64_t ring_end;
+    };
+    // Submitted batches, in order of value
+    std::deque<Batch> m_batches;
+    // Batch being recorded, if any
+    VkCommandBuffer m_cmd_buffer = VK_NULL_HANDLE;
+    std::vector<VkCommandBuffer> m_free_cmd_buffers;
+
+public:
+    // Uploads go to the graphics queue when there is no transfer queue
+    void create(
+        VkDevice device, VmaAllocator allocator,
+        const QueueFamilies& queue_families, const Queues& queues,
+        size_t ring_size
+    );
+    // The device must be idle
+    void destroy();
+
+    struct Upload {
+        VkBuffer dst;
+        VkDeviceSize dst_offset = 0;
+        std::span<const std::byte> data;
+    };
+
+    // Returns the semaphore value that signals the end of the copies, once
+    // their batch is flushed. Data larger than the ring is copied in
+    // parts, waiting for earlier parts to free up the ring. The copied
+    // ranges are released together, after all copies.
+    uint64_t upload(std::span<const Upload> uploads);
+
+    uint64_t upload(VkBuffer dst, std::span<const std::byte> data) {
+        Upload upload = {
+            .dst = dst,
+            .data = data,
+        };
+        return this->upload(std::span(&upload, 1));
+    }
+
+    // Submits the batch being recorded
+    void flush();
+
+    // Reclaims the ring space and command buffers of finished batches
+    void collect();
+
+    void wait(uint64_t value);
+
+    VkSemaphore semaphore() const {
+        return m_semaphore;
+    }
+
+    struct Range {
+        VkBuffer buffer;
+        VkDeviceSize offset;
+        VkDeviceSize size;
+    };
+
+    // Records the graphics queue's half of the ownership transfer of
+    // uploaded ranges, before their first use at dst_stage_mask. Every
+    // upload is released on its own, so the ranges must match them. The
+    // submission must also wait for the uploads' semaphore value.
+    void recordAcquire(
+        VkCommandBuffer cmd_buffer, std::span<const Range> ranges,
+        VkPipelineStageFlags dst_stage_mask, VkAccessFlags dst_access_mask
+    ) const;
+
+private:
+    bool transfersOwnership() const {
+        return m_transfer_family != m_graphics_family;
+    }
+
+    // Returns the offset of size bytes in the ring
+    size_t allocate(size_t size);
+    VkCommandBuffer batchCommandBuffer();
+};
+}
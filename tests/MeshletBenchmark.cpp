@@ -0,0 +1,82 @@
+#include "Mesh.hpp"
+
+#include <glm/vec3.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <numbers>
+#include <vector>
+
+using namespace VKR;
+
+namespace {
+struct IndexedMesh {
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> indices;
+};
+
+// Unit sphere with twice as many segments as rings, which gives about
+// triangle_count triangles
+IndexedMesh makeLatLongSphere(size_t triangle_count) {
+    auto rings = std::max<uint32_t>(
+        std::sqrt(static_cast<double>(triangle_count) / 4.0), 2
+    );
+    auto segments = 2 * rings;
+    IndexedMesh mesh;
+    mesh.positions.reserve(size_t(rings + 1) * (segments + 1));
+    for (uint32_t r = 0; r <= rings; r++) {
+        auto theta = std::numbers::pi_v<float> * r / rings;
+        for (uint32_t s = 0; s <= segments; s++) {
+            auto phi = 2.0f * std::numbers::pi_v<float> * s / segments;
+            mesh.positions.push_back({
+                std::sin(theta) * std::cos(phi),
+                std::cos(theta),
+                std::sin(theta) * std::sin(phi),
+            });
+        }
+    }
+    mesh.indices.reserve(size_t(6) * rings * segments);
+    for (uint32_t r = 0; r < rings; r++) {
+        for (uint32_t s = 0; s < segments; s++) {
+            auto i0 = r * (segments + 1) + s;
+            auto i1 = i0 + segments + 1;
+            mesh.indices.insert(mesh.indices.end(), {
+                i0, i1, i0 + 1,
+                i0 + 1, i1, i1 + 1,
+            });
+        }
+    }
+    return mesh;
+}
+
+void benchmark(size_t triangle_count) {
+    auto mesh = makeLatLongSphere(triangle_count);
+    auto start = std::chrono::steady_clock::now();
+    auto data = buildMeshlets(mesh.positions, mesh.indices);
+    auto end = std::chrono::steady_clock::now();
+    auto seconds = std::chrono::duration<double>(end - start).count();
+    auto triangles = mesh.indices.size() / 3;
+    std::printf(
+        "%zu triangles: %.2f s, %zu meshlets of %.1f triangles on average\n",
+        triangles, seconds, data.meshlets.size(),
+        static_cast<double>(triangles) / data.meshlets.size()
+    );
+}
+}
+
+// Times meshlet building on lat-long spheres. Triangle counts can be given
+// on the command line.
+int main(int argc, char** argv) {
+    std::vector<size_t> triangle_counts;
+    for (int i = 1; i < argc; i++) {
+        triangle_counts.push_back(std::strtoull(argv[i], nullptr, 10));
+    }
+    if (triangle_counts.empty()) {
+        triangle_counts = {2'000'000, 8'000'000};
+    }
+    for (auto triangle_count: triangle_counts) {
+        benchmark(triangle_count);
+    }
+}
@@ -0,0 +1,104 @@
+#include "OffsetAllocator.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace VKR;
+
+namespace {
+int g_failures = 0;
+
+void check(bool condition, const char* what) {
+    if (!condition) {
+        std::fprintf(stderr, "FAILED: %s\n", what);
+        g_failures++;
+    }
+}
+
+// Sizes that aren't bin sizes stay in the bin below the one allocations
+// of the same size search first
+void testWholeCapacity() {
+    for (uint32_t size: {1u, 7u, 8u, 1000u, 1u << 22, (1u << 22) + 1, 0xFFFFFFF0u}) {
+        OffsetAllocator allocator;
+        allocator.create(size);
+        auto allocation = allocator.allocate(size);
+        check(allocation.offset == 0, "allocation of the whole capacity");
+        check(
+            allocator.allocate(1).offset == OffsetAllocator::c_no_space,
+            "allocation from a full allocator"
+        );
+        allocator.free(allocation);
+        auto stats = allocator.stats();
+        check(stats.free_size == size, "free size after free");
+        check(stats.free_range_count == 1, "free ranges after free");
+        check(stats.largest_free_range == size, "largest free range after free");
+    }
+}
+
+void testTooLarge() {
+    OffsetAllocator allocator;
+    allocator.create(1000);
+    check(
+        allocator.allocate(1001).offset == OffsetAllocator::c_no_space,
+        "allocation larger than the capacity"
+    );
+}
+
+// Random allocations and frees never overlap, and freeing everything
+// merges the resource back into one range
+void testRandom() {
+    constexpr uint32_t size = 1 << 20;
+    OffsetAllocator allocator;
+    allocator.create(size);
+    std::mt19937 rng(1);
+    std::vector<uint8_t> used(size, false);
+    struct Live {
+        OffsetAllocator::Allocation allocation;
+        uint32_t size;
+    };
+    std::vector<Live> live;
+    bool overlap = false;
+    for (int i = 0; i < 100000; i++) {
+        if (live.empty() or rng() % 2) {
+            uint32_t count = 1 + rng() % 5000;
+            auto allocation = allocator.allocate(count);
+            if (allocation.offset == OffsetAllocator::c_no_space) {
+                continue;
+            }
+            for (uint32_t e = 0; e < count; e++) {
+                overlap = overlap or used[allocation.offset + e];
+                used[allocation.offset + e] = true;
+            }
+            live.push_back({allocation, count});
+        } else {
+            auto k = rng() % live.size();
+            auto [allocation, count] = live[k];
+            for (uint32_t e = 0; e < count; e++) {
+                used[allocation.offset + e] = false;
+            }
+            allocator.free(allocation);
+            live[k] = live.back();
+            live.pop_back();
+        }
+    }
+    check(!overlap, "overlapping allocations");
+    for (auto [allocation, count]: live) {
+        allocator.free(allocation);
+    }
+    auto stats = allocator.stats();
+    check(stats.free_size == size, "free size after freeing everything");
+    check(stats.free_range_count == 1, "free ranges after freeing everything");
+}
+}
+
+int main() {
+    testWholeCapacity();
+    testTooLarge();
+    testRandom();
+    if (g_failures) {
+        return EXIT_FAILURE;
+    }
+    std::puts("OffsetAllocator tests passed");
+}